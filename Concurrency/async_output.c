@@ -0,0 +1,573 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define RING_SIZE (1 << 16) // Per-thread buffer size, must be a power of 2
+#define MAX_MSG_LEN 256
+#define MAX_IOVECS 64
+#define RING_CACHE_SIZE 4 // How many writers' rings each thread remembers
+#define IDLE_SLEEP_NSECS 200000
+#define BENCH_MESSAGES 100000
+#define BENCH_THREADS 4
+
+/**
+ * What to do when a thread's buffer has no room for a message.
+ *
+ * @param OVERFLOW_BLOCK Wait until the background thread makes room
+ * @param OVERFLOW_DROP Silently discard the message
+ * @param OVERFLOW_COUNT Discard the message, and report the number of
+ *                       discarded messages in the output once there's room
+ */
+typedef enum overflow_policy
+{
+    OVERFLOW_BLOCK,
+    OVERFLOW_DROP,
+    OVERFLOW_COUNT
+} OverflowPolicy;
+
+/**
+ * A single-producer/single-consumer byte ring.
+ * Each thread that writes output gets its own ring, so producers never
+ * contend with each other; only the background thread reads from it.
+ *
+ * @param head Total bytes ever written by the producer (only the producer changes it)
+ * @param tail Total bytes ever written out (only the background thread changes it)
+ * @param dropped Number of messages discarded since the last report
+ * @param owner The id of the thread that writes to the ring
+ * @param next The next ring registered with the same writer
+ * @param data The ring's storage
+ */
+typedef struct log_ring
+{
+    size_t head;
+    char pad_head[64 - sizeof(size_t)]; // Keeps `head` and `tail` on separate cache lines
+    size_t tail;
+    char pad_tail[64 - sizeof(size_t)];
+    size_t dropped;
+    unsigned long owner;
+    struct log_ring *next;
+    char data[RING_SIZE];
+} LogRing;
+
+/**
+ * An asynchronous output writer.
+ * Producers format their output into their own ring, and a background
+ * thread collects all the rings and writes them to `fd` with `writev`.
+ *
+ * @param id A number no other writer ever gets (unlike its address, which may be reused)
+ * @param fd File descriptor to write to
+ * @param policy What to do when a ring is full
+ * @param rings A list of all the rings, one per producer thread
+ * @param resume The ring the background thread collects first on its next pass
+ * @param running Set to `false` to stop the background thread
+ * @param total_dropped Total number of discarded messages
+ * @param thread The background thread
+ */
+typedef struct async_writer
+{
+    unsigned long id;
+    int fd;
+    OverflowPolicy policy;
+    LogRing *rings;
+    LogRing *resume;
+    bool running;
+    size_t total_dropped;
+    pthread_t thread;
+} AsyncWriter;
+
+/**
+ * An entry of a thread's ring cache: the thread's ring for the writer with id `writer_id`.
+ * Rings are remembered by the writer's id rather than its address: once a writer is
+ * destroyed, a new one may be allocated at the same address, and a thread that still
+ * remembered the old one's ring would write into freed memory.
+ */
+typedef struct cached_ring
+{
+    unsigned long writer_id;
+    LogRing *ring;
+} CachedRing;
+
+static unsigned long next_writer_id = 1;
+static unsigned long next_thread_id = 1;
+static __thread unsigned long my_thread_id = 0;
+static __thread CachedRing my_rings[RING_CACHE_SIZE];
+
+/**
+ * Collects the pending bytes of every ring, and writes them out with one `writev` call.
+ *
+ * @returns The number of bytes written.
+ */
+static size_t drain_rings(AsyncWriter *writer)
+{
+    struct iovec parts[MAX_IOVECS];
+    LogRing *owners[MAX_IOVECS];
+    int num_parts = 0;
+
+    LogRing *rings = __atomic_load_n(&(writer->rings), __ATOMIC_ACQUIRE);
+    if (!rings)
+        return 0;
+
+    // One call takes at most MAX_IOVECS / 2 rings. Each pass starts where the previous one
+    // stopped (wrapping around the list), so with many busy rings none of them is starved.
+    LogRing *start_ring = writer->resume ? writer->resume : rings;
+    LogRing *ring = start_ring;
+    do
+    {
+        LogRing *current = ring;
+        ring = ring->next ? ring->next : rings;
+
+        size_t head = __atomic_load_n(&(current->head), __ATOMIC_ACQUIRE);
+        size_t tail = current->tail;
+        if (head == tail)
+            continue;
+
+        // The pending bytes may wrap around the end of the ring, in which case they're in two parts
+        size_t start = tail & (RING_SIZE - 1);
+        size_t pending = head - tail;
+        size_t first = (start + pending > RING_SIZE) ? RING_SIZE - start : pending;
+
+        parts[num_parts] = (struct iovec){current->data + start, first};
+        owners[num_parts++] = current;
+        if (first < pending)
+        {
+            parts[num_parts] = (struct iovec){current->data, pending - first};
+            owners[num_parts++] = current;
+        }
+    } while (ring != start_ring && num_parts + 2 <= MAX_IOVECS);
+    writer->resume = ring;
+
+    if (!num_parts)
+        return 0;
+
+    // Interrupted or would block (on a non-blocking fd): nothing was lost, so try again
+    ssize_t written;
+    struct timespec pause = {0, IDLE_SLEEP_NSECS};
+    while ((written = writev(writer->fd, parts, num_parts)) <= 0)
+    {
+        if (written < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            break;
+        if (written == 0 || errno != EINTR)
+            nanosleep(&pause, 0);
+    }
+    if (written < 0)
+    {
+        // The output is gone (e.g. a closed pipe); discard it rather than blocking the producers forever
+        for (int i = 0; i < num_parts; i++)
+            __atomic_store_n(&(owners[i]->tail), owners[i]->tail + parts[i].iov_len, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    // `writev` may write only some of the parts; hand back exactly what was written
+    size_t remaining = (size_t)written;
+    for (int i = 0; i < num_parts && remaining; i++)
+    {
+        size_t done = remaining < parts[i].iov_len ? remaining : parts[i].iov_len;
+        __atomic_store_n(&(owners[i]->tail), owners[i]->tail + done, __ATOMIC_RELEASE);
+        remaining -= done;
+    }
+    return (size_t)written;
+}
+
+static void *writer_thread(void *arg)
+{
+    AsyncWriter *writer = (AsyncWriter *)arg;
+    struct timespec idle = {0, IDLE_SLEEP_NSECS};
+
+    while (__atomic_load_n(&(writer->running), __ATOMIC_ACQUIRE))
+    {
+        if (!drain_rings(writer))
+            nanosleep(&idle, 0);
+    }
+
+    // Write out whatever is left before exiting
+    while (drain_rings(writer))
+        ;
+    return 0;
+}
+
+/**
+ * Creates an asynchronous writer, and starts its background thread.
+ *
+ * @param fd File descriptor to write to
+ * @param policy What to do when a producer's buffer is full
+ *
+ * @returns A new writer, or NULL on error.
+ */
+AsyncWriter *create_async_writer(int fd, OverflowPolicy policy)
+{
+    if (fd < 0)
+        return 0;
+
+    AsyncWriter *writer = (AsyncWriter *)calloc(1, sizeof(AsyncWriter));
+    if (!writer)
+        return 0;
+
+    writer->id = __atomic_fetch_add(&next_writer_id, 1, __ATOMIC_RELAXED);
+    writer->fd = fd;
+    writer->policy = policy;
+    writer->running = true;
+    if (pthread_create(&(writer->thread), 0, &writer_thread, writer))
+    {
+        free(writer);
+        return 0;
+    }
+    return writer;
+}
+
+/**
+ * Finds the calling thread's ring, creating and registering one on first use.
+ * Each thread has exactly one ring per writer: it remembers the rings of the last few
+ * writers it used, and otherwise looks for its ring in the writer's list before creating one.
+ * Registration pushes the ring onto `writer->rings` with a compare-and-swap,
+ * exactly like `insert_node_atomic` in lock_free_list_insertion.c.
+ *
+ * @returns The calling thread's ring, or NULL on error.
+ */
+static LogRing *get_ring(AsyncWriter *writer)
+{
+    CachedRing *cached = &my_rings[writer->id % RING_CACHE_SIZE];
+    if (cached->writer_id == writer->id)
+        return cached->ring;
+
+    if (!my_thread_id)
+        my_thread_id = __atomic_fetch_add(&next_thread_id, 1, __ATOMIC_RELAXED);
+
+    // Only this thread registers rings it owns, so if there's none in the list now, there won't be one later
+    LogRing *ring = __atomic_load_n(&(writer->rings), __ATOMIC_ACQUIRE);
+    while (ring && ring->owner != my_thread_id)
+        ring = ring->next;
+
+    if (!ring)
+    {
+        ring = (LogRing *)calloc(1, sizeof(LogRing));
+        if (!ring)
+            return 0;
+        ring->owner = my_thread_id;
+
+        LogRing *head = __atomic_load_n(&(writer->rings), __ATOMIC_RELAXED);
+        do
+        {
+            ring->next = head;
+        } while (!__atomic_compare_exchange_n(&(writer->rings), &head, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    cached->writer_id = writer->id;
+    cached->ring = ring;
+    return ring;
+}
+
+/**
+ * @brief Copies a message into a ring, if there's room for all of it.
+ *
+ * @returns `true` if the message was copied.
+ */
+static bool ring_put(LogRing *ring, const char *msg, size_t length)
+{
+    size_t head = ring->head;
+    size_t tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+    if (RING_SIZE - (head - tail) < length)
+        return false;
+
+    size_t start = head & (RING_SIZE - 1);
+    size_t first = (start + length > RING_SIZE) ? RING_SIZE - start : length;
+    memcpy(ring->data + start, msg, first);
+    memcpy(ring->data, msg + first, length - first);
+
+    // Publishing the new head makes the message visible to the background thread
+    __atomic_store_n(&(ring->head), head + length, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Formats a message (like `printf`) and queues it for writing.
+ * Messages longer than MAX_MSG_LEN are truncated.
+ *
+ * @returns 1 if the message was queued, 0 if it was dropped or on error.
+ */
+int async_printf(AsyncWriter *writer, const char *format, ...)
+{
+    if (!writer || !format)
+        return 0;
+
+    LogRing *ring = get_ring(writer);
+    if (!ring)
+        return 0;
+
+    char msg[MAX_MSG_LEN];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(msg, MAX_MSG_LEN, format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+    if (length >= MAX_MSG_LEN)
+        length = MAX_MSG_LEN - 1;
+
+    if (writer->policy == OVERFLOW_COUNT && ring->dropped)
+    {
+        char report[64];
+        int report_len = snprintf(report, sizeof(report), "[%zu messages dropped]\n", ring->dropped);
+        if (ring_put(ring, report, report_len))
+            ring->dropped = 0;
+    }
+
+    while (!ring_put(ring, msg, length))
+    {
+        if (writer->policy != OVERFLOW_BLOCK)
+        {
+            ring->dropped++;
+            __atomic_fetch_add(&(writer->total_dropped), 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        sched_yield();
+    }
+    return 1;
+}
+
+/**
+ * @brief Waits until everything queued so far (by any thread) has been written out.
+ */
+void async_flush(AsyncWriter *writer)
+{
+    if (!writer)
+        return;
+
+    for (LogRing *ring = __atomic_load_n(&(writer->rings), __ATOMIC_ACQUIRE); ring; ring = ring->next)
+    {
+        while (__atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE) != __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+}
+
+/**
+ * Flushes all queued output, stops the background thread, and destroys the writer.
+ * No thread may use the writer once this is called. The file descriptor is NOT closed.
+ *
+ * @param writer Pointer to the writer, which will be pointed to NULL
+ */
+void destroy_async_writer(AsyncWriter **writer)
+{
+    if (!writer || !(*writer))
+        return;
+
+    __atomic_store_n(&((*writer)->running), false, __ATOMIC_RELEASE);
+    pthread_join((*writer)->thread, 0);
+
+    LogRing *scan = (*writer)->rings;
+    while (scan)
+    {
+        LogRing *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+    CachedRing *cached = &my_rings[(*writer)->id % RING_CACHE_SIZE];
+    if (cached->writer_id == (*writer)->id)
+        *cached = (CachedRing){0, 0};
+
+    free(*writer);
+    (*writer) = 0;
+}
+
+/**
+ * @brief Has one thread take turns writing to several writers (more than it can remember at once),
+ *        and checks that it got a single ring per writer and that each writer's output is in order.
+ *
+ * @returns `true` if the check passed.
+ */
+static bool check_alternating_writers(void)
+{
+    enum { NUM_WRITERS = RING_CACHE_SIZE + 1, NUM_LINES = 1000 }; // Little enough to fit in a pipe's buffer
+    int pipe_fds[NUM_WRITERS][2];
+    AsyncWriter *writers[NUM_WRITERS] = {0};
+    bool ok = true;
+
+    int num_open = 0;
+    for (; num_open < NUM_WRITERS; num_open++)
+    {
+        if (pipe(pipe_fds[num_open]))
+            break;
+        writers[num_open] = create_async_writer(pipe_fds[num_open][1], OVERFLOW_BLOCK);
+        if (!writers[num_open])
+        {
+            close(pipe_fds[num_open][0]);
+            close(pipe_fds[num_open][1]);
+            break;
+        }
+    }
+    if (num_open < NUM_WRITERS)
+        ok = false;
+
+    for (int line = 0; ok && line < NUM_LINES; line++)
+    {
+        for (int i = 0; i < NUM_WRITERS; i++)
+            async_printf(writers[i], "%d\n", line);
+    }
+
+    for (int i = 0; i < num_open; i++)
+    {
+        async_flush(writers[i]);
+        int num_rings = 0;
+        for (LogRing *ring = writers[i]->rings; ring; ring = ring->next)
+            num_rings++;
+        if (num_rings != (ok ? 1 : 0))
+            ok = false;
+        destroy_async_writer(&writers[i]);
+        close(pipe_fds[i][1]);
+
+        FILE *output = fdopen(pipe_fds[i][0], "r");
+        if (!output)
+        {
+            close(pipe_fds[i][0]);
+            ok = false;
+            continue;
+        }
+        int expected = 0, value;
+        while (fscanf(output, "%d", &value) == 1)
+        {
+            if (value != expected++)
+                ok = false;
+        }
+        if (expected != NUM_LINES)
+            ok = false;
+        fclose(output);
+    }
+    return ok;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Simulates a slow disk or pipe: reads a small chunk from `fd`, then sleeps.
+ */
+static void *slow_reader(void *arg)
+{
+    int fd = *(int *)arg;
+    char chunk[4096];
+    struct timespec pause = {0, 1000000};
+
+    while (read(fd, chunk, sizeof(chunk)) > 0)
+        nanosleep(&pause, 0);
+    return 0;
+}
+
+typedef struct bench_args
+{
+    AsyncWriter *writer; // If NULL, use `file` instead
+    FILE *file;
+    double worst;
+    double total;
+} BenchArgs;
+
+static void *bench_producer(void *arg)
+{
+    BenchArgs *args = (BenchArgs *)arg;
+
+    for (int i = 0; i < BENCH_MESSAGES; i++)
+    {
+        double start = now_seconds();
+        if (args->writer)
+            async_printf(args->writer, "message %d from a hot thread\n", i);
+        else
+            fprintf(args->file, "message %d from a hot thread\n", i);
+        double elapsed = now_seconds() - start;
+
+        args->total += elapsed;
+        if (elapsed > args->worst)
+            args->worst = elapsed;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs BENCH_THREADS producers against a slow pipe reader,
+ *        and prints the average and worst latency of a single output call.
+ */
+static void run_bench(const char *name, OverflowPolicy policy, bool use_async)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds))
+        return;
+
+    pthread_t reader;
+    pthread_create(&reader, 0, &slow_reader, &pipe_fds[0]);
+
+    AsyncWriter *writer = use_async ? create_async_writer(pipe_fds[1], policy) : 0;
+    FILE *file = use_async ? 0 : fdopen(pipe_fds[1], "w");
+
+    pthread_t threads[BENCH_THREADS];
+    BenchArgs args[BENCH_THREADS];
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        args[i] = (BenchArgs){writer, file, 0, 0};
+        pthread_create(&threads[i], 0, &bench_producer, &args[i]);
+    }
+
+    double worst = 0, total = 0;
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        pthread_join(threads[i], 0);
+        total += args[i].total;
+        if (args[i].worst > worst)
+            worst = args[i].worst;
+    }
+
+    size_t dropped = writer ? writer->total_dropped : 0;
+    if (writer)
+    {
+        destroy_async_writer(&writer);
+        close(pipe_fds[1]);
+    }
+    else
+        fclose(file);
+    pthread_join(reader, 0);
+    close(pipe_fds[0]);
+
+    printf("%-22s | avg %8.2f us | worst %10.2f us | dropped %zu\n", name,
+           total / (BENCH_THREADS * (double)BENCH_MESSAGES) * 1e6, worst * 1e6, dropped);
+}
+
+int main(void)
+{
+    printf("*********************************ASYNCHRONOUS OUTPUT:*********************************\n");
+    // `printf` writes to `stdout` from the calling thread. When `stdout` is a slow pipe or disk,
+    // the thread stops and waits for it. An asynchronous writer only copies the message into
+    // a buffer owned by the calling thread, and a background thread does the actual writing.
+
+    fflush(stdout); // Anything `printf` buffered must come out before the writer's output
+    AsyncWriter *writer = create_async_writer(STDOUT_FILENO, OVERFLOW_BLOCK);
+    if (!writer)
+        return 0;
+
+    for (int i = 1; i <= 3; i++)
+        async_printf(writer, "This is message number %d, written by a background thread\n", i);
+
+    // Before mixing in `printf` again (or exiting), we must make sure the queued output was written:
+    async_flush(writer);
+    destroy_async_writer(&writer);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~CORRECTNESS:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("One thread alternating between %d writers: %s\n", RING_CACHE_SIZE + 1,
+           check_alternating_writers() ? "OK" : "FAILED");
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("%d threads writing %d messages each to a slowly-read pipe:\n", BENCH_THREADS, BENCH_MESSAGES);
+    run_bench("fprintf", OVERFLOW_BLOCK, false);
+    run_bench("async (block)", OVERFLOW_BLOCK, true);
+    run_bench("async (drop)", OVERFLOW_DROP, true);
+    run_bench("async (count)", OVERFLOW_COUNT, true);
+
+    return 0;
+}
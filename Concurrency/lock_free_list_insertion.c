@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_PRODUCERS 8
+#define VALUES_PER_PRODUCER 200000
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+/**
+ * The `insert_node` from double_pointer_implementation.c.
+ * Reading `*list` and then writing it back is NOT atomic: if two threads
+ * read the same head, one of the insertions is lost.
+ */
+void insert_node(Node **list, Node *new_node)
+{
+    if (!new_node || !list)
+        return;
+
+    new_node->next = (*list);
+    (*list) = new_node;
+}
+
+/**
+ * Inserts a node at the head of a list, and is safe to call from
+ * any number of threads at once.
+ * Instead of blindly writing the new head, we use a "compare and swap" (CAS):
+ * the head is replaced ONLY if it still holds the value we linked `new_node` to.
+ * If another thread got there first, the CAS fails, gives us the current head,
+ * and we simply try again.
+ *
+ * @param list Pointer to the head of the list
+ * @param new_node Node to insert
+ */
+void insert_node_atomic(Node **list, Node *new_node)
+{
+    if (!new_node || !list)
+        return;
+
+    Node *head = __atomic_load_n(list, __ATOMIC_RELAXED);
+    do
+    {
+        new_node->next = head;
+    } while (!__atomic_compare_exchange_n(list, &head, new_node, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * Reverses a list in place.
+ *
+ * @param head The head of the list
+ *
+ * @returns The new head of the list.
+ */
+Node *reverse_list(Node *head)
+{
+    Node *reversed = 0;
+    while (head)
+    {
+        Node *next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
+/**
+ * Takes ALL the nodes out of a list at once, by atomically swapping its head with NULL.
+ * Only one thread (the "consumer") may drain a list, but producers may keep
+ * calling `insert_node_atomic` while it does.
+ *
+ * @param list Pointer to the head of the list
+ * @param fifo If `true`, the returned chain is reversed so that nodes come
+ *             out in the order they were inserted
+ *
+ * @returns The drained chain of nodes (which the caller now owns), or NULL if the list was empty.
+ */
+Node *drain_list(Node **list, bool fifo)
+{
+    if (!list)
+        return 0;
+
+    Node *chain = __atomic_exchange_n(list, (Node *)0, __ATOMIC_ACQUIRE);
+    return fifo ? reverse_list(chain) : chain;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+typedef struct producer_args
+{
+    Node **list;
+    int id;
+    int count;
+    pthread_mutex_t *lock; // If not NULL, insert with the regular `insert_node` under this lock
+    int *finished;         // If not NULL, incremented once the producer is done
+    int inserted;          // Set by the producer: how many values it actually inserted
+} ProducerArgs;
+
+void *producer(void *arg)
+{
+    ProducerArgs *args = (ProducerArgs *)arg;
+
+    args->inserted = 0;
+    for (int i = 0; i < args->count; i++)
+    {
+        Node *new_node = create_node(args->id * args->count + i);
+        if (!new_node)
+            continue;
+        args->inserted++;
+        if (args->lock)
+        {
+            pthread_mutex_lock(args->lock);
+            insert_node(args->list, new_node);
+            pthread_mutex_unlock(args->lock);
+        }
+        else
+            insert_node_atomic(args->list, new_node);
+    }
+
+    if (args->finished)
+        __atomic_add_fetch(args->finished, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Runs `num_producers` threads which insert into `list`,
+ *        while the calling thread drains it, and checks that every
+ *        value arrived exactly once, in each producer's order.
+ *
+ * @returns `true` if the check passed (`false` also if not every producer could be started).
+ */
+bool check_producers(int num_producers)
+{
+    Node *head = 0;
+    pthread_t threads[MAX_PRODUCERS];
+    ProducerArgs args[MAX_PRODUCERS];
+    int *last_seen = (int *)malloc(num_producers * sizeof(int));
+    if (!last_seen)
+        return false;
+    for (int i = 0; i < num_producers; i++)
+        last_seen[i] = -1;
+
+    bool ok = true;
+    int started = 0, finished = 0;
+    for (; started < num_producers; started++)
+    {
+        args[started] = (ProducerArgs){&head, started, VALUES_PER_PRODUCER, 0, &finished, 0};
+        if (pthread_create(&threads[started], 0, &producer, &args[started]))
+        {
+            ok = false;
+            break;
+        }
+    }
+
+    // A producer may insert fewer values than asked (if `create_node` fails), so rather than
+    // waiting for a number of values, drain until every producer is done, and then once more
+    int received = 0;
+    bool done = false;
+    while (!done)
+    {
+        done = __atomic_load_n(&finished, __ATOMIC_ACQUIRE) == started;
+        Node *chain = drain_list(&head, true);
+        for (Node *scan = chain; scan; scan = scan->next)
+        {
+            int id = scan->value / VALUES_PER_PRODUCER;
+            int seq = scan->value % VALUES_PER_PRODUCER;
+            if (seq <= last_seen[id])
+                ok = false;
+            last_seen[id] = seq;
+            received++;
+        }
+        destroy_list(&chain);
+    }
+
+    int inserted = 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], 0);
+        inserted += args[i].inserted;
+    }
+
+    if (head || received != inserted)
+        ok = false;
+    free(last_seen);
+    return ok;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Measures how long `num_producers` threads take to insert
+ *        VALUES_PER_PRODUCER nodes each.
+ *
+ * @param use_lock Whether to use a mutex around `insert_node` instead of `insert_node_atomic`
+ *
+ * @returns Inserted nodes per second.
+ */
+double bench_producers(int num_producers, bool use_lock)
+{
+    Node *head = 0;
+    pthread_t threads[MAX_PRODUCERS];
+    ProducerArgs args[MAX_PRODUCERS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    double start = now_seconds();
+    int started = 0;
+    for (; started < num_producers; started++)
+    {
+        args[started] = (ProducerArgs){&head, started, VALUES_PER_PRODUCER, use_lock ? &lock : 0, 0, 0};
+        if (pthread_create(&threads[started], 0, &producer, &args[started]))
+            break;
+    }
+    double inserted = 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], 0);
+        inserted += args[i].inserted;
+    }
+    double elapsed = now_seconds() - start;
+
+    destroy_list(&head);
+    return inserted / elapsed;
+}
+
+int main(void)
+{
+    printf("*********************************LOCK-FREE LIST INSERTION:*********************************\n");
+    // `insert_node` reads the head of the list and then writes a new head.
+    // If several threads do this at the same time, they can all read the SAME
+    // old head, and all but one of the new nodes are lost.
+    // `insert_node_atomic` uses an atomic compare-and-swap instead, and
+    // `drain_list` lets a single consumer take everything that was inserted so far,
+    // which turns our list into a cheap multi-producer work queue.
+
+    Node *head = 0;
+    Node **list = &head;
+    for (int i = 1; i <= 5; i++)
+        insert_node_atomic(list, create_node(i));
+
+    Node *chain = drain_list(list, true);
+    printf("Drained in FIFO order: ");
+    for (Node *scan = chain; scan; scan = scan->next)
+        printf("%d ", scan->value);
+    printf("\n`head` is %s NULL after draining!\n", (!head) ? "" : "NOT");
+    destroy_list(&chain);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~CORRECTNESS:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    for (int producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+        printf("%d producers, 1 consumer: %s\n", producers, check_producers(producers) ? "OK" : "FAILED");
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("Producers | mutex + insert_node | insert_node_atomic (Minserts/s)\n");
+    for (int producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+    {
+        double locked = bench_producers(producers, true);
+        double atomic = bench_producers(producers, false);
+        printf("%9d | %19.2f | %18.2f\n", producers, locked / 1e6, atomic / 1e6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+#define SPINS_BEFORE_YIELD 64
+#define QUEUE_CAPACITY 1024
+#define MAX_THREADS 8
+#define VALUES_PER_PRODUCER 1000000
+#define BATCH_SIZE 32
+#define LATENCY_SAMPLE_EVERY 64
+
+/**
+ * A slot of the queue.
+ *
+ * @param seq The slot's sequence number, which says whose turn it is to use it:
+ *            equal to the position being written -> a producer may write it,
+ *            equal to that position + 1 -> a consumer may read it
+ * @param value The value in the slot
+ */
+typedef struct slot
+{
+    size_t seq;
+    int value;
+} Slot;
+
+/**
+ * A bounded, multi-producer multi-consumer FIFO queue of ints, on a fixed ring of slots.
+ * Unlike the `Stack`, any number of threads may add and remove values at the same time.
+ *
+ * Producers claim a position by advancing `tail`, and consumers by advancing `head`,
+ * each with a compare-and-swap. `tail` and `head` are each on their own cache line:
+ * they're changed constantly by different threads, and if they shared a line every
+ * change to one would also throw the other out of every other core's cache ("false sharing").
+ *
+ * @param tail Next position to write
+ * @param head Next position to read
+ * @param mask Capacity - 1 (the capacity is a power of 2, so `position & mask` is its slot)
+ * @param slots The ring
+ */
+typedef struct ring_queue
+{
+    _Alignas(CACHE_LINE_SIZE) size_t tail;
+    _Alignas(CACHE_LINE_SIZE) size_t head;
+    _Alignas(CACHE_LINE_SIZE) size_t mask;
+    Slot *slots;
+} RingQueue;
+
+/**
+ * Creates a queue.
+ *
+ * @param capacity Minimal number of values the queue can hold (rounded up to a power of 2)
+ *
+ * @returns A new queue, or NULL on error.
+ */
+RingQueue *create_queue(int capacity)
+{
+    if (capacity <= 0)
+        return 0;
+
+    size_t size = 2;
+    while (size < (size_t)capacity)
+        size *= 2;
+
+    RingQueue *queue = (RingQueue *)aligned_alloc(CACHE_LINE_SIZE, sizeof(RingQueue));
+    if (!queue)
+        return 0;
+
+    queue->slots = (Slot *)aligned_alloc(CACHE_LINE_SIZE, size * sizeof(Slot));
+    if (!(queue->slots))
+    {
+        free(queue);
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++)
+        queue->slots[i].seq = i;
+
+    queue->tail = 0;
+    queue->head = 0;
+    queue->mask = size - 1;
+    return queue;
+}
+
+/**
+ * @brief Frees a queue, and points the given queue to NULL.
+ *        No other thread may be using the queue.
+ */
+void destroy_queue(RingQueue **queue)
+{
+    if (!queue || !(*queue))
+        return;
+
+    free((*queue)->slots);
+    free(*queue);
+    (*queue) = 0;
+}
+
+/**
+ * Adds up to `count` values to the queue, without waiting.
+ * The values are written to consecutive positions, so they come out
+ * together and in order (although consumers may take them in several parts).
+ *
+ * @returns The number of values that were added (0 if the queue is full).
+ */
+int try_enqueue_batch(RingQueue *queue, const int *values, int count)
+{
+    if (!queue || !values || count <= 0)
+        return 0;
+
+    size_t pos = __atomic_load_n(&(queue->tail), __ATOMIC_RELAXED);
+    while (true)
+    {
+        // Count how many slots from `pos` on are free, i.e. were released by consumers
+        int available = 0;
+        while (available < count)
+        {
+            Slot *slot = &(queue->slots[(pos + available) & queue->mask]);
+            if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) != pos + available)
+                break;
+            available++;
+        }
+
+        if (!available)
+        {
+            // Either the queue is full, or another producer moved `tail`
+            size_t current = __atomic_load_n(&(queue->tail), __ATOMIC_RELAXED);
+            if (current == pos)
+                return 0;
+            pos = current;
+            continue;
+        }
+
+        // Claim the positions; on failure `pos` is updated and we look again
+        if (__atomic_compare_exchange_n(&(queue->tail), &pos, pos + available, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            for (int i = 0; i < available; i++)
+            {
+                Slot *slot = &(queue->slots[(pos + i) & queue->mask]);
+                slot->value = values[i];
+                __atomic_store_n(&(slot->seq), pos + i + 1, __ATOMIC_RELEASE); // Hand it to the consumers
+            }
+            return available;
+        }
+    }
+}
+
+/**
+ * Removes up to `count` values from the queue, without waiting.
+ *
+ * @param values Where the removed values are written, oldest first
+ *
+ * @returns The number of values that were removed (0 if the queue is empty).
+ */
+int try_dequeue_batch(RingQueue *queue, int *values, int count)
+{
+    if (!queue || !values || count <= 0)
+        return 0;
+
+    size_t pos = __atomic_load_n(&(queue->head), __ATOMIC_RELAXED);
+    while (true)
+    {
+        int available = 0;
+        while (available < count)
+        {
+            Slot *slot = &(queue->slots[(pos + available) & queue->mask]);
+            if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) != pos + available + 1)
+                break;
+            available++;
+        }
+
+        if (!available)
+        {
+            size_t current = __atomic_load_n(&(queue->head), __ATOMIC_RELAXED);
+            if (current == pos)
+                return 0;
+            pos = current;
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&(queue->head), &pos, pos + available, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            for (int i = 0; i < available; i++)
+            {
+                Slot *slot = &(queue->slots[(pos + i) & queue->mask]);
+                values[i] = slot->value;
+                // The slot's next turn is for the producer of position pos + i + capacity
+                __atomic_store_n(&(slot->seq), pos + i + queue->mask + 1, __ATOMIC_RELEASE);
+            }
+            return available;
+        }
+    }
+}
+
+/**
+ * @brief Adds a value to the queue without waiting.
+ *
+ * @returns `true` if the value was added, `false` if the queue is full.
+ */
+bool try_enqueue(RingQueue *queue, int value)
+{
+    return try_enqueue_batch(queue, &value, 1) == 1;
+}
+
+/**
+ * @brief Removes the oldest value from the queue without waiting.
+ *
+ * @returns `true` if a value was removed into `*value`, `false` if the queue is empty.
+ */
+bool try_dequeue(RingQueue *queue, int *value)
+{
+    return try_dequeue_batch(queue, value, 1) == 1;
+}
+
+/**
+ * @brief Waits a little before retrying a full/empty queue: spins at first,
+ *        and then gives the CPU to other threads (which may be the ones we're waiting for).
+ */
+static void backoff(int *spins)
+{
+    if (++(*spins) < SPINS_BEFORE_YIELD)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    else
+        sched_yield();
+}
+
+/**
+ * @brief Adds `count` values to the queue, waiting for room as needed.
+ */
+void enqueue_batch(RingQueue *queue, const int *values, int count)
+{
+    if (!queue || !values)
+        return;
+
+    int spins = 0;
+    while (count > 0)
+    {
+        int added = try_enqueue_batch(queue, values, count);
+        if (added)
+        {
+            values += added;
+            count -= added;
+            spins = 0;
+        }
+        else
+            backoff(&spins);
+    }
+}
+
+/**
+ * @brief Removes `count` values from the queue, waiting for them as needed.
+ */
+void dequeue_batch(RingQueue *queue, int *values, int count)
+{
+    if (!queue || !values)
+        return;
+
+    int spins = 0;
+    while (count > 0)
+    {
+        int removed = try_dequeue_batch(queue, values, count);
+        if (removed)
+        {
+            values += removed;
+            count -= removed;
+            spins = 0;
+        }
+        else
+            backoff(&spins);
+    }
+}
+
+/**
+ * @brief Adds a value to the queue, waiting for room if it's full.
+ */
+void enqueue(RingQueue *queue, int value)
+{
+    enqueue_batch(queue, &value, 1);
+}
+
+/**
+ * @brief Removes the oldest value from the queue, waiting for one if it's empty.
+ */
+int dequeue(RingQueue *queue)
+{
+    int value = 0;
+    dequeue_batch(queue, &value, 1);
+    return value;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Shared state of a benchmark run.
+ *
+ * @param sent_at Time each sampled value was enqueued (indexed by value)
+ * @param received Number of times each value was dequeued (for the correctness check)
+ * @param latencies Measured latencies of the sampled values
+ */
+typedef struct bench_state
+{
+    RingQueue *queue;
+    int num_producers;
+    int num_consumers;
+    int batch;
+    double *sent_at;
+    unsigned char *received;
+    double *latencies;
+    int num_latencies;
+} BenchState;
+
+typedef struct worker_args
+{
+    BenchState *state;
+    int id;
+} WorkerArgs;
+
+static void *bench_producer(void *arg)
+{
+    WorkerArgs *args = (WorkerArgs *)arg;
+    BenchState *state = args->state;
+    int values[BATCH_SIZE];
+    int first = args->id * VALUES_PER_PRODUCER;
+
+    for (int i = 0; i < VALUES_PER_PRODUCER; i += state->batch)
+    {
+        int count = 0;
+        for (; count < state->batch && i + count < VALUES_PER_PRODUCER; count++)
+        {
+            values[count] = first + i + count;
+            if (values[count] % LATENCY_SAMPLE_EVERY == 0)
+                state->sent_at[values[count]] = now_seconds();
+        }
+        enqueue_batch(state->queue, values, count);
+    }
+    return 0;
+}
+
+static void *bench_consumer(void *arg)
+{
+    WorkerArgs *args = (WorkerArgs *)arg;
+    BenchState *state = args->state;
+    int values[BATCH_SIZE];
+
+    // Every consumer takes an equal share of the values
+    int total = state->num_producers * VALUES_PER_PRODUCER;
+    int share = total / state->num_consumers + (args->id < total % state->num_consumers);
+
+    while (share > 0)
+    {
+        int count = share < state->batch ? share : state->batch;
+        dequeue_batch(state->queue, values, count);
+        share -= count;
+
+        for (int i = 0; i < count; i++)
+        {
+            state->received[values[i]]++;
+            if (values[i] % LATENCY_SAMPLE_EVERY == 0)
+            {
+                int index = __atomic_fetch_add(&(state->num_latencies), 1, __ATOMIC_RELAXED);
+                state->latencies[index] = now_seconds() - state->sent_at[values[i]];
+            }
+        }
+    }
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y ? 1
+                              : 0;
+}
+
+/**
+ * Runs `num_producers` threads which enqueue VALUES_PER_PRODUCER values each, and
+ * `num_consumers` threads which dequeue all of them, and prints the throughput,
+ * the latency of a sample of the values, and whether every value arrived exactly once.
+ *
+ * @param batch Number of values moved per enqueue/dequeue call (at most BATCH_SIZE)
+ */
+void bench_queue(const char *name, int num_producers, int num_consumers, int batch)
+{
+    int total = num_producers * VALUES_PER_PRODUCER;
+    BenchState state = {create_queue(QUEUE_CAPACITY), num_producers, num_consumers, batch,
+                        (double *)malloc(total * sizeof(double)), (unsigned char *)calloc(total, 1),
+                        (double *)malloc((total / LATENCY_SAMPLE_EVERY + 1) * sizeof(double)), 0};
+    if (!state.queue || !state.sent_at || !state.received || !state.latencies)
+    {
+        printf("%s: could not allocate the benchmark\n", name);
+        destroy_queue(&state.queue);
+        free(state.sent_at);
+        free(state.received);
+        free(state.latencies);
+        return;
+    }
+
+    pthread_t producers[MAX_THREADS], consumers[MAX_THREADS];
+    WorkerArgs producer_args[MAX_THREADS], consumer_args[MAX_THREADS];
+
+    double start = now_seconds();
+    for (int i = 0; i < num_consumers; i++)
+    {
+        consumer_args[i] = (WorkerArgs){&state, i};
+        pthread_create(&consumers[i], 0, &bench_consumer, &consumer_args[i]);
+    }
+    for (int i = 0; i < num_producers; i++)
+    {
+        producer_args[i] = (WorkerArgs){&state, i};
+        pthread_create(&producers[i], 0, &bench_producer, &producer_args[i]);
+    }
+    for (int i = 0; i < num_producers; i++)
+        pthread_join(producers[i], 0);
+    for (int i = 0; i < num_consumers; i++)
+        pthread_join(consumers[i], 0);
+    double elapsed = now_seconds() - start;
+
+    bool ok = true;
+    for (int i = 0; i < total; i++)
+        ok = ok && state.received[i] == 1;
+
+    qsort(state.latencies, state.num_latencies, sizeof(double), &compare_doubles);
+    double median = state.num_latencies ? state.latencies[state.num_latencies / 2] : 0;
+    double p99 = state.num_latencies ? state.latencies[(int)(state.num_latencies * 0.99)] : 0;
+
+    printf("%-12s | batch %2d | %7.2f Mvalues/s | latency p50 %8.2f us, p99 %9.2f us | %s\n",
+           name, batch, total / elapsed / 1e6, median * 1e6, p99 * 1e6, ok ? "OK" : "FAILED");
+
+    destroy_queue(&state.queue);
+    free(state.sent_at);
+    free(state.received);
+    free(state.latencies);
+}
+
+int main(void)
+{
+    printf("*********************************RING BUFFER QUEUE:*********************************\n");
+    // The `Stack` gives back the LAST value pushed (LIFO), and only one thread may use it.
+    // To hand values from thread to thread in the order they were produced we need a
+    // FIFO queue; and to keep memory bounded, a fixed ring of slots that is reused
+    // over and over. Each slot has a sequence number which tells producers and
+    // consumers whether it's their turn to use it, so no locks are needed.
+
+    RingQueue *queue = create_queue(4);
+    if (!queue)
+        return 0;
+
+    for (int i = 1; try_enqueue(queue, i); i++)
+        printf("Enqueued %d\n", i);
+    printf("The queue is full!\n");
+
+    int values[3];
+    int removed = try_dequeue_batch(queue, values, 3);
+    printf("Dequeued %d values:", removed);
+    for (int i = 0; i < removed; i++)
+        printf(" %d", values[i]);
+    printf("\n");
+
+    int more[3] = {5, 6, 7};
+    printf("Enqueued %d more values\n", try_enqueue_batch(queue, more, 3));
+
+    int value;
+    printf("Dequeued:");
+    while (try_dequeue(queue, &value))
+        printf(" %d", value);
+    printf("\nThe queue is empty!\n");
+    destroy_queue(&queue);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("%d values per producer, queue capacity %d\n", VALUES_PER_PRODUCER, QUEUE_CAPACITY);
+    bench_queue("1P1C", 1, 1, 1);
+    bench_queue("1P1C", 1, 1, BATCH_SIZE);
+    bench_queue("4P1C", 4, 1, 1);
+    bench_queue("4P1C", 4, 1, BATCH_SIZE);
+    bench_queue("4P4C", 4, 4, 1);
+    bench_queue("4P4C", 4, 4, BATCH_SIZE);
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define ALLOC_ERR "\nERROR: could not allocate requested memory\n"
+
+#define CACHE_LINE_SIZE 64
+#define SIMD_ALIGNMENT 64 // Enough for the widest (AVX-512) vector loads
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAX_STACK_SIZE 10
+#define BENCH_BYTES (1024L * 1024 * 1024)
+#define BENCH_ACCESSES 20000000
+
+/**
+ * Options for `mem_alloc`, which can be combined with '|'.
+ *
+ * @param ALLOC_ZERO The memory is zeroed, like with `calloc`
+ * @param ALLOC_HUGE_PAGES Try to back the memory with 2MB "huge" pages, so that far fewer
+ *                         address translations (TLB entries) are needed to cover it
+ * @param ALLOC_PREFAULT Touch every page up front, so that the page faults happen
+ *                       now rather than on first use
+ */
+enum alloc_flags
+{
+    ALLOC_ZERO = 1,
+    ALLOC_HUGE_PAGES = 2,
+    ALLOC_PREFAULT = 4
+};
+
+/**
+ * How a block from `mem_alloc` was actually backed.
+ */
+typedef enum alloc_backing
+{
+    BACKING_HEAP,      // `malloc`, with regular pages
+    BACKING_MMAP,      // `mmap`, with regular pages
+    BACKING_THP,       // `mmap`, with "transparent huge pages" requested from the kernel
+    BACKING_HUGETLB    // `mmap` from the reserved huge page pool
+} AllocBacking;
+
+const char *backing_names[4] = {"heap", "mmap", "transparent huge pages", "hugetlb"};
+
+/**
+ * Bookkeeping for a block from `mem_alloc`, stored right before the block itself
+ * (for `mmap`-backed blocks it's stored on the page before, so that it doesn't
+ * take up part of a huge page).
+ *
+ * @param base The address that was returned by `malloc` or `mmap`
+ * @param length The length of the mapping (`mmap`-backed blocks only)
+ * @param backing How the block is backed
+ */
+typedef struct alloc_header
+{
+    void *base;
+    size_t length;
+    AllocBacking backing;
+} AllocHeader;
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Touches one byte in every page of a block, to fault all the pages in.
+ */
+static void prefault(void *ptr, size_t size, size_t page_size)
+{
+    volatile char *scan = (volatile char *)ptr;
+    for (size_t offset = 0; offset < size; offset += page_size)
+        scan[offset] = scan[offset];
+}
+
+/**
+ * Allocates a block backed by `mmap`, aligned to `alignment`.
+ * One extra page is mapped before the block to hold its header.
+ *
+ * @returns The block, or NULL on error.
+ */
+static void *mmap_alloc(size_t size, size_t alignment, int flags)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t huge_size = align_up(size, HUGE_PAGE_SIZE);
+
+    // First choice: the kernel's reserved pool of huge pages (usually empty unless configured)
+    if ((flags & ALLOC_HUGE_PAGES) && alignment <= HUGE_PAGE_SIZE)
+    {
+        int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ((flags & ALLOC_PREFAULT) ? MAP_POPULATE : 0);
+        // The header needs a whole huge page of its own here, since a hugetlb mapping can't be split
+        void *base = mmap(0, huge_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            char *block = (char *)base + HUGE_PAGE_SIZE;
+            AllocHeader *header = (AllocHeader *)block - 1;
+            *header = (AllocHeader){base, huge_size + HUGE_PAGE_SIZE, BACKING_HUGETLB};
+            return block;
+        }
+    }
+
+    // Otherwise, map regular pages - aligned to a huge page boundary if we want the kernel
+    // to use transparent huge pages, since it can only do so for aligned 2MB ranges.
+    if (flags & ALLOC_HUGE_PAGES)
+        alignment = alignment > HUGE_PAGE_SIZE ? alignment : HUGE_PAGE_SIZE;
+    size_t length = size + alignment + page_size;
+    char *base = (char *)mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return 0;
+
+    char *block = (char *)align_up((uintptr_t)base + page_size, alignment);
+    AllocHeader *header = (AllocHeader *)block - 1;
+    *header = (AllocHeader){base, length, BACKING_MMAP};
+
+    if ((flags & ALLOC_HUGE_PAGES) && !madvise(block, size, MADV_HUGEPAGE))
+        header->backing = BACKING_THP;
+    if (flags & ALLOC_PREFAULT)
+        prefault(block, size, page_size);
+    // Anonymous mappings are always zeroed, so ALLOC_ZERO needs no extra work
+    return block;
+}
+
+/**
+ * Allocates a block of memory with a given alignment.
+ * Small blocks come from the heap; large blocks (or blocks that ask for huge pages)
+ * are mapped directly, trying hugetlb pages, then transparent huge pages, then regular pages.
+ *
+ * @param size Size of the block in bytes
+ * @param alignment Required alignment of the block's address (a power of 2),
+ *                  e.g. CACHE_LINE_SIZE or SIMD_ALIGNMENT
+ * @param flags A combination of `alloc_flags`
+ *
+ * @returns The block, which must be freed with `mem_free`, or NULL on error.
+ */
+void *mem_alloc(size_t size, size_t alignment, int flags)
+{
+    if (!size || !alignment || (alignment & (alignment - 1)))
+        return 0;
+    // The header goes right before the block, so the block must be aligned at least as much as
+    // the header is (`_Alignof` is a power of 2, unlike `sizeof(AllocHeader)`)
+    if (alignment < _Alignof(AllocHeader))
+        alignment = _Alignof(AllocHeader);
+
+    if ((flags & ALLOC_HUGE_PAGES) || size >= HUGE_PAGE_SIZE)
+        return mmap_alloc(size, alignment, flags);
+
+    char *base = (char *)malloc(size + alignment + sizeof(AllocHeader));
+    if (!base)
+        return 0;
+
+    char *block = (char *)align_up((uintptr_t)base + sizeof(AllocHeader), alignment);
+    assert(((uintptr_t)block & (alignment - 1)) == 0);
+    AllocHeader *header = (AllocHeader *)block - 1;
+    *header = (AllocHeader){base, 0, BACKING_HEAP};
+
+    if (flags & ALLOC_ZERO)
+        memset(block, 0, size);
+    else if (flags & ALLOC_PREFAULT)
+        prefault(block, size, sysconf(_SC_PAGESIZE));
+    return block;
+}
+
+/**
+ * @brief Returns how a block from `mem_alloc` is backed.
+ */
+AllocBacking mem_backing(const void *block)
+{
+    return block ? ((const AllocHeader *)block - 1)->backing : BACKING_HEAP;
+}
+
+/**
+ * @brief Frees a block allocated by `mem_alloc`.
+ */
+void mem_free(void *block)
+{
+    if (!block)
+        return;
+
+    AllocHeader *header = (AllocHeader *)block - 1;
+    if (header->backing == BACKING_HEAP)
+        free(header->base);
+    else
+        munmap(header->base, header->length);
+}
+
+typedef struct stack
+{
+    int *stack_arr;
+    int size;
+    int *top;
+} Stack;
+
+/**
+ * Creates an `int` stack with a specified maximum size, as in pointers_overview_continued.c,
+ * with its storage aligned to a cache line.
+ *
+ * @returns A new stack with the given maximum size, or NULL on error.
+ */
+Stack *create_stack(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    Stack *stack = (Stack *)calloc(1, sizeof(Stack));
+    if (!stack)
+        return 0;
+
+    // One extra slot, since `push` moves `top` BEFORE writing the value
+    stack->stack_arr = (int *)mem_alloc((size + 1) * sizeof(int), CACHE_LINE_SIZE, ALLOC_ZERO);
+    if (!(stack->stack_arr))
+    {
+        free(stack);
+        return 0;
+    }
+    stack->size = size;
+    stack->top = stack->stack_arr;
+
+    return stack;
+}
+
+int is_full(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr))
+        return 0;
+    return (stack->top - stack->stack_arr) == stack->size;
+}
+
+int push(Stack *stack, int value)
+{
+    if (!stack || !(stack->stack_arr) || is_full(stack))
+        return 0;
+
+    stack->top++;
+    *(stack->top) = value;
+    return 1;
+}
+
+void destroy_stack(Stack *stack)
+{
+    if (!stack)
+        return;
+
+    mem_free(stack->stack_arr);
+    free(stack);
+}
+
+/**
+ * Allocates a zeroed array of `count` elements of `elem_size` bytes,
+ * aligned for SIMD loads, and backed by huge pages if `huge` is set.
+ *
+ * @returns The array (to be freed with `mem_free`), or NULL on error.
+ */
+void *create_array(size_t count, size_t elem_size, int huge)
+{
+    if (!count || !elem_size || count > SIZE_MAX / elem_size)
+        return 0;
+    return mem_alloc(count * elem_size, SIMD_ALIGNMENT, ALLOC_ZERO | (huge ? ALLOC_HUGE_PAGES : 0));
+}
+
+/**
+ * Allocates a zeroed row-major `rows`x`cols` matrix, as in pointer_arithmetic_examples.c.
+ * Each row is padded to a multiple of SIMD_ALIGNMENT bytes, so that every row starts
+ * aligned, and a vector load never splits across cache lines.
+ *
+ * @param row_stride Will be set to the distance (in elements) between consecutive rows
+ *
+ * @returns The matrix (to be freed with `mem_free`), or NULL on error.
+ */
+int *create_matrix(int rows, int cols, int *row_stride, int huge)
+{
+    if (rows <= 0 || cols <= 0 || !row_stride)
+        return 0;
+
+    *row_stride = (int)(align_up(cols * sizeof(int), SIMD_ALIGNMENT) / sizeof(int));
+    return (int *)create_array((size_t)rows * (*row_stride), sizeof(int), huge);
+}
+
+/**
+ * @brief Opens a hardware counter for data TLB read misses of the calling thread.
+ *
+ * @returns A file descriptor for the counter, or -1 if counters are unavailable.
+ */
+static int open_dtlb_counter(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Reads BENCH_ACCESSES random elements of a BENCH_BYTES array, and
+ *        reports the time taken and the number of data TLB misses.
+ */
+static void bench_random_reads(int huge)
+{
+    size_t count = BENCH_BYTES / sizeof(long);
+    double start = now_seconds();
+    long *arr = (long *)mem_alloc(BENCH_BYTES, SIMD_ALIGNMENT, (huge ? ALLOC_HUGE_PAGES : 0) | ALLOC_PREFAULT);
+    double alloc_time = now_seconds() - start;
+    if (!arr)
+    {
+        printf(ALLOC_ERR);
+        return;
+    }
+
+    int counter = open_dtlb_counter();
+    unsigned long long misses = 0;
+    unsigned int rand_state = 12345;
+    long sum = 0;
+
+    if (counter >= 0)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    start = now_seconds();
+    for (long i = 0; i < BENCH_ACCESSES; i++)
+    {
+        rand_state = rand_state * 1664525u + 1013904223u;
+        sum += arr[((size_t)rand_state * 64) % count];
+    }
+    double read_time = now_seconds() - start;
+    if (counter >= 0)
+    {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+            misses = 0;
+        close(counter);
+    }
+
+    printf("  %-24s | allocate+prefault %.3f s | %d random reads %.3f s | dTLB misses: ",
+           backing_names[mem_backing(arr)], alloc_time, BENCH_ACCESSES, read_time);
+    if (counter >= 0)
+        printf("%llu\n", misses);
+    else
+        printf("(counters unavailable)\n");
+
+    mem_free(arr);
+    if (sum == 42)
+        printf("\n"); // Keeps the compiler from removing the reads
+}
+
+int main(void)
+{
+    printf("*********************************ALIGNED ALLOCATION:*********************************\n");
+    // `malloc` guarantees an alignment that is good enough for any basic type (usually 16 bytes),
+    // but not for a 64-byte cache line or a 32/64-byte SIMD vector. A buffer that starts in the
+    // middle of a cache line makes some vector loads span TWO cache lines.
+    // Very large buffers have another cost: every 4KB page needs its own entry in the CPU's
+    // address translation cache (the TLB), and a multi-GB matrix needs far more entries than
+    // the TLB has. With 2MB "huge" pages, 512 times fewer entries are needed.
+
+    Stack *stack = create_stack(MAX_STACK_SIZE);
+    if (!stack)
+    {
+        printf(ALLOC_ERR);
+        return 0;
+    }
+    for (int i = 0; !is_full(stack); i++)
+        push(stack, i);
+    printf("Stack storage at %p (address %% %d = %lu)\n", (void *)stack->stack_arr, CACHE_LINE_SIZE,
+           (unsigned long)((uintptr_t)stack->stack_arr % CACHE_LINE_SIZE));
+    destroy_stack(stack);
+
+    int row_stride = 0;
+    int *matrix = create_matrix(10, 10, &row_stride, 0);
+    if (!matrix)
+    {
+        printf(ALLOC_ERR);
+        return 0;
+    }
+    printf("A 10x10 matrix of `int`s has rows %d elements apart, so every row starts %d-byte aligned\n", row_stride, SIMD_ALIGNMENT);
+    mem_free(matrix);
+
+    int *big_matrix = create_matrix(4096, 4096, &row_stride, 1);
+    if (big_matrix)
+    {
+        printf("A 4096x4096 matrix with huge pages requested is backed by: %s\n", backing_names[mem_backing(big_matrix)]);
+        mem_free(big_matrix);
+    }
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("Random reads over a %ld MB array:\n", BENCH_BYTES / (1024 * 1024));
+    bench_random_reads(0);
+    bench_random_reads(1);
+
+    return 0;
+}
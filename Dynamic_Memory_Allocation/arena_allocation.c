@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#define ALLOC_ERR "\nERROR: could not allocate requested memory\n"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (_Alignof(max_align_t))
+#define MAX_STR_LEN 500
+#define MAX_BUFF_SIZE 1000
+#define BENCH_REQUESTS 200000
+#define BENCH_NODES 64
+#define BENCH_STRINGS 16
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+/**
+ * A block of memory owned by an arena.
+ *
+ * @param next The next block of the arena (blocks after the arena's current block are unused,
+ *             and kept so they can be reused after a reset)
+ * @param size Number of usable bytes in `data`
+ * @param used Number of bytes of `data` handed out so far
+ * @param data The block's memory
+ */
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+} ArenaBlock;
+
+/**
+ * An "arena" (or "region") allocator.
+ * Allocating only moves a pointer forward inside the current block ("bump allocation"),
+ * and nothing is ever freed individually: everything allocated from the arena is
+ * released together, by resetting it.
+ *
+ * @param first The first block of the arena
+ * @param current The block allocations are currently made from
+ * @param block_size Size of newly allocated blocks
+ */
+typedef struct arena
+{
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t block_size;
+} Arena;
+
+/**
+ * A saved position in an arena; restoring it releases everything allocated after it was saved.
+ */
+typedef struct arena_mark
+{
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+static ArenaBlock *create_block(size_t size)
+{
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+        return 0;
+
+    block->next = 0;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/**
+ * Creates an arena.
+ *
+ * @param block_size Size of each block the arena allocates (0 for the default)
+ *
+ * @returns A new arena, or NULL on error.
+ */
+Arena *create_arena(size_t block_size)
+{
+    Arena *arena = (Arena *)malloc(sizeof(Arena));
+    if (!arena)
+        return 0;
+
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    arena->first = create_block(arena->block_size);
+    if (!(arena->first))
+    {
+        free(arena);
+        return 0;
+    }
+    arena->current = arena->first;
+    return arena;
+}
+
+/**
+ * Allocates `size` bytes from an arena, aligned for any type.
+ * When the current block is full, the allocation moves on to the next block - reusing
+ * a block left over from before a reset if it's big enough, or allocating a new one.
+ *
+ * @returns The allocated memory (which must NOT be passed to `free`), or NULL on error.
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    if (!arena)
+        return 0;
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    ArenaBlock *block = arena->current;
+    if (block->size - block->used < size)
+    {
+        ArenaBlock *next = block->next;
+        if (!next || next->size < size)
+        {
+            // Oversized requests get a block of their own
+            next = create_block(size > arena->block_size ? size : arena->block_size);
+            if (!next)
+                return 0;
+            next->next = block->next;
+            block->next = next;
+        }
+        next->used = 0;
+        arena->current = block = next;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/**
+ * @brief Saves the current position of an arena.
+ */
+ArenaMark arena_mark(Arena *arena)
+{
+    ArenaMark mark = {0, 0};
+    if (arena)
+    {
+        mark.block = arena->current;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+/**
+ * @brief Releases everything allocated from an arena since `mark` was saved.
+ *        The blocks are kept for reuse.
+ */
+void arena_restore(Arena *arena, ArenaMark mark)
+{
+    if (!arena || !mark.block)
+        return;
+
+    arena->current = mark.block;
+    arena->current->used = mark.used;
+}
+
+/**
+ * @brief Releases everything allocated from an arena at once. The blocks are kept for reuse.
+ */
+void arena_reset(Arena *arena)
+{
+    if (!arena)
+        return;
+
+    arena->current = arena->first;
+    arena->current->used = 0;
+}
+
+/**
+ * @brief Frees an arena and all of its blocks, and points the given arena to NULL.
+ */
+void destroy_arena(Arena **arena)
+{
+    if (!arena || !(*arena))
+        return;
+
+    ArenaBlock *scan = (*arena)->first;
+    while (scan)
+    {
+        ArenaBlock *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    free(*arena);
+    (*arena) = 0;
+}
+
+int strlen_pointer(char *str)
+{
+    if (!str)
+        return 0;
+
+    char *scan = str;
+    while (*scan)
+        scan++;
+
+    return (scan - str);
+}
+
+/**
+ * `strdup_pointer` from pointer_arithmetic_examples.c.
+ */
+char *strdup_pointer(char *src)
+{
+    if (!src)
+        return 0;
+
+    int length = strlen_pointer(src);
+    char *copy = (char *)malloc((length + 1) * sizeof(char));
+    if (!copy)
+        return 0;
+
+    memcpy(copy, src, length + 1);
+    return copy;
+}
+
+/**
+ * Returns a deep-copy of a given string, allocated from an arena.
+ *
+ * @returns A copy of `src` (released with the arena), or NULL on error.
+ */
+char *arena_strdup(Arena *arena, char *src)
+{
+    if (!src)
+        return 0;
+
+    int length = strlen_pointer(src);
+    char *copy = (char *)arena_alloc(arena, length + 1);
+    if (!copy)
+        return 0;
+
+    memcpy(copy, src, length + 1);
+    return copy;
+}
+
+/**
+ * Finds the nth string in a buffer, as `nth_string` in pointer_arithmetic_examples.c does.
+ *
+ * @param arena If not NULL, the copy of the string is allocated from this arena,
+ *              otherwise it's allocated with `malloc`
+ *
+ * @returns A copy of the string of the desired order, or NULL if
+ *          no complete string of that ordered was found.
+ */
+char *arena_nth_string(Arena *arena, char *buffer, int n)
+{
+    if (!buffer || n <= 0)
+        return 0;
+
+    char *first_loc = buffer;
+    int str_len = 0;
+    bool started_next = false;
+
+    while ((buffer - first_loc) < MAX_BUFF_SIZE)
+    {
+        if (str_len >= MAX_STR_LEN)
+            return 0;
+        if (started_next)
+        {
+            str_len = 0;
+            started_next = false;
+        }
+        if (*buffer == '\0')
+        {
+            n--;
+            started_next = true;
+        }
+        if (n == 0)
+            return arena ? arena_strdup(arena, buffer - str_len) : strdup_pointer(buffer - str_len);
+
+        buffer++;
+        str_len++;
+    }
+
+    return 0;
+}
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+/**
+ * @brief Creates a node allocated from an arena.
+ *
+ * @returns A new node (released with the arena), or NULL on error.
+ */
+Node *arena_create_node(Arena *arena, int value)
+{
+    Node *new_node = (Node *)arena_alloc(arena, sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+Node *create_list(const int *values, int num_values)
+{
+    if (!values || num_values <= 0)
+        return 0;
+
+    Node *head = create_node(values[0]);
+    for (int i = 1; head && i < num_values; i++)
+    {
+        Node *new_node = create_node(values[i]);
+        if (!new_node)
+            break;
+        new_node->next = head;
+        head = new_node;
+    }
+
+    return head;
+}
+
+/**
+ * Creates a linked list from an array of values, with every node allocated from an arena.
+ * There's no matching `destroy_list`: the nodes are released with the arena.
+ *
+ * @returns The head of the new list, or NULL on error.
+ */
+Node *arena_create_list(Arena *arena, const int *values, int num_values)
+{
+    if (!values || num_values <= 0)
+        return 0;
+
+    Node *head = arena_create_node(arena, values[0]);
+    for (int i = 1; head && i < num_values; i++)
+    {
+        Node *new_node = arena_create_node(arena, values[i]);
+        if (!new_node)
+            break;
+        new_node->next = head;
+        head = new_node;
+    }
+
+    return head;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+void print_list(Node **list)
+{
+    printf("List: ");
+    if (!list || !(*list))
+    {
+        printf("List is empty!\n");
+        return;
+    }
+
+    for (Node *scan = (*list); scan; scan = scan->next)
+        printf("%d ", scan->value);
+    printf("\n");
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    printf("*********************************ARENA ALLOCATION:*********************************\n");
+    // Many programs handle "requests": each one creates a bunch of temporary objects
+    // (strings, lists, ...) which are all thrown away once the request is done.
+    // With `malloc`, every one of those objects must be freed individually - and it's
+    // easy to miss one. An arena hands out memory from large blocks, and releases all
+    // of it with a single call.
+
+    Arena *arena = create_arena(0);
+    if (!arena)
+    {
+        printf(ALLOC_ERR);
+        return 0;
+    }
+
+    char buffer[MAX_BUFF_SIZE] = {};
+    strcpy(buffer, "This is a sentence.");
+    strcpy(buffer + 20, "This is another sentence.");
+
+    int values[5] = {1, 2, 3, 4, 5};
+    Node *list = arena_create_list(arena, values, 5);
+    print_list(&list);
+
+    // A mark lets us release only what was allocated after it:
+    ArenaMark mark = arena_mark(arena);
+    char *second = arena_nth_string(arena, buffer, 2);
+    printf("The second string in the buffer is:\n%s\n", second);
+    arena_restore(arena, mark); // `second` is released, `list` is still valid
+    print_list(&list);
+
+    // And a reset releases everything, in O(1):
+    arena_reset(arena);
+    list = 0;
+    second = 0;
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // Each "request" builds a list of BENCH_NODES nodes, and copies BENCH_STRINGS strings
+    // out of the buffer; then everything is released.
+    int node_values[BENCH_NODES];
+    for (int i = 0; i < BENCH_NODES; i++)
+        node_values[i] = i;
+    char *strings[BENCH_STRINGS];
+    long checksum = 0;
+
+    double start = now_seconds();
+    for (int request = 0; request < BENCH_REQUESTS; request++)
+    {
+        Node *nodes = create_list(node_values, BENCH_NODES);
+        for (int i = 0; i < BENCH_STRINGS; i++)
+            strings[i] = arena_nth_string(0, buffer, 1 + (i & 1));
+        checksum += nodes->value + strings[BENCH_STRINGS - 1][0];
+
+        destroy_list(&nodes);
+        for (int i = 0; i < BENCH_STRINGS; i++)
+            free(strings[i]);
+    }
+    double malloc_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int request = 0; request < BENCH_REQUESTS; request++)
+    {
+        Node *nodes = arena_create_list(arena, node_values, BENCH_NODES);
+        for (int i = 0; i < BENCH_STRINGS; i++)
+            strings[i] = arena_nth_string(arena, buffer, 1 + (i & 1));
+        checksum -= nodes->value + strings[BENCH_STRINGS - 1][0];
+
+        arena_reset(arena);
+    }
+    double arena_time = now_seconds() - start;
+
+    printf("%d requests of %d nodes and %d strings each%s:\n", BENCH_REQUESTS, BENCH_NODES, BENCH_STRINGS,
+           checksum ? " (RESULTS DIFFER)" : "");
+    printf("  malloc/free: %.3f s\n", malloc_time);
+    printf("  Arena:       %.3f s (%.1fx faster)\n", arena_time, malloc_time / arena_time);
+
+    destroy_arena(&arena);
+
+    return 0;
+}
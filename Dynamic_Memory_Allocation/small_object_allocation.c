@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define ALLOC_ERR "\nERROR: could not allocate requested memory\n"
+
+#define SIZE_CLASS_STEP 16
+#define NUM_SIZE_CLASSES 8 // Objects of up to 8 * 16 = 128 bytes
+#define MAX_SMALL_SIZE (NUM_SIZE_CLASSES * SIZE_CLASS_STEP)
+#define BATCH_SIZE 64      // Objects moved between a thread cache and the depot at once
+#define CHUNK_SIZE (64 * 1024)
+#define MAX_STACK_SIZE 10
+#define BENCH_ROUNDS 2000
+#define BENCH_OBJECTS 1000
+#define MAX_BENCH_THREADS 8
+
+/**
+ * A free object. While an object is free, its own memory is used to link it
+ * to the other free objects (every size class is at least 16 bytes, so both pointers fit).
+ *
+ * @param next The next free object in the same list
+ * @param next_batch In the depot: the first object of the next batch
+ */
+typedef struct free_object
+{
+    struct free_object *next;
+    struct free_object *next_batch;
+} FreeObject;
+
+/**
+ * The global "depot": for every size class, a stack of batches of BATCH_SIZE free objects.
+ * Threads only come here (and take the lock) once every BATCH_SIZE allocations or frees.
+ */
+static struct
+{
+    pthread_mutex_t lock;
+    FreeObject *batches[NUM_SIZE_CLASSES];
+} depot = {PTHREAD_MUTEX_INITIALIZER, {0}};
+
+/**
+ * A thread's private cache of free objects: one list per size class.
+ * No other thread ever touches it, so allocating and freeing need no locks at all.
+ */
+typedef struct thread_cache
+{
+    FreeObject *lists[NUM_SIZE_CLASSES];
+    int counts[NUM_SIZE_CLASSES];
+} ThreadCache;
+
+static __thread ThreadCache cache = {{0}, {0}};
+static __thread int cache_registered = 0;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+static int size_class(size_t size)
+{
+    return (int)((size + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP) - 1;
+}
+
+static void depot_push(int class, FreeObject *batch)
+{
+    pthread_mutex_lock(&depot.lock);
+    batch->next_batch = depot.batches[class];
+    depot.batches[class] = batch;
+    pthread_mutex_unlock(&depot.lock);
+}
+
+/**
+ * @brief Returns all of the calling thread's cached objects to the depot.
+ *        Runs automatically when a thread exits.
+ */
+static void flush_cache(void *arg)
+{
+    (void)arg;
+    for (int class = 0; class < NUM_SIZE_CLASSES; class++)
+    {
+        while (cache.lists[class])
+        {
+            // Cut off (up to) BATCH_SIZE objects and hand them over as one batch
+            FreeObject *batch = cache.lists[class];
+            FreeObject *last = batch;
+            for (int i = 1; i < BATCH_SIZE && last->next; i++)
+                last = last->next;
+            cache.lists[class] = last->next;
+            last->next = 0;
+            depot_push(class, batch);
+        }
+        cache.counts[class] = 0;
+    }
+}
+
+static void create_cache_key(void)
+{
+    pthread_key_create(&cache_key, &flush_cache);
+}
+
+/**
+ * Carves a new chunk of memory into objects of a size class, and puts them in the depot.
+ * Chunks are never returned to the system; their objects are recycled instead.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+static int grow_class(int class)
+{
+    size_t object_size = (size_t)(class + 1) * SIZE_CLASS_STEP;
+    char *chunk = (char *)malloc(CHUNK_SIZE);
+    if (!chunk)
+        return 0;
+
+    int num_objects = (int)(CHUNK_SIZE / object_size);
+    for (int first = 0; first < num_objects; first += BATCH_SIZE)
+    {
+        int last = first + BATCH_SIZE < num_objects ? first + BATCH_SIZE : num_objects;
+        for (int i = first; i < last; i++)
+            ((FreeObject *)(chunk + i * object_size))->next = (i + 1 < last) ? (FreeObject *)(chunk + (i + 1) * object_size) : 0;
+        depot_push(class, (FreeObject *)(chunk + first * object_size));
+    }
+    return 1;
+}
+
+/**
+ * @brief Makes sure the calling thread's cache is handed back to the depot when the thread exits.
+ *        Called the first time a thread puts objects in its cache, whether by allocating or freeing.
+ */
+static inline void register_cache(void)
+{
+    if (cache_registered)
+        return;
+    pthread_once(&cache_key_once, &create_cache_key);
+    pthread_setspecific(cache_key, &cache);
+    cache_registered = 1;
+}
+
+/**
+ * @brief Moves one batch from the depot into the thread cache, growing the depot if it's empty.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+static int refill_cache(int class)
+{
+    register_cache();
+
+    pthread_mutex_lock(&depot.lock);
+    FreeObject *batch = depot.batches[class];
+    if (batch)
+        depot.batches[class] = batch->next_batch;
+    pthread_mutex_unlock(&depot.lock);
+
+    if (!batch)
+    {
+        if (!grow_class(class))
+            return 0;
+        return refill_cache(class);
+    }
+
+    int count = 0;
+    for (FreeObject *scan = batch; scan; scan = scan->next)
+        count++;
+    cache.lists[class] = batch;
+    cache.counts[class] = count;
+    return 1;
+}
+
+/**
+ * Allocates an object of `size` bytes.
+ * Objects of up to MAX_SMALL_SIZE bytes come from the calling thread's cache;
+ * larger ones are passed on to `malloc`.
+ *
+ * @returns The object, which must be freed with `so_free` and the same `size`, or NULL on error.
+ */
+void *so_alloc(size_t size)
+{
+    if (!size)
+        return 0;
+    if (size > MAX_SMALL_SIZE)
+        return malloc(size);
+
+    int class = size_class(size);
+    if (!cache.lists[class] && !refill_cache(class))
+        return 0;
+
+    FreeObject *object = cache.lists[class];
+    cache.lists[class] = object->next;
+    cache.counts[class]--;
+    return object;
+}
+
+/**
+ * @brief Like `so_alloc`, but the object is zeroed.
+ */
+void *so_calloc(size_t size)
+{
+    void *object = so_alloc(size);
+    if (object)
+        memset(object, 0, size);
+    return object;
+}
+
+/**
+ * Frees an object allocated by `so_alloc`.
+ * An object can be freed by ANY thread, not just the one that allocated it: it goes into the
+ * freeing thread's cache, and once that cache holds two batches' worth of objects, a batch
+ * goes back to the depot - where the allocating thread will pick it up on its next refill.
+ *
+ * @param object The object
+ * @param size The size that was passed to `so_alloc`
+ */
+void so_free(void *object, size_t size)
+{
+    if (!object)
+        return;
+    if (size > MAX_SMALL_SIZE)
+    {
+        free(object);
+        return;
+    }
+
+    register_cache();
+
+    int class = size_class(size);
+    FreeObject *freed = (FreeObject *)object;
+    freed->next = cache.lists[class];
+    cache.lists[class] = freed;
+
+    if (++(cache.counts[class]) >= 2 * BATCH_SIZE)
+    {
+        FreeObject *last = freed;
+        for (int i = 1; i < BATCH_SIZE; i++)
+            last = last->next;
+        cache.lists[class] = last->next;
+        last->next = 0;
+        cache.counts[class] -= BATCH_SIZE;
+        depot_push(class, freed);
+    }
+}
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)so_alloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        so_free(temp, sizeof(Node));
+    }
+
+    (*list) = 0;
+}
+
+typedef struct stack
+{
+    int *stack_arr;
+    int size;
+    int *top;
+} Stack;
+
+Stack *create_stack(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    Stack *stack = (Stack *)so_calloc(sizeof(Stack));
+    if (!stack)
+        return 0;
+
+    // One extra slot, since `push` moves `top` BEFORE writing the value
+    stack->stack_arr = (int *)so_calloc((size + 1) * sizeof(int));
+    if (!(stack->stack_arr))
+    {
+        so_free(stack, sizeof(Stack));
+        return 0;
+    }
+    stack->size = size;
+    stack->top = stack->stack_arr;
+
+    return stack;
+}
+
+void destroy_stack(Stack *stack)
+{
+    if (!stack)
+        return;
+
+    so_free(stack->stack_arr, (stack->size + 1) * sizeof(int));
+    so_free(stack, sizeof(Stack));
+}
+
+typedef struct point_instance
+{
+    float x, y;
+} point_instance;
+
+point_instance *pb_constructor(float x, float y)
+{
+    point_instance *point = (point_instance *)so_calloc(sizeof(point_instance));
+    if (point)
+    {
+        point->x = x;
+        point->y = y;
+    }
+    return point;
+}
+
+void pb_destructor(void **instance)
+{
+    if (!instance || !*instance)
+        return;
+    so_free(*instance, sizeof(point_instance));
+    *instance = 0;
+}
+
+typedef struct bench_args
+{
+    int use_so;
+    int index, num_threads;
+    void **objects; // Shared between all threads: BENCH_OBJECTS slots per thread
+    pthread_barrier_t *barrier;
+} BenchArgs;
+
+static void *bench_thread(void *arg)
+{
+    BenchArgs *args = (BenchArgs *)arg;
+    // Node, Stack and 72-byte objects, in turn
+    size_t sizes[3] = {sizeof(Node), sizeof(Stack), 72};
+
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        void **mine = args->objects + (size_t)args->index * BENCH_OBJECTS;
+        for (int i = 0; i < BENCH_OBJECTS; i++)
+            mine[i] = args->use_so ? so_alloc(sizes[i % 3]) : malloc(sizes[i % 3]);
+
+        // Every other round, free a NEIGHBOUR's objects, to exercise frees on a different thread
+        void **victim = mine;
+        if (round % 2)
+        {
+            pthread_barrier_wait(args->barrier);
+            victim = args->objects + (size_t)((args->index + 1) % args->num_threads) * BENCH_OBJECTS;
+        }
+        for (int i = 0; i < BENCH_OBJECTS; i++)
+        {
+            if (args->use_so)
+                so_free(victim[i], sizes[i % 3]);
+            else
+                free(victim[i]);
+        }
+        if (round % 2)
+            pthread_barrier_wait(args->barrier);
+    }
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @returns Allocation/free pairs per second, for `num_threads` threads.
+ */
+static double run_bench(int num_threads, int use_so)
+{
+    void **objects = (void **)malloc((size_t)num_threads * BENCH_OBJECTS * sizeof(void *));
+    if (!objects)
+        return 0;
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, 0, num_threads);
+    pthread_t threads[MAX_BENCH_THREADS];
+    BenchArgs args[MAX_BENCH_THREADS];
+
+    double start = now_seconds();
+    for (int i = 0; i < num_threads; i++)
+    {
+        args[i] = (BenchArgs){use_so, i, num_threads, objects, &barrier};
+        pthread_create(&threads[i], 0, &bench_thread, &args[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], 0);
+    double elapsed = now_seconds() - start;
+
+    pthread_barrier_destroy(&barrier);
+    free(objects);
+    return (double)num_threads * BENCH_ROUNDS * BENCH_OBJECTS / elapsed;
+}
+
+int main(void)
+{
+    printf("*********************************SMALL OBJECT ALLOCATION:*********************************\n");
+    // `Node`s, `Stack`s and points are tiny, and they're created and destroyed all the time.
+    // `malloc` is a general-purpose allocator, and when many threads use it at once they
+    // compete for its internal locks. Our allocator rounds every small size up to a multiple
+    // of 16 bytes (a "size class"), and gives every thread its own cache of free objects
+    // for each class, so most allocations are just "take the first object off a list".
+
+    Node *list = 0;
+    for (int i = 1; i <= 5; i++)
+    {
+        Node *new_node = create_node(i);
+        if (!new_node)
+        {
+            printf(ALLOC_ERR);
+            return 0;
+        }
+        new_node->next = list;
+        list = new_node;
+    }
+    printf("List: ");
+    for (Node *scan = list; scan; scan = scan->next)
+        printf("%d ", scan->value);
+    printf("\n");
+    destroy_list(&list);
+
+    // A freed object goes back to the cache, and is the first one handed out next time:
+    Node *first = create_node(1);
+    Node *old_address = first;
+    destroy_list(&first);
+    first = create_node(2);
+    printf("A new node %s the memory of the node freed before it\n", first == old_address ? "reuses" : "does NOT reuse");
+    destroy_list(&first);
+
+    Stack *stack = create_stack(MAX_STACK_SIZE);
+    point_instance *point = pb_constructor(1, 2);
+    if (stack && point)
+        printf("Stack of size %d and point (%.2f,%.2f) allocated\n", stack->size, point->x, point->y);
+    destroy_stack(stack);
+    pb_destructor((void **)&point);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("Threads | glibc malloc/free | so_alloc/so_free (millions of pairs per second)\n");
+    for (int threads = 1; threads <= MAX_BENCH_THREADS; threads *= 2)
+    {
+        double glibc = run_bench(threads, 0);
+        double so = run_bench(threads, 1);
+        printf("%7d | %17.2f | %16.2f\n", threads, glibc / 1e6, so / 1e6);
+    }
+
+    return 0;
+}
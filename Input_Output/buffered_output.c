@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#define OUT_BUFF_SIZE (1 << 16)
+#define MAX_STACK_SIZE 10
+#define BENCH_SIZE 10000000
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+typedef struct stack
+{
+    int *stack_arr;
+    int size;
+    int *top;
+} Stack;
+
+/**
+ * A buffered output writer.
+ * Output is collected in `buffer`, and written to `fd` with a single
+ * `write` call once the buffer fills up, instead of one `printf` per value.
+ *
+ * @param fd File descriptor to write to
+ * @param length Number of bytes currently in `buffer`
+ * @param buffer The buffered output
+ */
+typedef struct out_writer
+{
+    int fd;
+    size_t length;
+    char buffer[OUT_BUFF_SIZE];
+} OutWriter;
+
+// Every pair of decimal digits "00".."99", so we can convert
+// two digits of a number at a time.
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * @brief Creates a writer for a given file descriptor.
+ *
+ * @returns A new writer, or NULL on error.
+ */
+OutWriter *create_writer(int fd)
+{
+    if (fd < 0)
+        return 0;
+
+    OutWriter *writer = (OutWriter *)malloc(sizeof(OutWriter));
+    if (!writer)
+        return 0;
+
+    writer->fd = fd;
+    writer->length = 0;
+    return writer;
+}
+
+/**
+ * Writes `length` bytes to a file descriptor, retrying on partial writes.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+static int write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0)
+            return 0;
+        data += written;
+        length -= written;
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes out everything that is currently buffered.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int writer_flush(OutWriter *writer)
+{
+    if (!writer)
+        return 0;
+
+    int res = write_all(writer->fd, writer->buffer, writer->length);
+    writer->length = 0;
+    return res;
+}
+
+/**
+ * Appends bytes to the writer.
+ * If the bytes don't fit in the buffer, the buffer and the bytes are
+ * written together with a single `writev` call, without copying.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int writer_put_bytes(OutWriter *writer, const char *data, size_t length)
+{
+    if (!writer || !data)
+        return 0;
+
+    if (writer->length + length <= OUT_BUFF_SIZE)
+    {
+        memcpy(writer->buffer + writer->length, data, length);
+        writer->length += length;
+        return 1;
+    }
+
+    struct iovec parts[2] = {{writer->buffer, writer->length}, {(void *)data, length}};
+    ssize_t written = writev(writer->fd, parts, 2);
+    if (written < 0)
+        return 0;
+
+    // On a partial write, fall back to writing whatever remains
+    size_t done = (size_t)written;
+    if (done < writer->length)
+    {
+        if (!write_all(writer->fd, writer->buffer + done, writer->length - done))
+            return 0;
+        done = writer->length;
+    }
+    done -= writer->length;
+    writer->length = 0;
+    return write_all(writer->fd, data + done, length - done);
+}
+
+int writer_put_string(OutWriter *writer, const char *str)
+{
+    if (!str)
+        return 0;
+    return writer_put_bytes(writer, str, strlen(str));
+}
+
+int writer_put_char(OutWriter *writer, char c)
+{
+    if (!writer)
+        return 0;
+    if (writer->length == OUT_BUFF_SIZE && !writer_flush(writer))
+        return 0;
+
+    writer->buffer[writer->length++] = c;
+    return 1;
+}
+
+/**
+ * Appends the decimal representation of an `int` to the writer.
+ * The digits are produced from the END of a small scratch buffer,
+ * two at a time, using the `digit_pairs` table.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int writer_put_int(OutWriter *writer, int value)
+{
+    if (!writer)
+        return 0;
+    if (writer->length + 12 > OUT_BUFF_SIZE && !writer_flush(writer))
+        return 0;
+
+    char digits[12];
+    char *end = digits + sizeof(digits);
+    char *scan = end;
+
+    // Working with an unsigned value lets us handle INT_MIN
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    while (magnitude >= 100)
+    {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        scan -= 2;
+        scan[0] = digit_pairs[pair];
+        scan[1] = digit_pairs[pair + 1];
+    }
+    if (magnitude >= 10)
+    {
+        scan -= 2;
+        scan[0] = digit_pairs[magnitude * 2];
+        scan[1] = digit_pairs[magnitude * 2 + 1];
+    }
+    else
+        *(--scan) = (char)('0' + magnitude);
+    if (value < 0)
+        *(--scan) = '-';
+
+    memcpy(writer->buffer + writer->length, scan, end - scan);
+    writer->length += end - scan;
+    return 1;
+}
+
+/**
+ * @brief Flushes and destroys a writer. The file descriptor is NOT closed.
+ */
+void destroy_writer(OutWriter **writer)
+{
+    if (!writer || !(*writer))
+        return;
+
+    writer_flush(*writer);
+    free(*writer);
+    (*writer) = 0;
+}
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+void insert_node(Node **list, Node *new_node)
+{
+    if (!new_node || !list)
+        return;
+
+    new_node->next = (*list);
+    (*list) = new_node;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+/**
+ * The `print_list` from double_pointer_implementation.c, with the
+ * output going through a writer instead of `printf`.
+ */
+void print_list(Node **list, OutWriter *writer)
+{
+    writer_put_string(writer, "List: ");
+    if (!list)
+    {
+        writer_put_string(writer, "NULL pointer to list\n");
+        return;
+    }
+    else if (!(*list))
+        writer_put_string(writer, "List is empty!");
+
+    for (Node *scan = (*list); scan; scan = scan->next)
+    {
+        writer_put_int(writer, scan->value);
+        writer_put_char(writer, ' ');
+    }
+    writer_put_char(writer, '\n');
+}
+
+Stack *create_stack(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    Stack *stack = (Stack *)calloc(1, sizeof(Stack));
+    if (!stack)
+        return 0;
+
+    // One extra slot, since `top` is moved BEFORE a value is written by `push`
+    stack->stack_arr = (int *)calloc(size + 1, sizeof(int));
+    if (!(stack->stack_arr))
+    {
+        free(stack);
+        return 0;
+    }
+    stack->size = size;
+    stack->top = stack->stack_arr;
+
+    return stack;
+}
+
+int is_empty(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr) || (stack->top == stack->stack_arr))
+        return 1;
+    return 0;
+}
+
+int is_full(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr))
+        return 0;
+    return (stack->top - stack->stack_arr) == stack->size;
+}
+
+int push(Stack *stack, int value)
+{
+    if (!stack || !(stack->stack_arr) || is_full(stack))
+        return 0;
+
+    stack->top++;
+    *(stack->top) = value;
+    return 1;
+}
+
+int pop(Stack *stack)
+{
+    if (!stack || !(stack->top) || is_empty(stack))
+        return INT_MAX;
+
+    int top = *(stack->top);
+    stack->top--;
+    return top;
+}
+
+void destroy_stack(Stack *stack)
+{
+    if (!stack)
+        return;
+
+    free(stack->stack_arr);
+    free(stack);
+}
+
+/**
+ * @brief Pops every element of a stack, and writes one element per line,
+ *        as is done in pointers_overview_continued.c.
+ */
+void dump_stack(Stack *stack, OutWriter *writer)
+{
+    while (!is_empty(stack))
+    {
+        writer_put_int(writer, pop(stack));
+        writer_put_char(writer, '\n');
+    }
+}
+
+/**
+ * @brief Writes a row-major `rows`x`cols` matrix, one row per line.
+ */
+void print_matrix(const int *matrix, int rows, int cols, OutWriter *writer)
+{
+    if (!matrix)
+        return;
+
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+        {
+            writer_put_int(writer, *(matrix + row * cols + col));
+            writer_put_char(writer, ' ');
+        }
+        writer_put_char(writer, '\n');
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    printf("*********************************BUFFERED OUTPUT:*********************************\n");
+    // Every call to `printf` parses its format string, locks `stdout`, and converts
+    // the number digit by digit. For a handful of values that doesn't matter, but
+    // for millions of them it's most of the program's runtime.
+    // Our writer converts integers with a lookup table, and hands the output to
+    // the operating system in large blocks.
+
+    // Anything that `printf` has buffered must be written BEFORE we write to the same fd directly
+    fflush(stdout);
+    OutWriter *writer = create_writer(STDOUT_FILENO);
+    if (!writer)
+        return 0;
+
+    Node *head = 0;
+    for (int i = 1; i <= 5; i++)
+        insert_node(&head, create_node(i * -100));
+    print_list(&head, writer);
+    destroy_list(&head);
+
+    Stack *stack = create_stack(MAX_STACK_SIZE);
+    for (int i = 0; !is_full(stack); i++)
+        push(stack, i);
+    writer_put_string(writer, "Contents of the stack are:\n");
+    dump_stack(stack, writer);
+    destroy_stack(stack);
+
+    int matrix[3 * 4];
+    for (int i = 0; i < 3 * 4; i++)
+        matrix[i] = i * i;
+    print_matrix(matrix, 3, 4, writer);
+    writer_flush(writer);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // We'll print a list of BENCH_SIZE elements to /dev/null, so that we measure the
+    // cost of formatting rather than the speed of the terminal.
+    for (int i = 0; i < BENCH_SIZE; i++)
+        insert_node(&head, create_node((int)((i * 7919LL) % 2000000011) - 1000000000));
+
+    FILE *null_file = fopen("/dev/null", "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    OutWriter *null_writer = create_writer(null_fd);
+    if (!null_file || !null_writer)
+    {
+        destroy_list(&head);
+        destroy_writer(&writer);
+        return 0;
+    }
+
+    double start = now_seconds();
+    fprintf(null_file, "List: ");
+    for (Node *scan = head; scan; scan = scan->next)
+        fprintf(null_file, "%d ", scan->value);
+    fprintf(null_file, "\n");
+    fflush(null_file);
+    double printf_time = now_seconds() - start;
+
+    start = now_seconds();
+    print_list(&head, null_writer);
+    writer_flush(null_writer);
+    double writer_time = now_seconds() - start;
+
+    printf("Printing a %d element list:\n", BENCH_SIZE);
+    printf("  printf per node: %.3f s\n", printf_time);
+    printf("  OutWriter:       %.3f s (%.1fx faster)\n", writer_time, printf_time / writer_time);
+
+    destroy_writer(&null_writer);
+    close(null_fd);
+    fclose(null_file);
+    destroy_list(&head);
+    destroy_writer(&writer);
+
+    return 0;
+}
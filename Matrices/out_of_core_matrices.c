@@ -0,0 +1,588 @@
+#define _GNU_SOURCE // For `madvise` flags
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define TILE 256               // Tiles are TILE x TILE `int`s: 256 KB, a whole number of pages
+#define PREFETCH_DISTANCE 4    // How many tiles ahead we ask the kernel to read
+#define BENCH_GEMM_SIZE 1536
+#define BENCH_REDUCE_SIZE 16384 // 1 GB; give a size on the command line to go past RAM
+#define BENCH_DIR "/tmp"
+
+/*
+ * Usage: ./out_of_core_matrices [size [directory]]
+ * Runs the reductions on a `size`x`size` matrix stored in `directory` (default /tmp).
+ * E.g. a size of 50000 is a 9.3 GB matrix - make it more than this machine's RAM to see
+ * it still work.
+ */
+
+/**
+ * A row-major `rows`x`cols` matrix of `int`s in memory, as in parallel_kernels.c.
+ * Element (row,col) is at `data + row * cols + col`.
+ */
+typedef struct matrix
+{
+    int *data;
+    int rows, cols;
+} Matrix;
+
+/**
+ * A matrix stored in a file, and mapped into memory with `mmap`, so it can be larger than RAM:
+ * the kernel reads the pages we touch from the file, and writes back the ones we changed.
+ *
+ * The file is a grid of TILE x TILE tiles, tile after tile (row by row of tiles), and each
+ * tile is a small row-major matrix of its own. So element (row,col) of tile `tile` is at
+ * `tile + row * TILE + col` - the usual arithmetic - and every tile is one contiguous
+ * range of the file. Going through the matrix tile by tile reads the file in order, and
+ * a finished tile can be dropped from memory as a whole.
+ *
+ * @param data Start of the mapping
+ * @param map_size Size of the mapping (and the file) in bytes
+ * @param rows, cols Dimensions of the matrix
+ * @param tile_rows, tile_cols Dimensions of the grid of tiles (the last ones are padded with zeros)
+ * @param fd The file
+ */
+typedef struct mapped_matrix
+{
+    int *data;
+    size_t map_size;
+    int rows, cols;
+    int tile_rows, tile_cols;
+    int fd;
+} MappedMatrix;
+
+/**
+ * Creates a zeroed matrix in a new file (replacing any file with that name).
+ * The file's disk space is allocated up front, so running out of space makes this fail
+ * instead of crashing the program (with SIGBUS) when a page of the mapping is first written.
+ *
+ * @returns A new matrix, or NULL on error.
+ */
+MappedMatrix *create_mapped_matrix(const char *path, int rows, int cols)
+{
+    if (!path || rows <= 0 || cols <= 0)
+        return 0;
+
+    MappedMatrix *matrix = (MappedMatrix *)calloc(1, sizeof(MappedMatrix));
+    if (!matrix)
+        return 0;
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->tile_rows = (rows + TILE - 1) / TILE;
+    matrix->tile_cols = (cols + TILE - 1) / TILE;
+    matrix->map_size = (size_t)matrix->tile_rows * matrix->tile_cols * TILE * TILE * sizeof(int);
+
+    matrix->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (matrix->fd < 0)
+    {
+        free(matrix);
+        return 0;
+    }
+    // Unlike most calls, `posix_fallocate` returns the error number instead of -1
+    if (posix_fallocate(matrix->fd, 0, (off_t)matrix->map_size))
+    {
+        close(matrix->fd);
+        unlink(path);
+        free(matrix);
+        return 0;
+    }
+
+    void *data = mmap(0, matrix->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, matrix->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(matrix->fd);
+        unlink(path);
+        free(matrix);
+        return 0;
+    }
+    matrix->data = (int *)data;
+    return matrix;
+}
+
+/**
+ * @brief Unmaps a matrix (the kernel writes back what's still unwritten) and closes its file.
+ *
+ * @param path If not NULL, the matrix's file, which is then deleted
+ */
+void destroy_mapped_matrix(MappedMatrix **matrix, const char *path)
+{
+    if (!matrix || !(*matrix))
+        return;
+
+    munmap((*matrix)->data, (*matrix)->map_size);
+    close((*matrix)->fd);
+    if (path)
+        unlink(path);
+    free(*matrix);
+    (*matrix) = 0;
+}
+
+/**
+ * @brief Returns the tile at (tile_row, tile_col) of the grid of tiles.
+ *        Its element (row,col) is at `tile + row * TILE + col`.
+ */
+static inline int *tile_at(const MappedMatrix *matrix, int tile_row, int tile_col)
+{
+    return matrix->data + ((size_t)tile_row * matrix->tile_cols + tile_col) * TILE * TILE;
+}
+
+/**
+ * @brief Returns a pointer to element (row,col) of a mapped matrix.
+ */
+int *mapped_at(const MappedMatrix *matrix, int row, int col)
+{
+    return tile_at(matrix, row / TILE, col / TILE) + (row % TILE) * TILE + (col % TILE);
+}
+
+/**
+ * @brief Asks the kernel to start reading a tile from the file, so it's in memory by the
+ *        time we get to it. Tiles outside the grid are ignored.
+ */
+static void prefetch_tile(const MappedMatrix *matrix, int tile_row, int tile_col)
+{
+    if (tile_row < 0 || tile_row >= matrix->tile_rows || tile_col < 0 || tile_col >= matrix->tile_cols)
+        return;
+    madvise(tile_at(matrix, tile_row, tile_col), TILE * TILE * sizeof(int), MADV_WILLNEED);
+}
+
+/**
+ * Drops a tile we're done with from our memory. Changes aren't lost: they're in the kernel's
+ * page cache, which writes them to the file, and reading the tile again brings them back.
+ * Without this, every tile we touched would stay mapped in our process, and at the size of
+ * RAM the kernel would have to guess what to evict.
+ */
+static void release_tile(const MappedMatrix *matrix, int tile_row, int tile_col)
+{
+    madvise(tile_at(matrix, tile_row, tile_col), TILE * TILE * sizeof(int), MADV_DONTNEED);
+}
+
+/**
+ * @brief Prefetches the tile PREFETCH_DISTANCE tiles after (tile_row, tile_col), in storage order.
+ */
+static void prefetch_ahead(const MappedMatrix *matrix, int tile_row, int tile_col)
+{
+    int index = tile_row * matrix->tile_cols + tile_col + PREFETCH_DISTANCE;
+    prefetch_tile(matrix, index / matrix->tile_cols, index % matrix->tile_cols);
+}
+
+/**
+ * @brief Returns the number of rows (or columns) of a tile that are inside the matrix.
+ */
+static inline int tile_extent(int tile_index, int size)
+{
+    return size - tile_index * TILE < TILE ? size - tile_index * TILE : TILE;
+}
+
+/**
+ * @brief Sets every element (row,col) of a mapped matrix to `generator(row, col, arg)`,
+ *        one tile at a time.
+ */
+void mapped_fill(MappedMatrix *matrix, int (*generator)(int, int, void *), void *arg)
+{
+    if (!matrix || !generator)
+        return;
+
+    for (int tile_row = 0; tile_row < matrix->tile_rows; tile_row++)
+    {
+        for (int tile_col = 0; tile_col < matrix->tile_cols; tile_col++)
+        {
+            int *tile = tile_at(matrix, tile_row, tile_col);
+            int rows = tile_extent(tile_row, matrix->rows), cols = tile_extent(tile_col, matrix->cols);
+            for (int row = 0; row < rows; row++)
+            {
+                for (int col = 0; col < cols; col++)
+                    *(tile + row * TILE + col) = generator(tile_row * TILE + row, tile_col * TILE + col, arg);
+            }
+            release_tile(matrix, tile_row, tile_col);
+        }
+    }
+}
+
+/**
+ * Computes the sum and the maximum of a mapped matrix, and the sum of each of its rows,
+ * in a single pass over the tiles.
+ *
+ * @param row_sums Where the sums of the rows are written (may be NULL)
+ * @param max Where the maximum is written (may be NULL)
+ *
+ * @returns The sum of all elements (0 on error).
+ */
+long long mapped_reduce(const MappedMatrix *matrix, long long *row_sums, int *max)
+{
+    if (!matrix)
+        return 0;
+
+    if (row_sums)
+        memset(row_sums, 0, matrix->rows * sizeof(long long));
+    long long total = 0;
+    int largest = INT_MIN;
+    for (int i = 0; i < PREFETCH_DISTANCE; i++)
+        prefetch_tile(matrix, i / matrix->tile_cols, i % matrix->tile_cols);
+
+    for (int tile_row = 0; tile_row < matrix->tile_rows; tile_row++)
+    {
+        for (int tile_col = 0; tile_col < matrix->tile_cols; tile_col++)
+        {
+            prefetch_ahead(matrix, tile_row, tile_col);
+            const int *tile = tile_at(matrix, tile_row, tile_col);
+            int rows = tile_extent(tile_row, matrix->rows), cols = tile_extent(tile_col, matrix->cols);
+            for (int row = 0; row < rows; row++)
+            {
+                long long sum = 0;
+                for (int col = 0; col < cols; col++)
+                {
+                    int value = *(tile + row * TILE + col);
+                    sum += value;
+                    largest = value > largest ? value : largest;
+                }
+                total += sum;
+                if (row_sums)
+                    row_sums[tile_row * TILE + row] += sum;
+            }
+            release_tile(matrix, tile_row, tile_col);
+        }
+    }
+
+    if (max)
+        *max = largest;
+    return total;
+}
+
+/**
+ * Adds the product of a `rows`x`depth` block of A and a `depth`x`cols` block of B to a
+ * TILE x TILE block of sums. The blocks are parts of row-major matrices whose rows are
+ * `a_stride` and `b_stride` elements apart (TILE inside a tile).
+ */
+static void multiply_tile(int *restrict sum, const int *restrict a, size_t a_stride, const int *restrict b,
+                          size_t b_stride, int rows, int depth, int cols)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        int *sum_row = sum + row * TILE;
+        for (int m = 0; m < depth; m++)
+        {
+            int a_value = *(a + row * a_stride + m);
+            const int *b_row = b + m * b_stride;
+            if (cols == TILE) // A constant trip count lets -O2 vectorize the loop
+            {
+                for (int col = 0; col < TILE; col++)
+                    sum_row[col] += a_value * b_row[col];
+            }
+            else
+            {
+                for (int col = 0; col < cols; col++)
+                    sum_row[col] += a_value * b_row[col];
+            }
+        }
+    }
+}
+
+/**
+ * Multiplies two mapped matrices tile by tile: c = a * b.
+ * Tile (i,j) of `c` is the sum over k of tile (i,k) of `a` times tile (k,j) of `b`. It's
+ * accumulated in a buffer in memory and written once, so at any moment only three tiles are
+ * needed - whatever the size of the matrices. The tiles of `a` and `b` for the next k are
+ * prefetched while the current ones are multiplied.
+ *
+ * @returns 1 on success, 0 if the dimensions don't match or on error.
+ */
+int mapped_multiply(MappedMatrix *c, const MappedMatrix *a, const MappedMatrix *b)
+{
+    if (!c || !a || !b || a->cols != b->rows || c->rows != a->rows || c->cols != b->cols)
+        return 0;
+
+    int *sum = (int *)malloc(TILE * TILE * sizeof(int));
+    if (!sum)
+        return 0;
+
+    for (int i = 0; i < c->tile_rows; i++)
+    {
+        for (int j = 0; j < c->tile_cols; j++)
+        {
+            memset(sum, 0, TILE * TILE * sizeof(int));
+            prefetch_tile(a, i, 0);
+            prefetch_tile(b, 0, j);
+            for (int k = 0; k < a->tile_cols; k++)
+            {
+                prefetch_tile(a, i, k + 1);
+                prefetch_tile(b, k + 1, j);
+                // Padding is zero, so whole tiles can be multiplied
+                multiply_tile(sum, tile_at(a, i, k), TILE, tile_at(b, k, j), TILE, TILE, TILE, TILE);
+                release_tile(a, i, k);
+                release_tile(b, k, j);
+            }
+            memcpy(tile_at(c, i, j), sum, TILE * TILE * sizeof(int));
+            release_tile(c, i, j);
+        }
+    }
+
+    free(sum);
+    return 1;
+}
+
+/*
+ * The same operations on matrices in memory, for comparison.
+ */
+Matrix create_matrix(int rows, int cols)
+{
+    Matrix matrix = {0, 0, 0};
+    if (rows <= 0 || cols <= 0)
+        return matrix;
+
+    matrix.data = (int *)calloc((size_t)rows * cols, sizeof(int));
+    if (!matrix.data)
+        return matrix;
+    matrix.rows = rows;
+    matrix.cols = cols;
+    return matrix;
+}
+
+void destroy_matrix(Matrix *matrix)
+{
+    if (!matrix)
+        return;
+
+    free(matrix->data);
+    matrix->data = 0;
+}
+
+void fill(Matrix *matrix, int (*generator)(int, int, void *), void *arg)
+{
+    for (int row = 0; row < matrix->rows; row++)
+    {
+        for (int col = 0; col < matrix->cols; col++)
+            *(matrix->data + (size_t)row * matrix->cols + col) = generator(row, col, arg);
+    }
+}
+
+long long reduce(const Matrix *matrix, long long *row_sums, int *max)
+{
+    long long total = 0;
+    int largest = INT_MIN;
+    for (int row = 0; row < matrix->rows; row++)
+    {
+        const int *data_row = matrix->data + (size_t)row * matrix->cols;
+        long long sum = 0;
+        for (int col = 0; col < matrix->cols; col++)
+        {
+            sum += data_row[col];
+            largest = data_row[col] > largest ? data_row[col] : largest;
+        }
+        total += sum;
+        row_sums[row] = sum;
+    }
+    *max = largest;
+    return total;
+}
+
+/**
+ * @brief The blocked multiply in memory, with the same tiles and the same kernel as
+ *        `mapped_multiply` - so only where the matrices are stored differs.
+ */
+void multiply(Matrix *c, const Matrix *a, const Matrix *b)
+{
+    int *sum = (int *)malloc(TILE * TILE * sizeof(int));
+    if (!sum)
+        return;
+
+    for (int i0 = 0; i0 < c->rows; i0 += TILE)
+    {
+        int rows = tile_extent(i0 / TILE, c->rows);
+        for (int j0 = 0; j0 < c->cols; j0 += TILE)
+        {
+            int cols = tile_extent(j0 / TILE, c->cols);
+            memset(sum, 0, TILE * TILE * sizeof(int));
+            for (int k0 = 0; k0 < a->cols; k0 += TILE)
+            {
+                multiply_tile(sum, a->data + (size_t)i0 * a->cols + k0, a->cols, b->data + (size_t)k0 * b->cols + j0,
+                              b->cols, rows, tile_extent(k0 / TILE, a->cols), cols);
+            }
+            for (int row = 0; row < rows; row++)
+                memcpy(c->data + (size_t)(i0 + row) * c->cols + j0, sum + row * TILE, cols * sizeof(int));
+        }
+    }
+    free(sum);
+}
+
+static int small_values(int row, int col, void *arg)
+{
+    (void)arg;
+    return (row * 7 + col * 13) % 10;
+}
+
+static int diagonal(int row, int col, void *arg)
+{
+    (void)arg;
+    return row == col ? 2 : (row + col) % 3;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Returns the peak amount of memory this process has had resident, in MB.
+ */
+static long peak_resident_mb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+}
+
+static long total_ram_mb(void)
+{
+    return sysconf(_SC_PHYS_PAGES) / 1024 * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief Fills and reduces a size x size mapped matrix, and shows how little of it was ever in memory.
+ */
+static void bench_out_of_core(int size, const char *dir)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/out_of_core_reduce.bin", dir);
+    double gigabytes = (double)size * size * sizeof(int) / (1 << 30);
+    printf("Reductions on a %dx%d mapped matrix: %.2f GB, RAM is %.2f GB\n", size, size, gigabytes,
+           total_ram_mb() / 1024.0);
+
+    MappedMatrix *matrix = create_mapped_matrix(path, size, size);
+    long long *row_sums = (long long *)malloc(size * sizeof(long long));
+    if (!matrix || !row_sums)
+    {
+        printf("    Couldn't create the matrix in %s\n", dir);
+        destroy_mapped_matrix(&matrix, path);
+        free(row_sums);
+        return;
+    }
+
+    double start = now_seconds();
+    mapped_fill(matrix, &small_values, 0);
+    double fill_time = now_seconds() - start;
+    printf("    Fill      | %7.2f s | %6.2f GB/s\n", fill_time, gigabytes / fill_time);
+
+    int max = 0;
+    start = now_seconds();
+    long long total = mapped_reduce(matrix, row_sums, &max);
+    double reduce_time = now_seconds() - start;
+    printf("    Reduce    | %7.2f s | %6.2f GB/s | sum %lld, max %d\n", reduce_time, gigabytes / reduce_time, total,
+           max);
+
+    // Check a few rows against their direct sums
+    bool correct = true;
+    for (int row = 0; row < size; row += size / 7 + 1)
+    {
+        long long sum = 0;
+        for (int col = 0; col < size; col++)
+            sum += small_values(row, col, 0);
+        correct = correct && sum == row_sums[row];
+    }
+    printf("    Row sums are %s; peak resident memory was %ld MB\n", correct ? "correct" : "WRONG",
+           peak_resident_mb());
+
+    destroy_mapped_matrix(&matrix, path);
+    free(row_sums);
+}
+
+/**
+ * @brief Compares the mapped and the in-memory versions on matrices that fit in memory.
+ */
+static void bench_in_memory_comparison(const char *dir)
+{
+    const int n = BENCH_GEMM_SIZE;
+    printf("A %dx%d multiply and reduce, mapped vs. in memory:\n", n, n);
+    char path_a[PATH_MAX], path_b[PATH_MAX], path_c[PATH_MAX];
+    snprintf(path_a, sizeof(path_a), "%s/out_of_core_a.bin", dir);
+    snprintf(path_b, sizeof(path_b), "%s/out_of_core_b.bin", dir);
+    snprintf(path_c, sizeof(path_c), "%s/out_of_core_c.bin", dir);
+
+    MappedMatrix *ma = create_mapped_matrix(path_a, n, n);
+    MappedMatrix *mb = create_mapped_matrix(path_b, n, n);
+    MappedMatrix *mc = create_mapped_matrix(path_c, n, n);
+    Matrix a = create_matrix(n, n), b = create_matrix(n, n), c = create_matrix(n, n);
+    long long *row_sums = (long long *)malloc(n * sizeof(long long));
+    if (ma && mb && mc && a.data && b.data && c.data && row_sums)
+    {
+        mapped_fill(ma, &small_values, 0);
+        mapped_fill(mb, &diagonal, 0);
+        fill(&a, &small_values, 0);
+        fill(&b, &diagonal, 0);
+
+        double start = now_seconds();
+        multiply(&c, &a, &b);
+        double memory_time = now_seconds() - start;
+        start = now_seconds();
+        mapped_multiply(mc, ma, mb);
+        double mapped_time = now_seconds() - start;
+        printf("    Multiply  | in memory %7.3f s | mapped %7.3f s\n", memory_time, mapped_time);
+
+        int memory_max, mapped_max;
+        start = now_seconds();
+        long long memory_total = reduce(&c, row_sums, &memory_max);
+        memory_time = now_seconds() - start;
+        start = now_seconds();
+        long long mapped_total = mapped_reduce(mc, row_sums, &mapped_max);
+        mapped_time = now_seconds() - start;
+        printf("    Reduce    | in memory %7.3f s | mapped %7.3f s\n", memory_time, mapped_time);
+
+        bool same = memory_total == mapped_total && memory_max == mapped_max;
+        for (int row = 0; same && row < n; row += 97)
+        {
+            for (int col = 0; same && col < n; col += 89)
+                same = *(c.data + (size_t)row * n + col) == *mapped_at(mc, row, col);
+        }
+        printf("    The products are %s\n", same ? "the same" : "DIFFERENT");
+    }
+
+    destroy_mapped_matrix(&ma, path_a);
+    destroy_mapped_matrix(&mb, path_b);
+    destroy_mapped_matrix(&mc, path_c);
+    destroy_matrix(&a);
+    destroy_matrix(&b);
+    destroy_matrix(&c);
+    free(row_sums);
+}
+
+int main(int argc, char **argv)
+{
+    printf("*********************************OUT-OF-CORE MATRICES:*********************************\n");
+    // A matrix in one `calloc` block must fit in memory. A matrix in a mapped file only needs
+    // the tiles we're working on to be in memory: the kernel reads them in as we go (sooner,
+    // if we tell it with `madvise`), and we tell it when we're done with them.
+    int size = argc > 1 ? atoi(argv[1]) : BENCH_REDUCE_SIZE;
+    const char *dir = argc > 2 ? argv[2] : BENCH_DIR;
+    if (size <= 0)
+    {
+        printf("Usage: %s [size [directory]]\n", argv[0]);
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/out_of_core_demo.bin", dir);
+    MappedMatrix *demo = create_mapped_matrix(path, 600, 300);
+    if (demo)
+    {
+        mapped_fill(demo, &small_values, 0);
+        printf("A 600x300 matrix in %d tiles of %dx%d; element (400,123) is %d (it should be %d)\n",
+               demo->tile_rows * demo->tile_cols, TILE, TILE, *mapped_at(demo, 400, 123), small_values(400, 123, 0));
+        destroy_mapped_matrix(&demo, path);
+    }
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+    // First, while peak resident memory only reflects the mapped matrix
+    bench_out_of_core(size, dir);
+    bench_in_memory_comparison(dir);
+    return 0;
+}
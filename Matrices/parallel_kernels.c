@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#define MAX_THREADS 64
+#define GEMM_TILE 64
+#define BENCH_ROWS 4096
+#define BENCH_COLS 4096
+#define BENCH_GEMM_SIZE 768
+
+/**
+ * A row-major `rows`x`cols` matrix of `int`s.
+ * Element (row,col) is at `data + row * cols + col`, as in pointer_arithmetic_examples.c.
+ */
+typedef struct matrix
+{
+    int *data;
+    int rows, cols;
+} Matrix;
+
+struct thread_pool;
+
+typedef struct worker_args
+{
+    struct thread_pool *pool;
+    int index;
+} WorkerArgs;
+
+/**
+ * A fixed set of worker threads, which all run the same job and then wait for the next one.
+ *
+ * @param num_threads Number of threads, including the thread that calls `pool_run`
+ * @param job The function every thread runs; it is passed the job's argument,
+ *            the thread's index and the number of threads
+ * @param job_arg Argument for `job`
+ * @param generation Incremented for every new job, so the workers know a job is waiting
+ * @param pending Number of workers that haven't finished the current job yet
+ * @param shutdown Set to `true` to make the workers exit
+ */
+typedef struct thread_pool
+{
+    int num_threads;
+    pthread_t threads[MAX_THREADS];
+    WorkerArgs worker_args[MAX_THREADS];
+    void (*job)(void *, int, int);
+    void *job_arg;
+    unsigned long generation;
+    int pending;
+    bool shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+} ThreadPool;
+
+static void *worker(void *arg)
+{
+    ThreadPool *pool = ((WorkerArgs *)arg)->pool;
+    int index = ((WorkerArgs *)arg)->index;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&(pool->lock));
+    while (true)
+    {
+        while (!pool->shutdown && pool->generation == seen)
+            pthread_cond_wait(&(pool->job_ready), &(pool->lock));
+        if (pool->shutdown)
+            break;
+        seen = pool->generation;
+
+        pthread_mutex_unlock(&(pool->lock));
+        pool->job(pool->job_arg, index, pool->num_threads);
+        pthread_mutex_lock(&(pool->lock));
+
+        if (--(pool->pending) == 0)
+            pthread_cond_signal(&(pool->job_done));
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    return 0;
+}
+
+/**
+ * Creates a thread pool.
+ *
+ * @param num_threads Total number of threads that will run each job (the calling
+ *                    thread is one of them, so `num_threads - 1` threads are created)
+ *
+ * @returns A new thread pool, or NULL on error.
+ */
+ThreadPool *create_thread_pool(int num_threads)
+{
+    if (num_threads <= 0 || num_threads > MAX_THREADS)
+        return 0;
+
+    ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+    if (!pool)
+        return 0;
+
+    pool->num_threads = num_threads;
+    pthread_mutex_init(&(pool->lock), 0);
+    pthread_cond_init(&(pool->job_ready), 0);
+    pthread_cond_init(&(pool->job_done), 0);
+
+    for (int i = 1; i < num_threads; i++)
+    {
+        pool->worker_args[i] = (WorkerArgs){pool, i};
+        if (pthread_create(&(pool->threads[i]), 0, &worker, &(pool->worker_args[i])))
+        {
+            // Run with the threads that were created
+            pool->num_threads = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+/**
+ * Runs `job` on every thread of the pool (including the calling thread, as thread 0),
+ * and returns once all of them have finished.
+ */
+void pool_run(ThreadPool *pool, void (*job)(void *, int, int), void *arg)
+{
+    if (!pool || !job)
+        return;
+
+    pthread_mutex_lock(&(pool->lock));
+    pool->job = job;
+    pool->job_arg = arg;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&(pool->job_ready));
+    pthread_mutex_unlock(&(pool->lock));
+
+    job(arg, 0, pool->num_threads);
+
+    pthread_mutex_lock(&(pool->lock));
+    while (pool->pending > 0)
+        pthread_cond_wait(&(pool->job_done), &(pool->lock));
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+void destroy_thread_pool(ThreadPool **pool)
+{
+    if (!pool || !(*pool))
+        return;
+
+    pthread_mutex_lock(&((*pool)->lock));
+    (*pool)->shutdown = true;
+    pthread_cond_broadcast(&((*pool)->job_ready));
+    pthread_mutex_unlock(&((*pool)->lock));
+
+    for (int i = 1; i < (*pool)->num_threads; i++)
+        pthread_join((*pool)->threads[i], 0);
+
+    pthread_mutex_destroy(&((*pool)->lock));
+    pthread_cond_destroy(&((*pool)->job_ready));
+    pthread_cond_destroy(&((*pool)->job_done));
+    free(*pool);
+    (*pool) = 0;
+}
+
+/**
+ * @brief Computes the block of rows [first, last) that a thread is responsible for.
+ *        Every operation below uses the same partition, so each thread keeps
+ *        working on the same rows - and on the same memory pages.
+ */
+static void row_block(int rows, int index, int num_threads, int *first, int *last)
+{
+    *first = (int)((long long)rows * index / num_threads);
+    *last = (int)((long long)rows * (index + 1) / num_threads);
+}
+
+typedef struct matrix_job
+{
+    Matrix *dst;
+    const Matrix *a, *b;
+    int (*generator)(int, int, void *);
+    void *generator_arg;
+    int (*map_func)(int);
+    int (*zip_func)(int, int);
+    long long (*reduce_func)(long long, long long);
+    long long identity;
+    long long partials[MAX_THREADS];
+} MatrixJob;
+
+static void zero_job(void *arg, int index, int num_threads)
+{
+    MatrixJob *job = (MatrixJob *)arg;
+    int first, last;
+    row_block(job->dst->rows, index, num_threads, &first, &last);
+    memset(job->dst->data + (size_t)first * job->dst->cols, 0, (size_t)(last - first) * job->dst->cols * sizeof(int));
+}
+
+/**
+ * Creates a matrix whose pages are first touched by the threads that will work on them.
+ * The operating system usually places a page in the memory closest to the CPU that first
+ * writes to it, so on multi-socket machines each thread's rows end up in its "own" memory.
+ *
+ * @returns A new zeroed matrix (with NULL `data` on error).
+ */
+Matrix create_matrix(ThreadPool *pool, int rows, int cols)
+{
+    Matrix matrix = {0, 0, 0};
+    if (!pool || rows <= 0 || cols <= 0)
+        return matrix;
+
+    // `malloc` only reserves the pages of a large block; nothing is touched until we write to it
+    matrix.data = (int *)malloc((size_t)rows * cols * sizeof(int));
+    if (!matrix.data)
+        return matrix;
+    matrix.rows = rows;
+    matrix.cols = cols;
+
+    MatrixJob job = {.dst = &matrix};
+    pool_run(pool, &zero_job, &job);
+    return matrix;
+}
+
+void destroy_matrix(Matrix *matrix)
+{
+    if (!matrix)
+        return;
+
+    free(matrix->data);
+    matrix->data = 0;
+}
+
+static void fill_job(void *arg, int index, int num_threads)
+{
+    MatrixJob *job = (MatrixJob *)arg;
+    int first, last;
+    row_block(job->dst->rows, index, num_threads, &first, &last);
+
+    for (int row = first; row < last; row++)
+    {
+        int *dst_row = job->dst->data + (size_t)row * job->dst->cols;
+        for (int col = 0; col < job->dst->cols; col++)
+            dst_row[col] = job->generator(row, col, job->generator_arg);
+    }
+}
+
+/**
+ * @brief Sets every element (row,col) of `dst` to `generator(row, col, arg)`, in parallel.
+ */
+void parallel_fill(ThreadPool *pool, Matrix *dst, int (*generator)(int, int, void *), void *arg)
+{
+    if (!pool || !dst || !(dst->data) || !generator)
+        return;
+
+    MatrixJob job = {.dst = dst, .generator = generator, .generator_arg = arg};
+    pool_run(pool, &fill_job, &job);
+}
+
+static void map_job(void *arg, int index, int num_threads)
+{
+    MatrixJob *job = (MatrixJob *)arg;
+    int first, last;
+    row_block(job->dst->rows, index, num_threads, &first, &last);
+
+    size_t start = (size_t)first * job->dst->cols, end = (size_t)last * job->dst->cols;
+    for (size_t i = start; i < end; i++)
+    {
+        if (job->zip_func)
+            job->dst->data[i] = job->zip_func(job->a->data[i], job->b->data[i]);
+        else
+            job->dst->data[i] = job->map_func(job->a->data[i]);
+    }
+}
+
+/**
+ * @brief Sets every element of `dst` to `func` of the same element of `src`, in parallel.
+ *        `dst` and `src` may be the same matrix.
+ *
+ * @returns 1 on success, 0 if the dimensions don't match or on error.
+ */
+int parallel_map(ThreadPool *pool, Matrix *dst, const Matrix *src, int (*func)(int))
+{
+    if (!pool || !dst || !src || !func || !(dst->data) || !(src->data) ||
+        dst->rows != src->rows || dst->cols != src->cols)
+        return 0;
+
+    MatrixJob job = {.dst = dst, .a = src, .map_func = func};
+    pool_run(pool, &map_job, &job);
+    return 1;
+}
+
+/**
+ * @brief Sets every element of `dst` to `func` of the same elements of `a` and `b`, in parallel.
+ *
+ * @returns 1 on success, 0 if the dimensions don't match or on error.
+ */
+int parallel_zip(ThreadPool *pool, Matrix *dst, const Matrix *a, const Matrix *b, int (*func)(int, int))
+{
+    if (!pool || !dst || !a || !b || !func || !(dst->data) || !(a->data) || !(b->data) ||
+        dst->rows != a->rows || dst->cols != a->cols || a->rows != b->rows || a->cols != b->cols)
+        return 0;
+
+    MatrixJob job = {.dst = dst, .a = a, .b = b, .zip_func = func};
+    pool_run(pool, &map_job, &job);
+    return 1;
+}
+
+static void reduce_job(void *arg, int index, int num_threads)
+{
+    MatrixJob *job = (MatrixJob *)arg;
+    int first, last;
+    row_block(job->a->rows, index, num_threads, &first, &last);
+
+    // Accumulating in a local variable (rather than in `partials`) avoids "false sharing":
+    // neighbouring partials are on the same cache line, which would bounce between the CPUs.
+    long long acc = job->identity;
+    size_t start = (size_t)first * job->a->cols, end = (size_t)last * job->a->cols;
+    for (size_t i = start; i < end; i++)
+        acc = job->reduce_func(acc, job->a->data[i]);
+    job->partials[index] = acc;
+}
+
+/**
+ * Combines all the elements of a matrix with an associative function, in parallel.
+ *
+ * @param func Associative combining function, e.g. addition or maximum
+ * @param identity The identity value of `func` (0 for addition)
+ *
+ * @returns The combined value, or `identity` on error.
+ */
+long long parallel_reduce(ThreadPool *pool, const Matrix *src, long long (*func)(long long, long long), long long identity)
+{
+    if (!pool || !src || !(src->data) || !func)
+        return identity;
+
+    MatrixJob job = {.a = src, .reduce_func = func, .identity = identity};
+    pool_run(pool, &reduce_job, &job);
+
+    long long result = identity;
+    for (int i = 0; i < pool->num_threads; i++)
+        result = func(result, job.partials[i]);
+    return result;
+}
+
+static void gemm_job(void *arg, int index, int num_threads)
+{
+    MatrixJob *job = (MatrixJob *)arg;
+    const Matrix *a = job->a, *b = job->b;
+    Matrix *c = job->dst;
+    int first, last;
+    row_block(c->rows, index, num_threads, &first, &last);
+
+    // Each thread computes its own rows of C, tile by tile, so that the tile
+    // of B being read stays in the cache while it's reused.
+    for (int k0 = 0; k0 < a->cols; k0 += GEMM_TILE)
+    {
+        int k1 = k0 + GEMM_TILE < a->cols ? k0 + GEMM_TILE : a->cols;
+        for (int j0 = 0; j0 < b->cols; j0 += GEMM_TILE)
+        {
+            int j1 = j0 + GEMM_TILE < b->cols ? j0 + GEMM_TILE : b->cols;
+            for (int row = first; row < last; row++)
+            {
+                int *c_row = c->data + (size_t)row * c->cols;
+                const int *a_row = a->data + (size_t)row * a->cols;
+                for (int k = k0; k < k1; k++)
+                {
+                    int a_val = a_row[k];
+                    const int *b_row = b->data + (size_t)k * b->cols;
+                    for (int col = j0; col < j1; col++)
+                        c_row[col] += a_val * b_row[col];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes C = A * B, in parallel.
+ *        `c` must already be allocated with the right dimensions, and is overwritten.
+ *        It can't be `a` or `b` (it's cleared before they're read), so there's no in-place version.
+ *
+ * @returns 1 on success, 0 if the dimensions don't match, `c` shares its data with `a` or `b`, or on error.
+ */
+int parallel_gemm(ThreadPool *pool, Matrix *c, const Matrix *a, const Matrix *b)
+{
+    if (!pool || !c || !a || !b || !(c->data) || !(a->data) || !(b->data) ||
+        a->cols != b->rows || c->rows != a->rows || c->cols != b->cols)
+        return 0;
+    if (c->data == a->data || c->data == b->data)
+        return 0;
+
+    MatrixJob job = {.dst = c, .a = a, .b = b};
+    pool_run(pool, &zero_job, &job);
+    pool_run(pool, &gemm_job, &job);
+    return 1;
+}
+
+static int multiplication_table(int row, int col, void *arg)
+{
+    (void)arg;
+    return (row + 1) * (col + 1);
+}
+
+static int pseudo_random(int row, int col, void *arg)
+{
+    unsigned int seed = *(unsigned int *)arg;
+    unsigned int x = (unsigned int)row * 2654435761u ^ (unsigned int)col * 40503u ^ seed;
+    return (int)(x % 7) - 3;
+}
+
+static int square(int x)
+{
+    return x * x;
+}
+
+static int add(int a, int b)
+{
+    return a + b;
+}
+
+static long long sum(long long a, long long b)
+{
+    return a + b;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    printf("*********************************PARALLEL MATRIX KERNELS:*********************************\n");
+    // Filling a matrix row by row is work that can be split up: each thread gets
+    // a contiguous block of rows, and no two threads ever write the same element.
+    // A thread pool keeps the threads alive between operations, so we pay for
+    // creating them only once.
+
+    int num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cores < 1)
+        num_cores = 1;
+    if (num_cores > MAX_THREADS)
+        num_cores = MAX_THREADS;
+
+    ThreadPool *pool = create_thread_pool(num_cores);
+    if (!pool)
+        return 0;
+
+    Matrix table = create_matrix(pool, 10, 10);
+    parallel_fill(pool, &table, &multiplication_table, 0);
+    printf("The (7,4) element in the table is: %d\n", *(table.data + 6 * table.cols + 3));
+
+    parallel_map(pool, &table, &table, &square);
+    printf("After squaring every element, (7,4) is: %d\n", *(table.data + 6 * table.cols + 3));
+    printf("The sum of all the elements is: %lld\n", parallel_reduce(pool, &table, &sum, 0));
+
+    Matrix identity = create_matrix(pool, 10, 10);
+    for (int i = 0; i < 10; i++)
+        *(identity.data + i * identity.cols + i) = 1;
+    Matrix product = create_matrix(pool, 10, 10);
+    parallel_gemm(pool, &product, &table, &identity);
+    printf("(7,4) of table * I is: %d\n", *(product.data + 6 * product.cols + 3));
+
+    destroy_matrix(&table);
+    destroy_matrix(&identity);
+    destroy_matrix(&product);
+    destroy_thread_pool(&pool);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("%d cores online\n", num_cores);
+    printf("Threads | fill %dx%d | zip | reduce | gemm %dx%d\n", BENCH_ROWS, BENCH_COLS, BENCH_GEMM_SIZE, BENCH_GEMM_SIZE);
+
+    unsigned int seed = 12345;
+    for (int threads = 1; threads <= num_cores; threads = (threads * 2 < num_cores) ? threads * 2 : num_cores)
+    {
+        pool = create_thread_pool(threads);
+        if (!pool)
+            break;
+
+        Matrix a = create_matrix(pool, BENCH_ROWS, BENCH_COLS);
+        Matrix b = create_matrix(pool, BENCH_ROWS, BENCH_COLS);
+        Matrix ga = create_matrix(pool, BENCH_GEMM_SIZE, BENCH_GEMM_SIZE);
+        Matrix gb = create_matrix(pool, BENCH_GEMM_SIZE, BENCH_GEMM_SIZE);
+        Matrix gc = create_matrix(pool, BENCH_GEMM_SIZE, BENCH_GEMM_SIZE);
+        if (!a.data || !b.data || !ga.data || !gb.data || !gc.data)
+        {
+            destroy_matrix(&a);
+            destroy_matrix(&b);
+            destroy_matrix(&ga);
+            destroy_matrix(&gb);
+            destroy_matrix(&gc);
+            destroy_thread_pool(&pool);
+            break;
+        }
+        parallel_fill(pool, &b, &pseudo_random, &seed);
+        parallel_fill(pool, &ga, &pseudo_random, &seed);
+        parallel_fill(pool, &gb, &pseudo_random, &seed);
+
+        double start = now_seconds();
+        parallel_fill(pool, &a, &multiplication_table, 0);
+        double fill_time = now_seconds() - start;
+
+        start = now_seconds();
+        parallel_zip(pool, &a, &a, &b, &add);
+        double zip_time = now_seconds() - start;
+
+        start = now_seconds();
+        long long total = parallel_reduce(pool, &a, &sum, 0);
+        double reduce_time = now_seconds() - start;
+
+        start = now_seconds();
+        parallel_gemm(pool, &gc, &ga, &gb);
+        double gemm_time = now_seconds() - start;
+
+        printf("%7d | %10.3f s | %.3f s | %.3f s | %.3f s (checksum %lld)\n", threads, fill_time, zip_time, reduce_time, gemm_time,
+               total + parallel_reduce(pool, &gc, &sum, 0));
+
+        destroy_matrix(&a);
+        destroy_matrix(&b);
+        destroy_matrix(&ga);
+        destroy_matrix(&gb);
+        destroy_matrix(&gc);
+        destroy_thread_pool(&pool);
+
+        if (threads == num_cores)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define M 10
+#define N 10
+#define FIT(x) (x - 1)
+#define BENCH_SIZE 4000
+#define BENCH_REPEATS 5
+
+/**
+ * A sparse matrix in "compressed sparse row" (CSR) format.
+ * Only the non-zero elements are stored, row after row:
+ * the non-zeros of row r are `values[row_start[r]] ... values[row_start[r + 1] - 1]`,
+ * and `col_index` holds the column of each of them, in ascending order.
+ *
+ * @param rows Number of rows
+ * @param cols Number of columns
+ * @param nnz Number of non-zero elements
+ * @param row_start Array of `rows + 1` offsets into `values` and `col_index`
+ * @param col_index Column of each non-zero element
+ * @param values The non-zero elements
+ */
+typedef struct csr_matrix
+{
+    int rows, cols;
+    int nnz;
+    int *row_start;
+    int *col_index;
+    int *values;
+} CsrMatrix;
+
+/**
+ * A single non-zero element, given by its coordinates.
+ */
+typedef struct triplet
+{
+    int row, col;
+    int value;
+} Triplet;
+
+/**
+ * @brief Allocates an empty CSR matrix with room for `nnz` non-zeros.
+ *
+ * @returns A new matrix, or NULL on error.
+ */
+static CsrMatrix *alloc_csr(int rows, int cols, int nnz)
+{
+    CsrMatrix *matrix = (CsrMatrix *)calloc(1, sizeof(CsrMatrix));
+    if (!matrix)
+        return 0;
+
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->nnz = nnz;
+    matrix->row_start = (int *)calloc(rows + 1, sizeof(int));
+    matrix->col_index = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    matrix->values = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    if (!(matrix->row_start) || !(matrix->col_index) || !(matrix->values))
+    {
+        free(matrix->row_start);
+        free(matrix->col_index);
+        free(matrix->values);
+        free(matrix);
+        return 0;
+    }
+    return matrix;
+}
+
+void destroy_csr(CsrMatrix **matrix)
+{
+    if (!matrix || !(*matrix))
+        return;
+
+    free((*matrix)->row_start);
+    free((*matrix)->col_index);
+    free((*matrix)->values);
+    free(*matrix);
+    (*matrix) = 0;
+}
+
+/**
+ * Builds a CSR matrix from a dense, row-major matrix.
+ *
+ * @param dense A row-major `rows`x`cols` matrix
+ *
+ * @returns A new CSR matrix, or NULL on error.
+ */
+CsrMatrix *csr_from_dense(const int *dense, int rows, int cols)
+{
+    if (!dense || rows <= 0 || cols <= 0)
+        return 0;
+
+    // First pass: count the non-zeros, so we can allocate exactly what we need
+    int nnz = 0;
+    for (long long i = 0; i < (long long)rows * cols; i++)
+        nnz += dense[i] != 0;
+
+    CsrMatrix *matrix = alloc_csr(rows, cols, nnz);
+    if (!matrix)
+        return 0;
+
+    int k = 0;
+    for (int row = 0; row < rows; row++)
+    {
+        matrix->row_start[row] = k;
+        const int *dense_row = dense + (long long)row * cols;
+        for (int col = 0; col < cols; col++)
+        {
+            if (dense_row[col])
+            {
+                matrix->col_index[k] = col;
+                matrix->values[k] = dense_row[col];
+                k++;
+            }
+        }
+    }
+    matrix->row_start[rows] = k;
+    return matrix;
+}
+
+static int cmp_col(const void *a, const void *b)
+{
+    int col_a = ((const Triplet *)a)->col;
+    int col_b = ((const Triplet *)b)->col;
+    return col_a < col_b ? -1 : col_a > col_b ? 1
+                                              : 0;
+}
+
+/**
+ * Builds a CSR matrix from a list of (row, col, value) triplets, in any order.
+ * Triplets with the same coordinates are added together, and zeros are dropped.
+ *
+ * @param triplets The triplets. NOTICE: the array is reordered.
+ * @param count Number of triplets
+ *
+ * @returns A new CSR matrix, or NULL if a triplet is out of range or on error.
+ */
+CsrMatrix *csr_from_triplets(Triplet *triplets, int count, int rows, int cols)
+{
+    if ((!triplets && count) || count < 0 || rows <= 0 || cols <= 0)
+        return 0;
+
+    // Group the triplets by row with a counting sort, then sort each row by column
+    int *row_counts = (int *)calloc(rows + 1, sizeof(int));
+    Triplet *sorted = (Triplet *)malloc((count ? count : 1) * sizeof(Triplet));
+    if (!row_counts || !sorted)
+    {
+        free(row_counts);
+        free(sorted);
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (triplets[i].row < 0 || triplets[i].row >= rows || triplets[i].col < 0 || triplets[i].col >= cols)
+        {
+            free(row_counts);
+            free(sorted);
+            return 0;
+        }
+        row_counts[triplets[i].row + 1]++;
+    }
+    for (int row = 0; row < rows; row++)
+        row_counts[row + 1] += row_counts[row];
+    for (int i = 0; i < count; i++)
+        sorted[row_counts[triplets[i].row]++] = triplets[i];
+    memcpy(triplets, sorted, count * sizeof(Triplet));
+    free(sorted);
+
+    // `row_counts[row]` is now the END of each row; the start of row r is the end of row r - 1
+    CsrMatrix *matrix = alloc_csr(rows, cols, count);
+    if (!matrix)
+    {
+        free(row_counts);
+        return 0;
+    }
+
+    int k = 0;
+    for (int row = 0, start = 0; row < rows; start = row_counts[row], row++)
+    {
+        matrix->row_start[row] = k;
+        qsort(triplets + start, row_counts[row] - start, sizeof(Triplet), &cmp_col);
+        for (int i = start; i < row_counts[row]; i++)
+        {
+            if (k > matrix->row_start[row] && matrix->col_index[k - 1] == triplets[i].col)
+                matrix->values[k - 1] += triplets[i].value;
+            else
+            {
+                matrix->col_index[k] = triplets[i].col;
+                matrix->values[k] = triplets[i].value;
+                k++;
+            }
+            if (!matrix->values[k - 1])
+                k--;
+        }
+    }
+    matrix->row_start[rows] = k;
+    matrix->nnz = k;
+    free(row_counts);
+    return matrix;
+}
+
+/**
+ * @brief Returns element (row,col) of a dense, row-major matrix (0-based).
+ */
+static inline int dense_get(const int *dense, int cols, int row, int col)
+{
+    return *(dense + (long long)row * cols + col);
+}
+
+/**
+ * Returns element (row,col) of a CSR matrix (0-based).
+ * The columns of each row are sorted, so we can binary-search them.
+ *
+ * @returns The element, or 0 if it isn't stored (or is out of range).
+ */
+int csr_get(const CsrMatrix *matrix, int row, int col)
+{
+    if (!matrix || row < 0 || row >= matrix->rows)
+        return 0;
+
+    int low = matrix->row_start[row], high = matrix->row_start[row + 1] - 1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        if (matrix->col_index[mid] < col)
+            low = mid + 1;
+        else if (matrix->col_index[mid] > col)
+            high = mid - 1;
+        else
+            return matrix->values[mid];
+    }
+    return 0;
+}
+
+/**
+ * Sparse matrix times dense vector: y = A * x.
+ *
+ * @param x Vector of `matrix->cols` elements
+ * @param y Vector of `matrix->rows` elements, which is overwritten
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int csr_mul_vector(const CsrMatrix *matrix, const long long *x, long long *y)
+{
+    if (!matrix || !x || !y)
+        return 0;
+
+    for (int row = 0; row < matrix->rows; row++)
+    {
+        long long acc = 0;
+        for (int k = matrix->row_start[row]; k < matrix->row_start[row + 1]; k++)
+            acc += (long long)matrix->values[k] * x[matrix->col_index[k]];
+        y[row] = acc;
+    }
+    return 1;
+}
+
+/**
+ * Sparse matrix times dense matrix: C = A * B.
+ *
+ * @param b A dense, row-major `matrix->cols`x`b_cols` matrix
+ * @param c A dense, row-major `matrix->rows`x`b_cols` matrix, which is overwritten
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int csr_mul_dense(const CsrMatrix *matrix, const int *b, int b_cols, long long *c)
+{
+    if (!matrix || !b || !c || b_cols <= 0)
+        return 0;
+
+    for (int row = 0; row < matrix->rows; row++)
+    {
+        long long *c_row = c + (long long)row * b_cols;
+        memset(c_row, 0, b_cols * sizeof(long long));
+        // Each non-zero A(row,k) adds a multiple of row k of B to row `row` of C
+        for (int k = matrix->row_start[row]; k < matrix->row_start[row + 1]; k++)
+        {
+            long long a_val = matrix->values[k];
+            const int *b_row = b + (long long)matrix->col_index[k] * b_cols;
+            for (int col = 0; col < b_cols; col++)
+                c_row[col] += a_val * b_row[col];
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Dense matrix times dense vector: y = A * x, for comparison with `csr_mul_vector`.
+ */
+void dense_mul_vector(const int *dense, int rows, int cols, const long long *x, long long *y)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        const int *dense_row = dense + (long long)row * cols;
+        long long acc = 0;
+        for (int col = 0; col < cols; col++)
+            acc += (long long)dense_row[col] * x[col];
+        y[row] = acc;
+    }
+}
+
+/**
+ * @brief Returns the number of bytes used by a CSR matrix's arrays.
+ */
+size_t csr_bytes(const CsrMatrix *matrix)
+{
+    if (!matrix)
+        return 0;
+    return sizeof(CsrMatrix) + (matrix->rows + 1) * sizeof(int) + 2 * (size_t)matrix->nnz * sizeof(int);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    printf("*********************************SPARSE MATRICES:*********************************\n");
+    // When almost all of a matrix's elements are 0, the `calloc(M * N, sizeof(int))` block
+    // from pointer_arithmetic_examples.c is mostly zeros, and every pass over it reads them all.
+    // The CSR format stores only the non-zero elements, along with their column, and
+    // where each row starts.
+
+    // Let's use a diagonal multiplication table: only the elements (i,i) are non-zero
+    int *arr = (int *)calloc(M * N, sizeof(int));
+    if (!arr)
+        return 0;
+    for (int i = 1; i <= M && i <= N; i++)
+        *(arr + FIT(i) * N + FIT(i)) = i * i;
+
+    CsrMatrix *sparse = csr_from_dense(arr, M, N);
+    if (!sparse)
+    {
+        free(arr);
+        return 0;
+    }
+    printf("%d non-zero elements out of %d\n", sparse->nnz, M * N);
+    printf("The (5,5) element is: %d (dense) and %d (sparse)\n", dense_get(arr, N, FIT(5), FIT(5)), csr_get(sparse, FIT(5), FIT(5)));
+    printf("The (7,4) element is: %d (dense) and %d (sparse)\n", dense_get(arr, N, FIT(7), FIT(4)), csr_get(sparse, FIT(7), FIT(4)));
+    destroy_csr(&sparse);
+    free(arr);
+
+    // The same kind of matrix can be built from (row, col, value) triplets, in any order:
+    Triplet triplets[5] = {{2, 2, 9}, {0, 0, 1}, {1, 1, 4}, {2, 2, -5}, {0, 2, 7}};
+    sparse = csr_from_triplets(triplets, 5, 3, 3);
+    if (!sparse)
+        return 0;
+
+    long long x[3] = {1, 2, 3}, y[3];
+    csr_mul_vector(sparse, x, y);
+    printf("A * (1,2,3) = (%lld,%lld,%lld)\n", y[0], y[1], y[2]);
+
+    int b[3 * 2] = {1, 0,
+                    0, 1,
+                    1, 1};
+    long long c[3 * 2];
+    csr_mul_dense(sparse, b, 2, c);
+    printf("A * B = ((%lld,%lld),(%lld,%lld),(%lld,%lld))\n", c[0], c[1], c[2], c[3], c[4], c[5]);
+    destroy_csr(&sparse);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    int *dense = (int *)malloc((size_t)BENCH_SIZE * BENCH_SIZE * sizeof(int));
+    long long *vec = (long long *)malloc(BENCH_SIZE * sizeof(long long));
+    long long *dense_out = (long long *)malloc(BENCH_SIZE * sizeof(long long));
+    long long *sparse_out = (long long *)malloc(BENCH_SIZE * sizeof(long long));
+    if (!dense || !vec || !dense_out || !sparse_out)
+    {
+        free(dense);
+        free(vec);
+        free(dense_out);
+        free(sparse_out);
+        return 0;
+    }
+    for (int i = 0; i < BENCH_SIZE; i++)
+        vec[i] = i % 13;
+
+    double densities[5] = {0.5, 0.1, 0.05, 0.01, 0.001};
+    printf("%dx%d matrix, matrix * vector:\n", BENCH_SIZE, BENCH_SIZE);
+    printf("Non-zeros | dense MB | CSR MB | dense GFLOP/s | CSR GFLOP/s | speedup\n");
+    srand(1);
+    for (int d = 0; d < 5; d++)
+    {
+        int threshold = (int)(densities[d] * RAND_MAX);
+        for (size_t i = 0; i < (size_t)BENCH_SIZE * BENCH_SIZE; i++)
+            dense[i] = rand() < threshold ? (rand() % 100) + 1 : 0;
+
+        sparse = csr_from_dense(dense, BENCH_SIZE, BENCH_SIZE);
+        if (!sparse)
+            break;
+
+        double start = now_seconds();
+        for (int r = 0; r < BENCH_REPEATS; r++)
+            dense_mul_vector(dense, BENCH_SIZE, BENCH_SIZE, vec, dense_out);
+        double dense_time = (now_seconds() - start) / BENCH_REPEATS;
+
+        start = now_seconds();
+        for (int r = 0; r < BENCH_REPEATS; r++)
+            csr_mul_vector(sparse, vec, sparse_out);
+        double sparse_time = (now_seconds() - start) / BENCH_REPEATS;
+
+        // Both versions do the same useful work: 2 operations per non-zero
+        double flops = 2.0 * sparse->nnz;
+        printf("%8.1f%% | %8.1f | %6.1f | %13.3f | %11.3f | %6.1fx%s\n", densities[d] * 100,
+               (double)BENCH_SIZE * BENCH_SIZE * sizeof(int) / 1e6, csr_bytes(sparse) / 1e6,
+               flops / dense_time / 1e9, flops / sparse_time / 1e9, dense_time / sparse_time,
+               memcmp(dense_out, sparse_out, BENCH_SIZE * sizeof(long long)) ? " (MISMATCH)" : "");
+        destroy_csr(&sparse);
+    }
+
+    free(dense);
+    free(vec);
+    free(dense_out);
+    free(sparse_out);
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+
+#define M 10
+#define N 10
+#define FIT(x) (x - 1)
+#define BLOCK_SIZE 16
+#define BENCH_SIZE 4096
+#define BENCH_REPEATS 3
+
+/**
+ * A "view" of a 2D matrix stored somewhere in memory.
+ * The view does not own its data; it only describes how to find element (row,col):
+ *
+ *     base + row * row_stride + col * col_stride
+ *
+ * This generalizes the `arr + FIT(row) * M + FIT(col)` arithmetic from
+ * pointer_arithmetic_examples.c: a row-major matrix has col_stride 1, a
+ * column-major one has row_stride 1, and a transposed view just swaps the strides.
+ *
+ * @param base Address of element (0,0) of the view
+ * @param rows Number of rows
+ * @param cols Number of columns
+ * @param row_stride Distance (in elements) between two consecutive rows
+ * @param col_stride Distance (in elements) between two consecutive columns
+ */
+typedef struct matrix_view
+{
+    int *base;
+    int rows, cols;
+    ptrdiff_t row_stride, col_stride;
+} MatrixView;
+
+/**
+ * @brief Creates a view of a row-major `rows`x`cols` matrix.
+ */
+MatrixView row_major_view(int *data, int rows, int cols)
+{
+    MatrixView view = {data, rows, cols, cols, 1};
+    return view;
+}
+
+/**
+ * @brief Creates a view of a column-major `rows`x`cols` matrix.
+ */
+MatrixView col_major_view(int *data, int rows, int cols)
+{
+    MatrixView view = {data, rows, cols, 1, rows};
+    return view;
+}
+
+/**
+ * @brief Returns the address of element (row,col) of a view (0-based).
+ */
+static inline int *view_at(MatrixView view, int row, int col)
+{
+    return view.base + row * view.row_stride + col * view.col_stride;
+}
+
+/**
+ * Creates a view of a rectangular part of another view, without copying.
+ *
+ * @param view The original view
+ * @param row First row of the slice
+ * @param col First column of the slice
+ * @param rows Number of rows in the slice
+ * @param cols Number of columns in the slice
+ *
+ * @returns The slice, or an empty view (with NULL `base`) if it doesn't fit in `view`.
+ */
+MatrixView view_slice(MatrixView view, int row, int col, int rows, int cols)
+{
+    MatrixView slice = {0, 0, 0, 0, 0};
+    if (row < 0 || col < 0 || rows < 0 || cols < 0 || row + rows > view.rows || col + cols > view.cols)
+        return slice;
+
+    slice = view;
+    slice.base = view_at(view, row, col);
+    slice.rows = rows;
+    slice.cols = cols;
+    return slice;
+}
+
+/**
+ * @brief Creates a transposed view of another view, without copying:
+ *        element (row,col) of the result is element (col,row) of `view`.
+ */
+MatrixView view_transpose(MatrixView view)
+{
+    MatrixView transposed = {view.base, view.cols, view.rows, view.col_stride, view.row_stride};
+    return transposed;
+}
+
+/**
+ * Copies the elements of one view into another, of the same dimensions.
+ * The copy is "cache-oblivious": the larger dimension is split in half recursively,
+ * until the pieces are small enough that both the source and the destination piece
+ * fit in the cache together - whatever the cache's size is, and whatever the strides are.
+ * Copying from a transposed view this way gives a fast transpose.
+ *
+ * @param dst Destination view
+ * @param src Source view
+ *
+ * @returns 1 on success, 0 if the dimensions don't match or on error.
+ */
+int view_copy(MatrixView dst, MatrixView src)
+{
+    if (!dst.base || !src.base || dst.rows != src.rows || dst.cols != src.cols)
+        return 0;
+
+    if (src.rows <= BLOCK_SIZE && src.cols <= BLOCK_SIZE)
+    {
+        for (int row = 0; row < src.rows; row++)
+        {
+            for (int col = 0; col < src.cols; col++)
+                *view_at(dst, row, col) = *view_at(src, row, col);
+        }
+        return 1;
+    }
+
+    if (src.rows >= src.cols)
+    {
+        int half = src.rows / 2;
+        return view_copy(view_slice(dst, 0, 0, half, dst.cols), view_slice(src, 0, 0, half, src.cols)) &&
+               view_copy(view_slice(dst, half, 0, dst.rows - half, dst.cols), view_slice(src, half, 0, src.rows - half, src.cols));
+    }
+    int half = src.cols / 2;
+    return view_copy(view_slice(dst, 0, 0, dst.rows, half), view_slice(src, 0, 0, src.rows, half)) &&
+           view_copy(view_slice(dst, 0, half, dst.rows, dst.cols - half), view_slice(src, 0, half, src.rows, src.cols - half));
+}
+
+/**
+ * @brief Writes the transpose of a row-major `rows`x`cols` matrix into `dst`
+ *        (a row-major `cols`x`rows` matrix), using the cache-oblivious copy.
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int transpose(int *dst, int *src, int rows, int cols)
+{
+    return view_copy(row_major_view(dst, cols, rows), view_transpose(row_major_view(src, rows, cols)));
+}
+
+/**
+ * @brief The straightforward transpose: reads `src` row by row, and
+ *        writes `dst` column by column.
+ */
+void naive_transpose(int *dst, int *src, int rows, int cols)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+            *(dst + col * rows + row) = *(src + row * cols + col);
+    }
+}
+
+void print_view(MatrixView view)
+{
+    for (int row = 0; row < view.rows; row++)
+    {
+        for (int col = 0; col < view.cols; col++)
+            printf("%4d", *view_at(view, row, col));
+        printf("\n");
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    printf("*********************************STRIDED MATRIX VIEWS:*********************************\n");
+    // In pointer_arithmetic_examples.c we found element (row,col) of an MxN
+    // matrix with `arr + FIT(row) * N + FIT(col)`. That hard-codes one memory layout.
+    // If we keep the distance between rows and between columns as VARIABLES,
+    // the same arithmetic can describe column-major matrices, sub-matrices and
+    // transposed matrices - without ever copying the data.
+
+    int *arr = (int *)calloc(M * N, sizeof(int));
+    if (!arr)
+        return 0;
+
+    MatrixView table = row_major_view(arr, M, N);
+    for (int row = 1; row <= M; row++)
+    {
+        for (int col = 1; col <= N; col++)
+            *view_at(table, FIT(row), FIT(col)) = row * col;
+    }
+    printf("The (7,4) element in arr is: %d\n", *view_at(table, FIT(7), FIT(4)));
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~SLICES:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // A slice starts at a different element, but keeps the strides of the original:
+    MatrixView slice = view_slice(table, FIT(3), FIT(5), 3, 4);
+    printf("Rows 3-5, columns 5-8:\n");
+    print_view(slice);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~TRANSPOSED:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // Transposing a view only swaps its dimensions and strides:
+    MatrixView transposed = view_transpose(slice);
+    printf("The same slice, transposed:\n");
+    print_view(transposed);
+
+    // The same memory, read as a COLUMN-major 5x20 matrix:
+    MatrixView columns = col_major_view(arr, 5, 20);
+    printf("Element (2,3) of arr, read as a column-major 5x20 matrix: %d\n", *view_at(columns, 2, 3));
+
+    free(arr);
+    arr = 0;
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // The naive transpose writes `dst` one column at a time, so for large matrices every
+    // write lands on a different cache line (and often on a different page).
+    int *src = (int *)malloc((size_t)BENCH_SIZE * BENCH_SIZE * sizeof(int));
+    int *dst = (int *)malloc((size_t)BENCH_SIZE * BENCH_SIZE * sizeof(int));
+    if (!src || !dst)
+    {
+        free(src);
+        free(dst);
+        return 0;
+    }
+    for (size_t i = 0; i < (size_t)BENCH_SIZE * BENCH_SIZE; i++)
+        src[i] = (int)i;
+
+    double naive_time = 0, recursive_time = 0;
+    for (int i = 0; i < BENCH_REPEATS; i++)
+    {
+        double start = now_seconds();
+        naive_transpose(dst, src, BENCH_SIZE, BENCH_SIZE);
+        naive_time += now_seconds() - start;
+
+        start = now_seconds();
+        transpose(dst, src, BENCH_SIZE, BENCH_SIZE);
+        recursive_time += now_seconds() - start;
+    }
+
+    int ok = *(dst + 5 * BENCH_SIZE + 7) == *(src + 7 * BENCH_SIZE + 5);
+    printf("Transposing a %dx%d matrix (%s):\n", BENCH_SIZE, BENCH_SIZE, ok ? "verified" : "WRONG RESULT");
+    printf("  Naive:            %.3f s\n", naive_time / BENCH_REPEATS);
+    printf("  Cache-oblivious:  %.3f s\n", recursive_time / BENCH_REPEATS);
+
+    free(src);
+    free(dst);
+
+    return 0;
+}
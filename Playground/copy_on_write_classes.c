@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_POINTS 100000
+#define BENCH_COPIES 20
+#define BENCH_WRITE_PERCENT 5
+
+/*
+ * This builds on simulating_classes.c: points are still created, copied and
+ * deleted through a "class" of function pointers, but copies SHARE their data
+ * until one of them is changed ("copy-on-write").
+ */
+
+/**
+ * The data of a point, which may be shared by several copies.
+ *
+ * @param x,y The coordinates
+ * @param refs The number of `point`s sharing this data; changed atomically,
+ *             so copies may be made and deleted from several threads
+ */
+typedef struct point_instance
+{
+    float x,y;
+    int refs;
+} point_instance;
+
+// A point is a pointer to (possibly shared) data. Reading through it is always fine,
+// but writing must go through `Point.set`, which makes a private copy first if needed.
+typedef const point_instance* point;
+
+typedef struct point_class
+{
+    point (*constructor)(float, float);
+    point (*cpy_constructor)(point);
+    void (*destructor)(void**);
+    void (*set)(point*, float, float);
+
+    const char* (*to_string)(point);
+} point_class;
+
+// Counters for the benchmark below
+static long points_allocated = 0;
+static long bytes_in_use = 0;
+
+static point_instance* allocate_point(float x, float y)
+{
+    point_instance* instance = (point_instance*)malloc(sizeof(point_instance));
+    if(instance)
+    {
+        instance->x = x;
+        instance->y = y;
+        instance->refs = 1;
+        __atomic_fetch_add(&points_allocated, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bytes_in_use, sizeof(point_instance), __ATOMIC_RELAXED);
+    }
+    return instance;
+}
+
+point pb_constructor(float x, float y)
+{
+    return allocate_point(x, y);
+}
+
+/**
+ * @brief "Copies" a point: the copy shares the data of `rhs`, and only
+ *        its reference count is incremented.
+ */
+point pb_cpy_constructor(point rhs)
+{
+    if(!rhs) return 0;
+
+    __atomic_fetch_add(&(((point_instance*)rhs)->refs), 1, __ATOMIC_RELAXED);
+    return rhs;
+}
+
+/**
+ * @brief Releases a point's reference to its data, and frees the data
+ *        if that was the last reference.
+ */
+void pb_destructor(void** instance)
+{
+    if(!instance || !*instance) return;
+
+    point_instance* data = (point_instance*)(*instance);
+    //Only the thread that drops the LAST reference frees the data
+    if(__atomic_sub_fetch(&(data->refs), 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        free(data);
+        __atomic_fetch_sub(&bytes_in_use, sizeof(point_instance), __ATOMIC_RELAXED);
+    }
+    *instance = 0;
+}
+
+/**
+ * Changes the coordinates of a point.
+ * If the point's data is shared with other copies, the point first gets a private
+ * copy of its own, so that the other copies don't change.
+ *
+ * @param p Pointer to the point (since the point itself may be changed to its new, private data)
+ */
+void pb_set(point* p, float x, float y)
+{
+    if(!p || !*p) return;
+
+    point_instance* data = (point_instance*)(*p);
+    if(__atomic_load_n(&(data->refs), __ATOMIC_ACQUIRE) > 1)
+    {
+        point_instance* copy = allocate_point(x, y);
+        if(!copy) return;
+        pb_destructor((void**)p); //Releases our reference to the shared data
+        *p = copy;
+        return;
+    }
+    data->x = x;
+    data->y = y;
+}
+
+/**
+ * @brief Returns the string representation of a point. The string is valid
+ *        until the next call to `to_string` from the same thread.
+ */
+const char* pb_to_string(point p)
+{
+    static __thread char str_rep[64];
+    if(!p) return "";
+
+    snprintf(str_rep, sizeof(str_rep), "(%.2f,%.2f)", p->x, p->y);
+    return str_rep;
+}
+
+void delete(void** instance, void(*destructor)(void** type_instance))
+{
+    destructor(instance);
+}
+
+static point_class Point = {&pb_constructor, &pb_cpy_constructor, &pb_destructor, &pb_set, &pb_to_string};
+
+point new_Point(float x, float y)
+{
+    return Point.constructor(x,y);
+}
+
+point cpy_Point(const point rhs)
+{
+    return Point.cpy_constructor(rhs);
+}
+
+/**
+ * @brief The copy constructor from simulating_classes.c, which always allocates a new point.
+ */
+point deep_cpy_Point(const point rhs)
+{
+    if(!rhs) return 0;
+    return allocate_point(rhs->x, rhs->y);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Makes BENCH_COPIES copies of BENCH_POINTS points, changes BENCH_WRITE_PERCENT
+ *        percent of the copies, and deletes everything.
+ */
+void bench_copies(const char* name, point (*copy)(const point))
+{
+    point* originals = (point*)malloc(BENCH_POINTS * sizeof(point));
+    point* copies = (point*)malloc((size_t)BENCH_POINTS * BENCH_COPIES * sizeof(point));
+    if(!originals || !copies)
+    {
+        free(originals);
+        free(copies);
+        return;
+    }
+
+    points_allocated = 0;
+    bytes_in_use = 0;
+    double start = now_seconds();
+
+    for(int i = 0; i < BENCH_POINTS; i++) originals[i] = new_Point(i, -i);
+    for(int i = 0; i < BENCH_POINTS * BENCH_COPIES; i++) copies[i] = copy(originals[i % BENCH_POINTS]);
+    for(int i = 0; i < BENCH_POINTS * BENCH_COPIES; i += 100 / BENCH_WRITE_PERCENT) Point.set(&copies[i], 27, 12);
+
+    long peak_bytes = bytes_in_use;
+    long allocations = points_allocated;
+
+    for(int i = 0; i < BENCH_POINTS * BENCH_COPIES; i++) delete((void**)&copies[i], Point.destructor);
+    for(int i = 0; i < BENCH_POINTS; i++) delete((void**)&originals[i], Point.destructor);
+    double elapsed = now_seconds() - start;
+
+    printf("  %-16s | %.3f s | %8ld points allocated | %6.2f MB of point data at peak | %ld bytes leaked\n",
+           name, elapsed, allocations, peak_bytes / 1e6, bytes_in_use);
+
+    free(originals);
+    free(copies);
+}
+
+int main(void)
+{
+    point p1 = new_Point(1,1);
+    printf("%s\n", Point.to_string(p1));
+    point p2 = cpy_Point(p1);
+    printf("%s (shares its data with p1: %s)\n", Point.to_string(p2), p1 == p2 ? "yes" : "no");
+
+    //Instead of `p2->x = 27; p2->y = 12;` we ask the class to make the change,
+    //which gives `p2` its own copy of the data first:
+    Point.set(&p2, 27, 12);
+
+    printf("%s (shares its data with p1: %s)\n", Point.to_string(p2), p1 == p2 ? "yes" : "no");
+    printf("p1 is still %s\n", Point.to_string(p1));
+
+    //p1 is no longer shared, so changing it doesn't copy anything:
+    point old_p1 = p1;
+    Point.set(&p1, -465876, 3.14159265358979);
+    printf("%s (changed in place: %s)\n", Point.to_string(p1), p1 == old_p1 ? "yes" : "no");
+
+    delete((void**)&p1, Point.destructor);
+    delete((void**)&p2, Point.destructor);
+
+    printf("%p\n", (void*)p1);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("%d points, %d copies of each, %d%% of the copies changed:\n", BENCH_POINTS, BENCH_COPIES, BENCH_WRITE_PERCENT);
+    bench_copies("Deep copies", &deep_cpy_Point);
+    bench_copies("Copy-on-write", &cpy_Point);
+
+    return 0;
+}
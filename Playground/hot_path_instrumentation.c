@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Build with probes (the default):     gcc -O2 -pthread hot_path_instrumentation.c
+ * Build without probes:                gcc -O2 -pthread -DPROBES_ENABLED=0 hot_path_instrumentation.c
+ *
+ * With PROBES_ENABLED=0 every probe macro expands to nothing, so the instrumented functions
+ * compile to exactly the same code as if they had never been instrumented. To see it, compare
+ * the assembly of e.g. `push` with `gcc -O2 -S -DPROBES_ENABLED=0` against a copy of this file
+ * with the PROBE_* lines removed.
+ */
+#ifndef PROBES_ENABLED
+#define PROBES_ENABLED 1
+#endif
+
+#define MAX_PROBES 64
+#define NUM_BUCKETS 40        // Bucket i counts samples of [2^i, 2^(i+1)) ticks
+#define PROBE_FLUSH_EVERY 4096 // A thread publishes its samples after this many of them
+#define MAX_STACK_SIZE 10
+#define MAX_STR_LEN 500
+#define MAX_BUFF_SIZE 1000
+#define BENCH_OPS 2000000
+
+/**
+ * A named measuring point in the code, with the statistics of everything it measured.
+ * The statistics are only updated when threads publish their samples, using atomic
+ * additions, so no lock is ever taken.
+ *
+ * @param name Name of the probe, as shown in the report
+ * @param id Index of the probe in the registry, plus 1 (0 until the probe is first used)
+ * @param count Number of samples
+ * @param total_ticks Sum of all samples
+ * @param max_ticks Largest sample
+ * @param buckets Histogram of the samples, by powers of 2
+ */
+typedef struct probe
+{
+    const char *name;
+    int id;
+    unsigned long long count;
+    unsigned long long total_ticks;
+    unsigned long long max_ticks;
+    unsigned long long buckets[NUM_BUCKETS];
+} Probe;
+
+/**
+ * A thread's own, unpublished samples for a single probe.
+ */
+typedef struct local_stats
+{
+    unsigned long long count;
+    unsigned long long total_ticks;
+    unsigned long long max_ticks;
+    unsigned long long buckets[NUM_BUCKETS];
+} LocalStats;
+
+/**
+ * A running timer, started by `probe_begin` and stopped by `probe_end`.
+ */
+typedef struct probe_timer
+{
+    Probe *probe;
+    unsigned long long start;
+} ProbeTimer;
+
+static Probe *registry[MAX_PROBES];
+static int num_probes = 0;
+static __thread LocalStats local_stats[MAX_PROBES];
+static pthread_key_t flush_key;
+static pthread_once_t flush_key_once = PTHREAD_ONCE_INIT;
+static __thread bool flush_registered = false;
+
+/**
+ * @brief Reads a fast, monotonic tick counter: the CPU's time stamp counter where
+ *        available, or `clock_gettime` nanoseconds otherwise.
+ */
+static inline unsigned long long read_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Publishes the calling thread's samples into the probes' statistics.
+ */
+void probe_flush_thread(void)
+{
+    int count = __atomic_load_n(&num_probes, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++)
+    {
+        LocalStats *local = &local_stats[i];
+        Probe *probe = __atomic_load_n(&registry[i], __ATOMIC_ACQUIRE);
+        if (!local->count || !probe)
+            continue;
+
+        __atomic_fetch_add(&(probe->count), local->count, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&(probe->total_ticks), local->total_ticks, __ATOMIC_RELAXED);
+        for (int b = 0; b < NUM_BUCKETS; b++)
+        {
+            if (local->buckets[b])
+                __atomic_fetch_add(&(probe->buckets[b]), local->buckets[b], __ATOMIC_RELAXED);
+        }
+        unsigned long long max = __atomic_load_n(&(probe->max_ticks), __ATOMIC_RELAXED);
+        while (local->max_ticks > max &&
+               !__atomic_compare_exchange_n(&(probe->max_ticks), &max, local->max_ticks, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+        memset(local, 0, sizeof(LocalStats));
+    }
+}
+
+static void flush_at_exit(void *arg)
+{
+    (void)arg;
+    probe_flush_thread();
+}
+
+static void create_flush_key(void)
+{
+    pthread_key_create(&flush_key, &flush_at_exit);
+}
+
+/**
+ * @brief Gives a probe its place in the registry the first time it's used.
+ *
+ * @returns The probe's index in the registry, or -1 if the registry is full.
+ */
+static int register_probe(Probe *probe)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    // Registration happens once per probe, so a lock is fine here
+    pthread_mutex_lock(&lock);
+    if (!probe->id && num_probes < MAX_PROBES)
+    {
+        registry[num_probes] = probe;
+        __atomic_store_n(&(probe->id), num_probes + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&num_probes, num_probes + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return probe->id - 1;
+}
+
+/**
+ * @brief Makes sure the calling thread's samples are published when it exits.
+ *        Every thread that records samples has to do this once for itself.
+ */
+static void register_thread_flush(void)
+{
+    pthread_once(&flush_key_once, &create_flush_key);
+    pthread_setspecific(flush_key, (void *)1);
+    flush_registered = true;
+}
+
+static inline ProbeTimer probe_begin(Probe *probe)
+{
+    ProbeTimer timer = {probe, read_ticks()};
+    return timer;
+}
+
+/**
+ * @brief Stops a timer, and records its duration in the calling thread's own statistics.
+ *        Called automatically when a PROBE_SCOPE goes out of scope.
+ */
+static inline void probe_end(ProbeTimer *timer)
+{
+    unsigned long long ticks = read_ticks() - timer->start;
+    int id = __atomic_load_n(&(timer->probe->id), __ATOMIC_ACQUIRE) - 1;
+    if (id < 0 && (id = register_probe(timer->probe)) < 0)
+        return;
+    if (!flush_registered)
+        register_thread_flush();
+
+    LocalStats *local = &local_stats[id];
+    local->count++;
+    local->total_ticks += ticks;
+    if (ticks > local->max_ticks)
+        local->max_ticks = ticks;
+
+    int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+    local->buckets[bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1]++;
+
+    if (local->count >= PROBE_FLUSH_EVERY)
+        probe_flush_thread();
+}
+
+/**
+ * @brief Measures ticks per nanosecond, so that reports can be given in nanoseconds.
+ */
+static double ticks_per_ns(void)
+{
+    static double ratio = 0;
+    if (ratio)
+        return ratio;
+
+    struct timespec start_ts, end_ts, pause = {0, 20000000};
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    unsigned long long start = read_ticks();
+    nanosleep(&pause, 0);
+    unsigned long long end = read_ticks();
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+    double ns = (end_ts.tv_sec - start_ts.tv_sec) * 1e9 + (end_ts.tv_nsec - start_ts.tv_nsec);
+    ratio = (end - start) / ns;
+    return ratio;
+}
+
+/**
+ * @brief Returns the smallest value (in ticks) below which `fraction` of a probe's samples fall,
+ *        as precise as the histogram allows (i.e. up to a factor of 2).
+ */
+static unsigned long long percentile(const Probe *probe, double fraction)
+{
+    unsigned long long target = (unsigned long long)(probe->count * fraction), seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++)
+    {
+        seen += probe->buckets[b];
+        if (seen > target)
+            return (2ull << b) < probe->max_ticks ? (2ull << b) : probe->max_ticks;
+    }
+    return probe->max_ticks;
+}
+
+/**
+ * Writes a report of every probe that was used.
+ * Samples that other threads haven't published yet (less than PROBE_FLUSH_EVERY
+ * per probe per thread) are not included.
+ *
+ * @param out Where to write the report
+ * @param json If `true` the report is written as JSON, otherwise as a text table
+ */
+void probe_report(FILE *out, bool json)
+{
+    if (!out)
+        return;
+
+    probe_flush_thread();
+    double ratio = ticks_per_ns();
+    int count = __atomic_load_n(&num_probes, __ATOMIC_ACQUIRE);
+
+    if (json)
+        fprintf(out, "{\"probes\": [");
+    else
+        fprintf(out, "%-16s %10s %10s %10s %10s %12s\n", "probe", "calls", "avg ns", "p50 ns<", "p99 ns<", "max ns");
+
+    for (int i = 0; i < count; i++)
+    {
+        Probe *probe = registry[i];
+        double avg = probe->count ? probe->total_ticks / ratio / probe->count : 0;
+        double p50 = percentile(probe, 0.5) / ratio, p99 = percentile(probe, 0.99) / ratio;
+        double max = probe->max_ticks / ratio;
+
+        if (json)
+        {
+            fprintf(out, "%s\n  {\"name\": \"%s\", \"calls\": %llu, \"avg_ns\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f, \"histogram\": [",
+                    i ? "," : "", probe->name, probe->count, avg, p50, p99, max);
+            for (int b = 0; b < NUM_BUCKETS; b++)
+                fprintf(out, "%s%llu", b ? ", " : "", probe->buckets[b]);
+            fprintf(out, "]}");
+        }
+        else
+            fprintf(out, "%-16s %10llu %10.1f %10.1f %10.1f %12.1f\n", probe->name, probe->count, avg, p50, p99, max);
+    }
+    if (json)
+        fprintf(out, "\n]}\n");
+}
+
+#define PROBE_CAT_(a, b) a##b
+#define PROBE_CAT(a, b) PROBE_CAT_(a, b)
+
+#if PROBES_ENABLED
+/**
+ * Times everything from this line to the end of the enclosing block.
+ * `name` must be a string literal.
+ */
+#define PROBE_SCOPE(name)                                                  \
+    static Probe PROBE_CAT(probe_, __LINE__) = {name, 0, 0, 0, 0, {0}};    \
+    __attribute__((cleanup(probe_end))) ProbeTimer PROBE_CAT(timer_, __LINE__) = probe_begin(&PROBE_CAT(probe_, __LINE__))
+#else
+#define PROBE_SCOPE(name)
+#endif
+
+typedef struct stack
+{
+    int *stack_arr;
+    int size;
+    int *top;
+} Stack;
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+typedef enum type
+{
+    INT,
+    FLOAT,
+    STRING
+} Type;
+
+Stack *create_stack(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    Stack *stack = (Stack *)calloc(1, sizeof(Stack));
+    if (!stack)
+        return 0;
+
+    // One extra slot, since `push` moves `top` BEFORE writing the value
+    stack->stack_arr = (int *)calloc(size + 1, sizeof(int));
+    if (!(stack->stack_arr))
+    {
+        free(stack);
+        return 0;
+    }
+    stack->size = size;
+    stack->top = stack->stack_arr;
+
+    return stack;
+}
+
+int is_empty(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr) || (stack->top == stack->stack_arr))
+        return 1;
+    return 0;
+}
+
+int is_full(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr))
+        return 0;
+    return (stack->top - stack->stack_arr) == stack->size;
+}
+
+int push(Stack *stack, int value)
+{
+    PROBE_SCOPE("push");
+    if (!stack || !(stack->stack_arr) || is_full(stack))
+        return 0;
+
+    stack->top++;
+    *(stack->top) = value;
+    return 1;
+}
+
+int pop(Stack *stack)
+{
+    PROBE_SCOPE("pop");
+    if (!stack || !(stack->top) || is_empty(stack))
+        return INT_MAX;
+
+    int top = *(stack->top);
+    stack->top--;
+    return top;
+}
+
+void destroy_stack(Stack *stack)
+{
+    if (!stack)
+        return;
+
+    free(stack->stack_arr);
+    free(stack);
+}
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+void insert_node(Node **list, Node *new_node)
+{
+    PROBE_SCOPE("insert_node");
+    if (!new_node || !list)
+        return;
+
+    new_node->next = (*list);
+    (*list) = new_node;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+char *strdup_pointer(char *src)
+{
+    if (!src)
+        return 0;
+
+    size_t length = strlen(src);
+    char *copy = (char *)malloc(length + 1);
+    if (!copy)
+        return 0;
+
+    memcpy(copy, src, length + 1);
+    return copy;
+}
+
+char *nth_string(char *buffer, int n)
+{
+    PROBE_SCOPE("nth_string");
+    if (!buffer || n <= 0)
+        return 0;
+
+    char *first_loc = buffer;
+    int str_len = 0;
+    bool started_next = false;
+
+    while ((buffer - first_loc) < MAX_BUFF_SIZE)
+    {
+        if (str_len >= MAX_STR_LEN)
+            return 0;
+        if (started_next)
+        {
+            str_len = 0;
+            started_next = false;
+        }
+        if (*buffer == '\0')
+        {
+            n--;
+            started_next = true;
+        }
+        if (n == 0)
+            return strdup_pointer(buffer - str_len);
+
+        buffer++;
+        str_len++;
+    }
+
+    return 0;
+}
+
+int cmp_int(const char *str_a, const char *str_b)
+{
+    int a = atoi(str_a);
+    int b = atoi(str_b);
+
+    return a < b ? -1 : a > b ? 1
+                              : 0;
+}
+
+int cmp_float(const char *str_a, const char *str_b)
+{
+    float a = atof(str_a);
+    float b = atof(str_b);
+
+    return a < b ? -1 : a > b ? 1
+                              : 0;
+}
+
+int var_cmp(Type type, const char *a, const char *b, int (*cmp_funcs[])(const char *, const char *))
+{
+    PROBE_SCOPE("var_cmp");
+    return cmp_funcs[type](a, b);
+}
+
+/**
+ * The `run_menu` from function_pointer_arrays.c, with the call to the chosen function timed.
+ */
+void run_menu(const char *title, const char **choice_text, void((*(functions[]))()), int num_choices, bool persistent)
+{
+    if (!choice_text || !functions || (num_choices <= 0))
+        return;
+
+    int choice = 0;
+    bool invalid_input = false;
+
+    do
+    {
+        if (!title || !strcmp("", title))
+            printf("Select an option:\n");
+        else
+            printf("%s\n", title);
+
+        for (int i = 0; i < num_choices; i++)
+        {
+            printf("%d. %s\n", (i + 1), choice_text[i]);
+        }
+        if (persistent)
+            printf("%d. Quit\n", (num_choices + 1));
+
+        printf("Enter your choice: ");
+        if (scanf("%d", &choice) != 1)
+            return;
+
+        if ((!persistent && !(choice >= 1 && choice <= num_choices)) ||
+            (persistent && !(choice >= 1 && choice <= (num_choices + 1))))
+        {
+            invalid_input = true;
+        }
+        else
+            invalid_input = false;
+
+        if (invalid_input)
+            printf("\nPlease select a valid choice\n\n");
+        else
+        {
+            if (choice == num_choices + 1)
+                return;
+
+            PROBE_SCOPE("run_menu call");
+            void (*chosen_func)() = functions[(choice - 1)];
+            chosen_func();
+        }
+    } while (invalid_input || persistent);
+}
+
+void choice1()
+{
+    printf("This is choice 1\n");
+}
+
+void choice2()
+{
+    printf("This is choice 2\n");
+}
+
+static void *worker(void *arg)
+{
+    Stack *stack = (Stack *)arg;
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        push(stack, i);
+        pop(stack);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    printf("*********************************HOT PATH INSTRUMENTATION:*********************************\n");
+    // A probe measures how long a piece of code takes, every time it runs.
+    // `PROBE_SCOPE("name")` starts a timer that stops automatically at the end of the
+    // enclosing block (using the compiler's `cleanup` attribute). Each thread keeps its
+    // own statistics and only occasionally publishes them, so the probes stay cheap even
+    // when many threads hit them.
+    printf("Probes are %s in this build\n", PROBES_ENABLED ? "ENABLED" : "DISABLED");
+
+    Stack *stack = create_stack(MAX_STACK_SIZE);
+    Stack *worker_stack = create_stack(MAX_STACK_SIZE);
+    if (!stack || !worker_stack)
+        return 0;
+
+    pthread_t thread;
+    pthread_create(&thread, 0, &worker, worker_stack);
+
+    Node *list = 0;
+    char buffer[MAX_BUFF_SIZE] = {};
+    strcpy(buffer, "This is a sentence.");
+    strcpy(buffer + 20, "This is another sentence.");
+    int (*cmp_funcs[3])(const char *, const char *) = {&cmp_int, &cmp_float, &strcmp};
+    long checksum = 0;
+
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        push(stack, i);
+        checksum += pop(stack);
+        checksum += var_cmp((Type)(i % 3), "12", "7", cmp_funcs);
+        if (i % 100 == 0)
+        {
+            insert_node(&list, create_node(i));
+            char *second = nth_string(buffer, 2);
+            checksum += second ? second[0] : 0;
+            free(second);
+        }
+    }
+    pthread_join(thread, 0);
+
+    // `run_menu` reads its choices from `stdin`; here we feed it from a pipe
+    int input[2];
+    if (!pipe(input))
+    {
+        const char *choices = "1\n2\n1\n3\n";
+        if (write(input[1], choices, strlen(choices)) == (ssize_t)strlen(choices))
+        {
+            close(input[1]);
+            dup2(input[0], STDIN_FILENO);
+            close(input[0]);
+            const char *option_text[2] = {"Choice 1", "Choice 2"};
+            void (*menu_funcs[])() = {&choice1, &choice2};
+            run_menu("", option_text, menu_funcs, 2, true);
+        }
+    }
+
+    printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~REPORT:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("(checksum %ld)\n", checksum);
+    probe_report(stdout, false);
+    probe_report(stdout, true);
+
+    destroy_list(&list);
+    destroy_stack(stack);
+    destroy_stack(worker_stack);
+
+    return 0;
+}
@@ -0,0 +1,557 @@
+#define _GNU_SOURCE // For `syscall`
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_STACK_OPS 10000000
+#define BENCH_LIST_NODES 2000000
+#define BENCH_STRING_LENGTH (16 * 1024 * 1024)
+#define BENCH_MATRIX_SIZE 4096
+
+/*
+ * Hardware performance counters count events in the CPU itself - cycles, instructions,
+ * cache and TLB misses - so they tell WHY a piece of code is slow, not just that it is.
+ * Linux gives access to them with `perf_event_open`. They may be missing (in most virtual
+ * machines) or forbidden (see /proc/sys/kernel/perf_event_paranoid); in that case every
+ * counter that can't be opened is reported as "-", and the timings still work.
+ */
+
+typedef enum counter_kind
+{
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    DTLB_MISSES,
+    PAGE_FAULTS, // A software counter, kept by the kernel, so it's nearly always there
+    NUM_COUNTERS
+} CounterKind;
+
+static const char *counter_names[NUM_COUNTERS] = {"cycles", "instr", "L1D miss", "LLC miss", "br miss",
+                                                  "dTLB miss", "faults"};
+
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} counter_events[NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}};
+
+/**
+ * A set of counters for the thread that opened them.
+ * The counters are opened one by one (not as a group), so that the ones the CPU doesn't
+ * have don't prevent the others from working. If there are more than the CPU can count at
+ * once, the kernel takes turns between them, and we scale each count by the fraction of
+ * time it was really counted.
+ *
+ * @param fds File descriptor of each counter, or -1 if it couldn't be opened
+ * @param values Counts from the last measured region
+ * @param counted Whether each counter counted anything in the last measured region
+ * @param elapsed Wall-clock duration of the last measured region, in seconds
+ * @param start Time the current region started
+ * @param open_error `errno` of the first counter that couldn't be opened (0 if none)
+ */
+typedef struct perf_counters
+{
+    int fds[NUM_COUNTERS];
+    uint64_t values[NUM_COUNTERS];
+    bool counted[NUM_COUNTERS];
+    double elapsed;
+    double start;
+    int open_error;
+} PerfCounters;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+/**
+ * Opens the counters for the CALLING thread (they count nothing in other threads, so each
+ * thread that measures something needs its own). They count user-space events only.
+ *
+ * @returns The counters (some or all of which may be unavailable), or NULL on error.
+ */
+PerfCounters *open_counters(void)
+{
+    PerfCounters *counters = (PerfCounters *)calloc(1, sizeof(PerfCounters));
+    if (!counters)
+        return 0;
+
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[i].type;
+        attr.config = counter_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters->fds[i] = perf_event_open(&attr, 0, -1, -1, 0);
+        if (counters->fds[i] < 0 && !counters->open_error)
+            counters->open_error = errno;
+    }
+    return counters;
+}
+
+void close_counters(PerfCounters **counters)
+{
+    if (!counters || !(*counters))
+        return;
+
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if ((*counters)->fds[i] >= 0)
+            close((*counters)->fds[i]);
+    }
+    free(*counters);
+    (*counters) = 0;
+}
+
+/**
+ * @brief Returns the number of counters that could be opened.
+ */
+int counters_available(const PerfCounters *counters)
+{
+    int available = 0;
+    for (int i = 0; counters && i < NUM_COUNTERS; i++)
+        available += counters->fds[i] >= 0;
+    return available;
+}
+
+/**
+ * @brief Starts measuring a region: resets the counters and starts them.
+ */
+void counters_start(PerfCounters *counters)
+{
+    if (!counters)
+        return;
+
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+    }
+    counters->start = now_seconds();
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/**
+ * @brief Stops measuring a region, and reads the counters.
+ */
+void counters_stop(PerfCounters *counters)
+{
+    if (!counters)
+        return;
+
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    counters->elapsed = now_seconds() - counters->start;
+
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        uint64_t data[3]; // The count, the time it was enabled and the time it really counted
+        counters->counted[i] = false;
+        counters->values[i] = 0;
+        if (counters->fds[i] < 0 || read(counters->fds[i], data, sizeof(data)) != sizeof(data) || !data[2])
+            continue;
+
+        counters->counted[i] = true;
+        counters->values[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+    }
+}
+
+/**
+ * @brief Prints the header line for `counters_report`.
+ */
+void counters_header(FILE *out)
+{
+    fprintf(out, "    %-28s %9s", "", "ns/op");
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        fprintf(out, " %10s", counter_names[i]);
+    fprintf(out, " %6s\n", "IPC");
+}
+
+/**
+ * Prints the last measured region, with every count divided by the number of operations
+ * it did (so that regions of different sizes can be compared).
+ *
+ * @param name Name of the region
+ * @param ops Number of operations in the region
+ */
+void counters_report(const PerfCounters *counters, FILE *out, const char *name, long ops)
+{
+    if (!counters || ops <= 0)
+        return;
+
+    fprintf(out, "    %-28s %9.2f", name, counters->elapsed * 1e9 / ops);
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        double per_op = (double)counters->values[i] / ops;
+        if (counters->counted[i])
+            fprintf(out, per_op && per_op < 0.01 ? " %10.2e" : " %10.3f", per_op); // Rare events too
+        else
+            fprintf(out, " %10s", "-");
+    }
+    if (counters->counted[CYCLES] && counters->counted[INSTRUCTIONS] && counters->values[CYCLES])
+        fprintf(out, " %6.2f\n", (double)counters->values[INSTRUCTIONS] / counters->values[CYCLES]);
+    else
+        fprintf(out, " %6s\n", "-");
+}
+
+/*
+ * What we measure: the array `Stack` and the `Node` list, from the Pointers examples.
+ */
+typedef struct stack
+{
+    int *stack_arr;
+    int size;
+    int *top;
+} Stack;
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+Stack *create_stack(int size)
+{
+    if (size <= 0)
+        return 0;
+
+    Stack *stack = (Stack *)calloc(1, sizeof(Stack));
+    if (!stack)
+        return 0;
+
+    // One extra slot, since `push` moves `top` BEFORE writing the value
+    stack->stack_arr = (int *)calloc(size + 1, sizeof(int));
+    if (!(stack->stack_arr))
+    {
+        free(stack);
+        return 0;
+    }
+    stack->size = size;
+    stack->top = stack->stack_arr;
+
+    return stack;
+}
+
+int is_empty(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr) || (stack->top == stack->stack_arr))
+        return 1;
+    return 0;
+}
+
+int is_full(Stack *stack)
+{
+    if (!stack || !(stack->stack_arr))
+        return 0;
+    return (stack->top - stack->stack_arr) == stack->size;
+}
+
+int push(Stack *stack, int value)
+{
+    if (!stack || !(stack->stack_arr) || is_full(stack))
+        return 0;
+
+    stack->top++;
+    *(stack->top) = value;
+    return 1;
+}
+
+int pop(Stack *stack)
+{
+    if (!stack || !(stack->top) || is_empty(stack))
+        return INT_MAX;
+
+    int top = *(stack->top);
+    stack->top--;
+    return top;
+}
+
+void destroy_stack(Stack *stack)
+{
+    if (!stack)
+        return;
+
+    free(stack->stack_arr);
+    free(stack);
+}
+
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+void insert_node(Node **list, Node *new_node)
+{
+    if (!new_node || !list)
+        return;
+
+    new_node->next = (*list);
+    (*list) = new_node;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+int strlen_pointer(char *str)
+{
+    if (!str)
+        return 0;
+
+    char *scan = str;
+    while (*scan)
+        scan++;
+
+    return (scan - str);
+}
+
+static volatile long sink; // Keeps the compiler from throwing the measured work away
+
+static void bench_stack_and_list(PerfCounters *counters)
+{
+    printf("Stack vs. list (%d pushes, then as many pops):\n", BENCH_STACK_OPS);
+    counters_header(stdout);
+
+    Stack *stack = create_stack(BENCH_STACK_OPS);
+    if (stack)
+    {
+        counters_start(counters);
+        for (int i = 0; i < BENCH_STACK_OPS; i++)
+            push(stack, i);
+        long sum = 0;
+        for (int i = 0; i < BENCH_STACK_OPS; i++)
+            sum += pop(stack);
+        counters_stop(counters);
+        sink = sum;
+        counters_report(counters, stdout, "Array stack push + pop", BENCH_STACK_OPS);
+        destroy_stack(stack);
+    }
+
+    // The same as a list: every push is a `malloc`, every pop a `free`
+    Node *list = 0;
+    counters_start(counters);
+    for (int i = 0; i < BENCH_STACK_OPS; i++)
+        insert_node(&list, create_node(i));
+    long sum = 0;
+    while (list)
+    {
+        Node *top = list;
+        list = list->next;
+        sum += top->value;
+        free(top);
+    }
+    counters_stop(counters);
+    sink = sum;
+    counters_report(counters, stdout, "Node list push + pop", BENCH_STACK_OPS);
+
+    // Walking a list whose nodes are scattered in memory: each step waits for a cache miss
+    Node **nodes = (Node **)malloc(BENCH_LIST_NODES * sizeof(Node *));
+    if (!nodes)
+        return;
+    for (int i = 0; i < BENCH_LIST_NODES; i++)
+        nodes[i] = create_node(i);
+    for (int i = BENCH_LIST_NODES - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        Node *temp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = temp;
+    }
+    for (int i = 0; i < BENCH_LIST_NODES; i++)
+    {
+        if (nodes[i])
+            insert_node(&list, nodes[i]);
+    }
+    free(nodes);
+
+    counters_start(counters);
+    sum = 0;
+    for (Node *scan = list; scan; scan = scan->next)
+        sum += scan->value;
+    counters_stop(counters);
+    sink = sum;
+    counters_report(counters, stdout, "Walk a scattered list", BENCH_LIST_NODES);
+    destroy_list(&list);
+
+    int *values = (int *)malloc(BENCH_LIST_NODES * sizeof(int));
+    if (!values)
+        return;
+    for (int i = 0; i < BENCH_LIST_NODES; i++)
+        values[i] = i;
+    counters_start(counters);
+    sum = 0;
+    for (int i = 0; i < BENCH_LIST_NODES; i++)
+        sum += values[i];
+    counters_stop(counters);
+    sink = sum;
+    counters_report(counters, stdout, "Walk an array", BENCH_LIST_NODES);
+    free(values);
+}
+
+static void bench_strings(PerfCounters *counters)
+{
+    printf("Strings (%d MB, per byte):\n", BENCH_STRING_LENGTH >> 20);
+    counters_header(stdout);
+
+    char *str = (char *)malloc(BENCH_STRING_LENGTH + 1);
+    if (!str)
+        return;
+    memset(str, 'a', BENCH_STRING_LENGTH);
+    str[BENCH_STRING_LENGTH] = '\0';
+
+    counters_start(counters);
+    sink = strlen_pointer(str);
+    counters_stop(counters);
+    counters_report(counters, stdout, "strlen_pointer", BENCH_STRING_LENGTH);
+
+    counters_start(counters);
+    sink = strlen(str);
+    counters_stop(counters);
+    counters_report(counters, stdout, "strlen (libc)", BENCH_STRING_LENGTH);
+
+    char *copy = (char *)malloc(BENCH_STRING_LENGTH + 1);
+    if (copy)
+    {
+        // The first touch of every page of `copy` is a page fault
+        counters_start(counters);
+        memcpy(copy, str, BENCH_STRING_LENGTH + 1);
+        counters_stop(counters);
+        sink = copy[BENCH_STRING_LENGTH / 2];
+        counters_report(counters, stdout, "memcpy into fresh memory", BENCH_STRING_LENGTH);
+
+        counters_start(counters);
+        memcpy(copy, str, BENCH_STRING_LENGTH + 1);
+        counters_stop(counters);
+        sink = copy[BENCH_STRING_LENGTH / 2];
+        counters_report(counters, stdout, "memcpy again", BENCH_STRING_LENGTH);
+        free(copy);
+    }
+    free(str);
+}
+
+static void bench_matrices(PerfCounters *counters)
+{
+    printf("Filling a %dx%d matrix (per element):\n", BENCH_MATRIX_SIZE, BENCH_MATRIX_SIZE);
+    counters_header(stdout);
+
+    const long elements = (long)BENCH_MATRIX_SIZE * BENCH_MATRIX_SIZE;
+    int *matrix = (int *)malloc(elements * sizeof(int));
+    if (!matrix)
+        return;
+    memset(matrix, -1, elements * sizeof(int)); // So page faults don't count in what follows
+
+    counters_start(counters);
+    for (int row = 0; row < BENCH_MATRIX_SIZE; row++)
+    {
+        for (int col = 0; col < BENCH_MATRIX_SIZE; col++)
+            *(matrix + row * BENCH_MATRIX_SIZE + col) = row + col;
+    }
+    counters_stop(counters);
+    sink = matrix[elements / 3];
+    counters_report(counters, stdout, "Row by row", elements);
+
+    // Every write is 16 KB after the previous one: a new cache line, and often a new page
+    counters_start(counters);
+    for (int col = 0; col < BENCH_MATRIX_SIZE; col++)
+    {
+        for (int row = 0; row < BENCH_MATRIX_SIZE; row++)
+            *(matrix + row * BENCH_MATRIX_SIZE + col) = row + col;
+    }
+    counters_stop(counters);
+    sink = matrix[elements / 3];
+    counters_report(counters, stdout, "Column by column", elements);
+
+    free(matrix);
+}
+
+int main(void)
+{
+    printf("*********************************PERFORMANCE COUNTERS:*********************************\n");
+    // Timings show that the list is slower than the stack, and that filling a matrix column
+    // by column is slower than row by row - counters show why: instructions per operation,
+    // and cache, TLB and branch misses per operation.
+    PerfCounters *counters = open_counters();
+    if (!counters)
+        return 0;
+
+    int available = counters_available(counters);
+    printf("%d of %d counters are available\n", available, NUM_COUNTERS);
+    if (available < NUM_COUNTERS)
+    {
+        printf("Some counters couldn't be opened (%s)", strerror(counters->open_error));
+        FILE *paranoid = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        int level;
+        if (paranoid && fscanf(paranoid, "%d", &level) == 1)
+            printf("; perf_event_paranoid is %d", level);
+        if (paranoid)
+            fclose(paranoid);
+        printf(". They are shown as \"-\".\n");
+    }
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    bench_strings(counters); // First, while `malloc` still gets big blocks straight from the kernel
+    bench_stack_and_list(counters);
+    bench_matrices(counters);
+
+    close_counters(&counters);
+    return 0;
+}
@@ -1,13 +1,146 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#define STR_REP_LEN 64
+#define STR_CACHE_INIT_SIZE 16
+#define BENCH_POINTS 10000000
+
+/*
+ * Only the coordinates are kept in the instance itself: they are what almost
+ * every use of a point reads, so 8 points now fit in a single cache line.
+ * The string representation is only needed by `to_string`, so it's kept
+ * elsewhere - see `str_cache` below.
+ */
 typedef struct point_instance
 {
     float x,y;
-    char str_rep[64];
 } point_instance;
 
+/**
+ * The string representation of a single point, allocated the first time
+ * the point's `to_string` is called.
+ *
+ * @param owner The point this representation belongs to
+ * @param x,y The coordinates `str_rep` was made from; if the point's coordinates
+ *            no longer match them, `str_rep` is out of date
+ * @param str_rep The string representation
+ */
+typedef struct str_cache_entry
+{
+    const point_instance* owner;
+    float x,y;
+    char str_rep[STR_REP_LEN];
+} str_cache_entry;
+
+/**
+ * A hash table from points to their string representations (open addressing, linear probing).
+ * Entries are allocated separately, so a string returned by `to_string` stays
+ * where it is when the table grows.
+ */
+static struct
+{
+    str_cache_entry** slots;
+    size_t capacity; //Always a power of 2
+    size_t count;
+} str_cache = {0, 0, 0};
+
+static size_t str_cache_slot(const point_instance* point)
+{
+    size_t key = (size_t)point;
+    key ^= key >> 17;
+    key *= 0x9E3779B97F4A7C15ull;
+    return (key ^ (key >> 29)) & (str_cache.capacity - 1);
+}
+
+/**
+ * @brief Finds the table slot of a point's string representation.
+ *
+ * @returns The slot holding `point`'s entry, or the empty slot where it would go.
+ */
+static size_t str_cache_find(const point_instance* point)
+{
+    size_t slot = str_cache_slot(point);
+    while(str_cache.slots[slot] && str_cache.slots[slot]->owner != point)
+        slot = (slot + 1) & (str_cache.capacity - 1);
+    return slot;
+}
+
+/**
+ * @brief Doubles the size of the table (or creates it).
+ *
+ * @returns 1 on success, 0 on error.
+ */
+static int str_cache_grow(void)
+{
+    size_t old_capacity = str_cache.capacity;
+    str_cache_entry** old_slots = str_cache.slots;
+
+    size_t capacity = old_capacity ? old_capacity * 2 : STR_CACHE_INIT_SIZE;
+    str_cache_entry** slots = (str_cache_entry**)calloc(capacity, sizeof(str_cache_entry*));
+    if(!slots) return 0;
+
+    str_cache.slots = slots;
+    str_cache.capacity = capacity;
+    for(size_t i = 0; i < old_capacity; i++)
+    {
+        if(old_slots[i]) str_cache.slots[str_cache_find(old_slots[i]->owner)] = old_slots[i];
+    }
+    free(old_slots);
+    return 1;
+}
+
+/**
+ * @brief Finds the string representation of a point, creating an empty one if it has none.
+ *
+ * @returns The point's entry, or NULL on error.
+ */
+static str_cache_entry* str_cache_get(const point_instance* point)
+{
+    if((str_cache.count + 1) * 2 > str_cache.capacity && !str_cache_grow()) return 0;
+
+    size_t slot = str_cache_find(point);
+    if(!str_cache.slots[slot])
+    {
+        str_cache_entry* entry = (str_cache_entry*)calloc(1, sizeof(str_cache_entry));
+        if(!entry) return 0;
+        entry->owner = point;
+        str_cache.slots[slot] = entry;
+        str_cache.count++;
+    }
+    return str_cache.slots[slot];
+}
+
+/**
+ * @brief Removes (and frees) the string representation of a point, if it has one.
+ */
+static void str_cache_remove(const point_instance* point)
+{
+    if(!str_cache.count) return;
+
+    size_t slot = str_cache_find(point);
+    if(!str_cache.slots[slot]) return;
+
+    free(str_cache.slots[slot]);
+    str_cache.slots[slot] = 0;
+    str_cache.count--;
+
+    //With linear probing we can't just leave a hole: entries after it that were
+    //pushed past their home slot must be moved back, or they could no longer be found.
+    size_t hole = slot;
+    for(size_t scan = (slot + 1) & (str_cache.capacity - 1); str_cache.slots[scan]; scan = (scan + 1) & (str_cache.capacity - 1))
+    {
+        size_t home = str_cache_slot(str_cache.slots[scan]->owner);
+        if(((scan - home) & (str_cache.capacity - 1)) >= ((scan - hole) & (str_cache.capacity - 1)))
+        {
+            str_cache.slots[hole] = str_cache.slots[scan];
+            str_cache.slots[scan] = 0;
+            hole = scan;
+        }
+    }
+}
+
 typedef struct point_class
 {
     point_instance* (*constructor)(float, float);
@@ -41,6 +174,7 @@ point_instance* pb_cpy_constructor(const point_instance* rhs)
 void pb_destructor(void** instance)
 {
     if(!instance || !*instance) return;
+    str_cache_remove((point_instance*)(*instance));
     free((point_instance*)(*instance));
     *instance = 0;
 }
@@ -49,8 +183,17 @@ const char* pb_to_string(point_instance* point)
 {
     if(!point) return "";
 
-    sprintf(point->str_rep, "(%.2f,%.2f)", point->x, point->y);
-    return (point->str_rep);
+    str_cache_entry* entry = str_cache_get(point);
+    if(!entry) return "";
+
+    //The string is only rebuilt if the coordinates changed since it was last made
+    if(!entry->str_rep[0] || entry->x != point->x || entry->y != point->y)
+    {
+        entry->x = point->x;
+        entry->y = point->y;
+        snprintf(entry->str_rep, STR_REP_LEN, "(%.2f,%.2f)", point->x, point->y);
+    }
+    return (entry->str_rep);
 }
 
 void delete(void** instance, void(*destructor)(void** type_instance))
@@ -73,6 +216,61 @@ point cpy_Point(const point rhs)
     return instance;
 }
 
+//The layout `point_instance` had before its string representation was moved out, for comparison
+typedef struct legacy_point_instance
+{
+    float x,y;
+    char str_rep[64];
+} legacy_point_instance;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Compares traversing BENCH_POINTS points in the old and the new layout.
+ */
+void bench_layouts(void)
+{
+    legacy_point_instance* legacy = (legacy_point_instance*)calloc(BENCH_POINTS, sizeof(legacy_point_instance));
+    point_instance* compact = (point_instance*)calloc(BENCH_POINTS, sizeof(point_instance));
+    if(!legacy || !compact)
+    {
+        free(legacy);
+        free(compact);
+        return;
+    }
+
+    for(int i = 0; i < BENCH_POINTS; i++)
+    {
+        legacy[i].x = compact[i].x = (float)(i % 1000);
+        legacy[i].y = compact[i].y = (float)(i % 7);
+    }
+
+    double start = now_seconds();
+    double legacy_sum = 0;
+    for(int i = 0; i < BENCH_POINTS; i++) legacy_sum += legacy[i].x + legacy[i].y;
+    double legacy_time = now_seconds() - start;
+
+    start = now_seconds();
+    double compact_sum = 0;
+    for(int i = 0; i < BENCH_POINTS; i++) compact_sum += compact[i].x + compact[i].y;
+    double compact_time = now_seconds() - start;
+
+    printf("%d points:\n", BENCH_POINTS);
+    printf("  With str_rep inside: %3zu bytes/point, %7.1f MB, sum of coordinates in %.3f s\n",
+           sizeof(legacy_point_instance), BENCH_POINTS * sizeof(legacy_point_instance) / 1e6, legacy_time);
+    printf("  Coordinates only:    %3zu bytes/point, %7.1f MB, sum of coordinates in %.3f s (%s)\n",
+           sizeof(point_instance), BENCH_POINTS * sizeof(point_instance) / 1e6, compact_time,
+           legacy_sum == compact_sum ? "same result" : "DIFFERENT RESULT");
+
+    free(legacy);
+    free(compact);
+}
+
 int main(void)
 {
     point p1 = new_Point(1,1);
@@ -93,5 +291,11 @@ int main(void)
     delete((void*)&p1, Point.destructor);
 
     printf("%p\n", p1);
+
+    delete((void*)&p2, Point.destructor);
+
+    //A `point_instance` holds only its coordinates; the string made by `to_string` is stored
+    //separately, and only for points that were actually turned into strings.
+    bench_layouts();
     return 0;
 }
\ No newline at end of file
@@ -46,13 +46,11 @@ Node *destroy_list(Node *head)
 {
     if (!head)
         return 0;
-    if (head->next)
-        return destroy_list(head->next);
-    else
-    {
-        free(head);
-        return 0;
-    }
+
+    // Destroy the rest of the list first, since we can't reach it once `head` is freed
+    destroy_list(head->next);
+    free(head);
+    return 0;
 }
 
 int main(void)
@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <malloc.h>
+#include <time.h>
+
+#define BENCH_ITEMS 1000000
+#define BENCH_REMOVALS 200
+
+/**
+ * Returns a pointer to the struct of type `type` that has `ptr` as its member `member`:
+ * since the member is at a fixed offset inside the struct, the struct starts that many
+ * bytes before it.
+ */
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+/*
+ * In an "intrusive" list, the list doesn't hold the values: the values hold the list.
+ * Each object that can be in a list has a link member, and the list connects those links.
+ * So putting an object in a list allocates nothing, an object can be in as many lists as
+ * it has links, and given the object we already have its link - no search needed.
+ */
+
+/**
+ * A link of a singly linked intrusive list. Like `Node`, but without the value:
+ * it's a member of the struct it links.
+ *
+ * @param next The next link, or NULL at the end of the list
+ */
+typedef struct link
+{
+    struct link *next;
+} Link;
+
+/**
+ * @brief Inserts a link at the head of a list. Like `insert_node`, the list
+ *        is represented by a DOUBLE POINTER to its head.
+ */
+void push_link(Link **list, Link *link)
+{
+    if (!list || !link)
+        return;
+
+    link->next = (*list);
+    (*list) = link;
+}
+
+/**
+ * @brief Removes the head of a list, and returns it (or NULL if the list is empty).
+ */
+Link *pop_link(Link **list)
+{
+    if (!list || !(*list))
+        return 0;
+
+    Link *head = (*list);
+    (*list) = head->next;
+    head->next = 0;
+    return head;
+}
+
+/**
+ * Finds where a list points to a link.
+ * We walk the list with a DOUBLE POINTER: `slot` is the address of the pointer that
+ * leads to the current link - at first the head pointer itself, later some link's `next`.
+ * That way the head is no special case.
+ *
+ * @returns The pointer to `link` (the head pointer or a `next` field), or NULL if it isn't in the list.
+ */
+Link **find_link(Link **list, Link *link)
+{
+    if (!list || !link)
+        return 0;
+
+    Link **slot = list;
+    while (*slot && *slot != link)
+        slot = &((*slot)->next);
+    return *slot ? slot : 0;
+}
+
+/**
+ * @brief Removes the link that `slot` points to, in O(1).
+ *        `slot` is the head pointer or a `next` field, as `find_link` returns.
+ */
+void unlink_at(Link **slot)
+{
+    if (!slot || !(*slot))
+        return;
+
+    Link *link = (*slot);
+    (*slot) = link->next;
+    link->next = 0;
+}
+
+/**
+ * Moves all the links of `src` into another list, in front of what `slot` points to.
+ * A singly linked list doesn't know its tail, so this walks `src` to find it: O(length of `src`).
+ * (`splice_dlist` does it in O(1).)
+ *
+ * @param slot The head pointer of a list, or a `next` field in it
+ * @param src The list to move; it's left empty
+ */
+void splice_links(Link **slot, Link **src)
+{
+    if (!slot || !src || !(*src))
+        return;
+
+    Link **tail = src;
+    while (*tail)
+        tail = &((*tail)->next);
+    (*tail) = (*slot);
+    (*slot) = (*src);
+    (*src) = 0;
+}
+
+/**
+ * A link of a doubly linked intrusive list.
+ * The list is circular, and its head is a `DLink` too, which links to the first and last
+ * links (and to itself when the list is empty). Like the double pointer, this removes the
+ * special cases: every link has a previous and a next one, so unlinking needs no list at all.
+ *
+ * @param next The next link (the head, after the last one)
+ * @param prev The previous link (the head, before the first one)
+ */
+typedef struct dlink
+{
+    struct dlink *next;
+    struct dlink *prev;
+} DLink;
+
+/**
+ * @brief Makes a head an empty list.
+ */
+void init_dlist(DLink *head)
+{
+    if (!head)
+        return;
+
+    head->next = head;
+    head->prev = head;
+}
+
+bool dlist_is_empty(const DLink *head)
+{
+    return !head || head->next == head;
+}
+
+/**
+ * @brief Inserts `link` between `prev` and `next`, which are adjacent.
+ */
+static void insert_between(DLink *link, DLink *prev, DLink *next)
+{
+    link->prev = prev;
+    link->next = next;
+    prev->next = link;
+    next->prev = link;
+}
+
+void dlist_push_front(DLink *head, DLink *link)
+{
+    if (!head || !link)
+        return;
+
+    insert_between(link, head, head->next);
+}
+
+void dlist_push_back(DLink *head, DLink *link)
+{
+    if (!head || !link)
+        return;
+
+    insert_between(link, head->prev, head);
+}
+
+/**
+ * @brief Removes a link from whichever list it's in, in O(1).
+ *        The link is left pointing to itself, so unlinking it again does nothing.
+ */
+void dlist_unlink(DLink *link)
+{
+    if (!link)
+        return;
+
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link;
+    link->prev = link;
+}
+
+/**
+ * @brief Moves all the links of the list `src` to the end of the list `dst`, in O(1).
+ *        `src` is left empty.
+ */
+void splice_dlist(DLink *dst, DLink *src)
+{
+    if (!dst || !src || dst == src || dlist_is_empty(src))
+        return;
+
+    DLink *first = src->next, *last = src->prev;
+    first->prev = dst->prev;
+    dst->prev->next = first;
+    last->next = dst;
+    dst->prev = last;
+    init_dlist(src);
+}
+
+// Iterates over a doubly linked list (don't unlink `link` inside the loop)
+#define dlist_for_each(link, head) for (DLink *link = (head)->next; link != (head); link = link->next)
+
+/**
+ * An object that can be in two lists at once, without any allocation:
+ * a singly linked one through `all`, and a doubly linked one through `queue`.
+ */
+typedef struct item
+{
+    int id;
+    int value;
+    Link all;
+    DLink queue;
+} Item;
+
+void print_items(Link **list)
+{
+    printf("List:");
+    for (Link *scan = (*list); scan; scan = scan->next)
+        printf(" %d", container_of(scan, Item, all)->id);
+    printf("\n");
+}
+
+void print_queue(const char *name, DLink *head)
+{
+    printf("%s:", name);
+    dlist_for_each(link, head) printf(" %d", container_of(link, Item, queue)->id);
+    printf("\n");
+}
+
+/*
+ * The non-intrusive way, for comparison: nodes that point to the objects. Every time
+ * an object goes into a list, a node is allocated for it.
+ */
+typedef struct ref_node
+{
+    Item *item;
+    struct ref_node *next;
+} RefNode;
+
+typedef struct ref_dnode
+{
+    Item *item;
+    struct ref_dnode *next;
+    struct ref_dnode *prev;
+} RefDNode;
+
+static long num_allocations = 0, allocated_bytes = 0;
+
+/**
+ * @brief A `malloc` that counts the calls, and the bytes they really took from the heap.
+ */
+static void *counted_malloc(size_t size)
+{
+    void *memory = malloc(size);
+    if (memory)
+    {
+        num_allocations++;
+        allocated_bytes += malloc_usable_size(memory) + sizeof(size_t); // Plus malloc's own header
+    }
+    return memory;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile long sink; // Keeps the compiler from throwing the measured work away
+
+static void report(const char *name, double elapsed, long ops)
+{
+    printf("    %-40s | %8.2f ns/op\n", name, elapsed * 1e9 / ops);
+}
+
+/**
+ * @brief Puts every item in a singly and a doubly linked list, walks them, removes some
+ *        items from the doubly linked one, and takes it all apart - with intrusive links.
+ */
+static void bench_intrusive(Item *items, const int *removals)
+{
+    printf("Intrusive lists:\n");
+    long allocations_before = num_allocations, bytes_before = allocated_bytes;
+
+    Link *all = 0;
+    DLink queue;
+    init_dlist(&queue);
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ITEMS; i++)
+    {
+        push_link(&all, &items[i].all);
+        dlist_push_back(&queue, &items[i].queue);
+    }
+    report("Insert into both lists", now_seconds() - start, BENCH_ITEMS);
+
+    start = now_seconds();
+    long sum = 0;
+    for (Link *scan = all; scan; scan = scan->next)
+        sum += container_of(scan, Item, all)->value;
+    dlist_for_each(link, &queue) sum += container_of(link, Item, queue)->value;
+    sink = sum;
+    report("Walk both lists", now_seconds() - start, 2L * BENCH_ITEMS);
+
+    // We have the item, so we have its link
+    start = now_seconds();
+    for (int i = 0; i < BENCH_REMOVALS; i++)
+        dlist_unlink(&items[removals[i]].queue);
+    report("Remove a given item (doubly linked)", now_seconds() - start, BENCH_REMOVALS);
+
+    start = now_seconds();
+    while (pop_link(&all))
+        ;
+    while (!dlist_is_empty(&queue))
+        dlist_unlink(queue.next);
+    report("Empty both lists", now_seconds() - start, BENCH_ITEMS);
+
+    printf("    %ld allocations, %ld bytes for the links\n", num_allocations - allocations_before,
+           allocated_bytes - bytes_before);
+}
+
+/**
+ * @brief The same, with nodes that point to the items.
+ */
+static void bench_external(Item *items, const int *removals)
+{
+    printf("Lists of nodes pointing to the items:\n");
+    long allocations_before = num_allocations, bytes_before = allocated_bytes;
+
+    RefNode *all = 0;
+    RefDNode queue = {0, &queue, &queue};
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ITEMS; i++)
+    {
+        RefNode *node = (RefNode *)counted_malloc(sizeof(RefNode));
+        RefDNode *dnode = (RefDNode *)counted_malloc(sizeof(RefDNode));
+        if (!node || !dnode)
+        {
+            free(node);
+            free(dnode);
+            break;
+        }
+        node->item = &items[i];
+        node->next = all;
+        all = node;
+
+        dnode->item = &items[i];
+        dnode->prev = queue.prev;
+        dnode->next = &queue;
+        queue.prev->next = dnode;
+        queue.prev = dnode;
+    }
+    report("Insert into both lists", now_seconds() - start, BENCH_ITEMS);
+
+    start = now_seconds();
+    long sum = 0;
+    for (RefNode *scan = all; scan; scan = scan->next)
+        sum += scan->item->value;
+    for (RefDNode *scan = queue.next; scan != &queue; scan = scan->next)
+        sum += scan->item->value;
+    sink = sum;
+    report("Walk both lists", now_seconds() - start, 2L * BENCH_ITEMS);
+
+    // Nothing leads from the item to its node: we have to search for it
+    start = now_seconds();
+    for (int i = 0; i < BENCH_REMOVALS; i++)
+    {
+        RefDNode *scan = queue.next;
+        while (scan != &queue && scan->item != &items[removals[i]])
+            scan = scan->next;
+        if (scan == &queue)
+            continue;
+        scan->prev->next = scan->next;
+        scan->next->prev = scan->prev;
+        free(scan);
+    }
+    report("Remove a given item (doubly linked)", now_seconds() - start, BENCH_REMOVALS);
+
+    start = now_seconds();
+    while (all)
+    {
+        RefNode *temp = all;
+        all = all->next;
+        free(temp);
+    }
+    while (queue.next != &queue)
+    {
+        RefDNode *temp = queue.next;
+        queue.next = temp->next;
+        free(temp);
+    }
+    report("Empty both lists", now_seconds() - start, BENCH_ITEMS);
+
+    printf("    %ld allocations, %ld bytes for the nodes\n", num_allocations - allocations_before,
+           allocated_bytes - bytes_before);
+}
+
+int main(void)
+{
+    printf("*********************************INTRUSIVE LISTS:*********************************\n");
+    // A `Node` holds its value, so listing objects we already have means a `Node` per
+    // object per list. An intrusive list links the objects themselves.
+    Item items[6];
+    Link *list = 0;
+    DLink ready, waiting;
+    init_dlist(&ready);
+    init_dlist(&waiting);
+    for (int i = 0; i < 6; i++)
+    {
+        items[i].id = i + 1;
+        items[i].value = 10 * (i + 1);
+        push_link(&list, &items[i].all);
+        dlist_push_back(i % 2 ? &ready : &waiting, &items[i].queue);
+    }
+    print_items(&list);
+    print_queue("Ready", &ready);
+    print_queue("Waiting", &waiting);
+
+    // The same `Node**` walk as always finds where the list points to item 3...
+    Link **slot = find_link(&list, &items[2].all);
+    unlink_at(slot);
+    printf("Without item 3 - ");
+    print_items(&list);
+
+    // ...and the head is no special case
+    unlink_at(find_link(&list, &items[5].all));
+    printf("Without item 6 - ");
+    print_items(&list);
+
+    // From the item itself, in O(1), without knowing the list
+    dlist_unlink(&items[3].queue);
+    printf("Item 4 left its queue\n");
+    print_queue("Ready", &ready);
+
+    splice_dlist(&ready, &waiting);
+    printf("Waiting items spliced into the ready queue\n");
+    print_queue("Ready", &ready);
+    print_queue("Waiting", &waiting);
+
+    Link *other = 0;
+    push_link(&other, &items[2].all);
+    push_link(&other, &items[5].all);
+    splice_links(&list, &other);
+    printf("Items 6 and 3 spliced back in - ");
+    print_items(&list);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    printf("%d items, each in two lists; %d given items removed\n", BENCH_ITEMS, BENCH_REMOVALS);
+    Item *bench_items = (Item *)counted_malloc(BENCH_ITEMS * sizeof(Item));
+    int *removals = (int *)malloc(BENCH_REMOVALS * sizeof(int));
+    if (!bench_items || !removals)
+    {
+        free(bench_items);
+        free(removals);
+        return 0;
+    }
+    printf("The items themselves: 1 allocation, %zu bytes (%zu per item, links included)\n",
+           BENCH_ITEMS * sizeof(Item), sizeof(Item));
+
+    srand(49);
+    for (int i = 0; i < BENCH_ITEMS; i++)
+    {
+        bench_items[i].id = i;
+        bench_items[i].value = rand() % 1000;
+    }
+    // Distinct items, from all over the list
+    for (int i = 0; i < BENCH_REMOVALS; i++)
+        removals[i] = (int)((long)i * BENCH_ITEMS / BENCH_REMOVALS + rand() % (BENCH_ITEMS / BENCH_REMOVALS));
+
+    bench_external(bench_items, removals);
+    bench_intrusive(bench_items, removals);
+
+    free(bench_items);
+    free(removals);
+    return 0;
+}
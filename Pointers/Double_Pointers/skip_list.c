@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_LEVEL 24
+#define BENCH_SIZE 1000000
+#define BENCH_LOOKUPS 2000
+#define BENCH_LIST_LOOKUPS 200
+
+typedef struct node
+{
+    int value;
+    struct node *next;
+} Node;
+
+/**
+ * A node of an ordered skip list.
+ *
+ * @param value The value held by the node
+ * @param levels The number of levels the node takes part in
+ * @param next An array of `levels` pointers, where next[i] is the following
+ *             node on level i. The array is stored INLINE at the end of the node,
+ *             so moving to the next node on any level touches a single allocation.
+ */
+typedef struct skip_node
+{
+    int value;
+    int levels;
+    struct skip_node *next[];
+} SkipNode;
+
+static unsigned int rand_state = 2463534242u;
+
+/**
+ * @brief Returns a pseudo-random number (xorshift32).
+ */
+static unsigned int next_rand(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+/**
+ * @brief Picks a level for a new node, where each level is
+ *        half as likely as the one below it.
+ */
+static int random_level(void)
+{
+    int level = 1;
+    unsigned int bits = next_rand();
+    while ((bits & 1) && level < MAX_LEVEL)
+    {
+        level++;
+        bits >>= 1;
+    }
+    return level;
+}
+
+/**
+ * @brief Allocates a skip list node with room for `levels` inline pointers.
+ *
+ * @returns A new node, or NULL on error.
+ */
+static SkipNode *create_skip_node(int value, int levels)
+{
+    SkipNode *node = (SkipNode *)calloc(1, sizeof(SkipNode) + levels * sizeof(SkipNode *));
+    if (!node)
+        return 0;
+
+    node->value = value;
+    node->levels = levels;
+    return node;
+}
+
+/**
+ * Creates an empty skip list.
+ * The list is represented by a "head" node which holds no value,
+ * and the list's current height is kept in the head's `value`.
+ *
+ * @returns The head of a new, empty list, or NULL on error.
+ */
+SkipNode *create_skip_list(void)
+{
+    SkipNode *head = create_skip_node(0, MAX_LEVEL);
+    if (!head)
+        return 0;
+
+    head->value = 1;
+    return head;
+}
+
+/**
+ * Finds, for every level, the last node whose value is smaller than `value`.
+ *
+ * @param head The head of the list
+ * @param value Value to search for
+ * @param update Array of MAX_LEVEL pointers which will be filled with the
+ *               predecessors on each level
+ *
+ * @returns The first node with a value >= `value`, or NULL if there's none.
+ */
+static SkipNode *find_predecessors(SkipNode *head, int value, SkipNode **update)
+{
+    SkipNode *scan = head;
+    for (int level = head->value - 1; level >= 0; level--)
+    {
+        while (scan->next[level] && scan->next[level]->value < value)
+            scan = scan->next[level];
+        update[level] = scan;
+    }
+    return scan->next[0];
+}
+
+/**
+ * Inserts a value into a skip list, keeping it ordered.
+ * Duplicate values are allowed, and are placed before equal values.
+ *
+ * @param list Pointer to the head of the list
+ * @param value Value to insert
+ *
+ * @returns 1 if the value was inserted, 0 on error.
+ */
+int skip_insert(SkipNode **list, int value)
+{
+    if (!list || !(*list))
+        return 0;
+
+    SkipNode *head = (*list);
+    SkipNode *update[MAX_LEVEL];
+    find_predecessors(head, value, update);
+
+    int levels = random_level();
+    SkipNode *new_node = create_skip_node(value, levels);
+    if (!new_node)
+        return 0;
+
+    // Levels above the current height of the list start at the head
+    for (int level = head->value; level < levels; level++)
+        update[level] = head;
+    if (levels > head->value)
+        head->value = levels;
+
+    for (int level = 0; level < levels; level++)
+    {
+        new_node->next[level] = update[level]->next[level];
+        update[level]->next[level] = new_node;
+    }
+
+    return 1;
+}
+
+/**
+ * Finds a value in a skip list.
+ *
+ * @param list Pointer to the head of the list
+ * @param value Value to find
+ *
+ * @returns The node holding `value`, or NULL if it is not in the list.
+ */
+SkipNode *skip_find(SkipNode **list, int value)
+{
+    if (!list || !(*list))
+        return 0;
+
+    SkipNode *scan = (*list);
+    for (int level = scan->value - 1; level >= 0; level--)
+    {
+        while (scan->next[level] && scan->next[level]->value < value)
+            scan = scan->next[level];
+    }
+    scan = scan->next[0];
+
+    return (scan && scan->value == value) ? scan : 0;
+}
+
+/**
+ * Removes one occurrence of a value from a skip list.
+ *
+ * @param list Pointer to the head of the list
+ * @param value Value to remove
+ *
+ * @returns 1 if a node was removed, 0 if `value` was not found or on error.
+ */
+int skip_erase(SkipNode **list, int value)
+{
+    if (!list || !(*list))
+        return 0;
+
+    SkipNode *head = (*list);
+    SkipNode *update[MAX_LEVEL];
+    SkipNode *target = find_predecessors(head, value, update);
+    if (!target || target->value != value)
+        return 0;
+
+    for (int level = 0; level < target->levels; level++)
+        update[level]->next[level] = target->next[level];
+
+    while (head->value > 1 && !head->next[head->value - 1])
+        head->value--;
+
+    free(target);
+    return 1;
+}
+
+/**
+ * Calls `func` for every value in the range [`low`, `high`], in ascending order.
+ *
+ * @param list Pointer to the head of the list
+ * @param low Lower bound of the range (inclusive)
+ * @param high Upper bound of the range (inclusive)
+ * @param func Callback which is passed each value in the range
+ *
+ * @returns The number of values visited.
+ */
+int skip_range(SkipNode **list, int low, int high, void (*func)(int))
+{
+    if (!list || !(*list) || low > high)
+        return 0;
+
+    SkipNode *update[MAX_LEVEL];
+    int count = 0;
+    for (SkipNode *scan = find_predecessors(*list, low, update); scan && scan->value <= high; scan = scan->next[0])
+    {
+        if (func)
+            func(scan->value);
+        count++;
+    }
+    return count;
+}
+
+void print_skip_list(SkipNode **list)
+{
+    printf("Skip list: ");
+    if (!list || !(*list))
+    {
+        printf("NULL pointer to list\n");
+        return;
+    }
+    else if (!(*list)->next[0])
+        printf("List is empty!");
+
+    for (SkipNode *scan = (*list)->next[0]; scan; scan = scan->next[0])
+        printf("%d ", scan->value);
+    printf("\n");
+}
+
+/**
+ * @brief Destroys a skip list, and points the given head to NULL.
+ *
+ * @param list Pointer to the head of the list
+ */
+void destroy_skip_list(SkipNode **list)
+{
+    if (!list || !(*list))
+        return;
+
+    SkipNode *scan = (*list);
+    while (scan)
+    {
+        SkipNode *temp = scan;
+        scan = scan->next[0];
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+/*
+ * The plain linked list from double_pointer_implementation.c, used as
+ * a baseline for the benchmark below.
+ */
+Node *create_node(int value)
+{
+    Node *new_node = (Node *)malloc(sizeof(Node));
+    if (!new_node)
+        return 0;
+
+    new_node->value = value;
+    new_node->next = 0;
+
+    return new_node;
+}
+
+void insert_node(Node **list, Node *new_node)
+{
+    if (!new_node || !list)
+        return;
+
+    new_node->next = (*list);
+    (*list) = new_node;
+}
+
+Node *find_node(Node **list, int value)
+{
+    if (!list)
+        return 0;
+
+    for (Node *scan = (*list); scan; scan = scan->next)
+    {
+        if (scan->value == value)
+            return scan;
+    }
+    return 0;
+}
+
+void destroy_list(Node **list)
+{
+    if (!list)
+        return;
+
+    Node *scan = (*list);
+    while (scan)
+    {
+        Node *temp = scan;
+        scan = scan->next;
+        free(temp);
+    }
+
+    (*list) = 0;
+}
+
+/**
+ * @brief Binary search over a sorted array.
+ *
+ * @returns 1 if `value` is in `arr`, 0 otherwise.
+ */
+int binary_search(const int *arr, int size, int value)
+{
+    int low = 0, high = size - 1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        if (arr[mid] < value)
+            low = mid + 1;
+        else if (arr[mid] > value)
+            high = mid - 1;
+        else
+            return 1;
+    }
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_value(int value)
+{
+    printf("%d ", value);
+}
+
+int main(void)
+{
+    printf("*********************************SKIP LISTS:*********************************\n");
+    // Our `insert_node` always inserts at the head, so to find a value we must scan
+    // the whole list. A skip list keeps the nodes ORDERED, and gives some of them
+    // extra "express lane" pointers which skip over many nodes at once.
+    // Each node is promoted to the next level with probability 1/2, so on average
+    // a search only looks at about log(n) nodes.
+
+    SkipNode *head = create_skip_list();
+    if (!head)
+        return 0;
+    SkipNode **list = &head; // Same double pointer idiom as in double_pointer_implementation.c
+
+    int values[10] = {42, 7, 19, 3, 88, 7, 56, 23, 71, 1};
+    for (int i = 0; i < 10; i++)
+        skip_insert(list, values[i]);
+    print_skip_list(list);
+
+    printf("19 is %s the list\n", skip_find(list, 19) ? "in" : "NOT in");
+    printf("20 is %s the list\n", skip_find(list, 20) ? "in" : "NOT in");
+
+    printf("Values in [7, 56]: ");
+    int count = skip_range(list, 7, 56, &print_value);
+    printf("(%d values)\n", count);
+
+    skip_erase(list, 7);
+    skip_erase(list, 88);
+    print_skip_list(list);
+
+    destroy_skip_list(list);
+    printf("`head` is %s NULL!\n", (!head) ? "" : "NOT");
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    // We'll build a list, a skip list and a sorted array of the even numbers in
+    // [0, 2*BENCH_SIZE), and then look up random values in each of them.
+    int *sorted = (int *)malloc(BENCH_SIZE * sizeof(int));
+    Node *plain = 0;
+    head = create_skip_list();
+    if (!sorted || !head)
+    {
+        free(sorted);
+        destroy_skip_list(list);
+        return 0;
+    }
+
+    // The skip list gets the same values as the others, but inserted in random order
+    for (int i = 0; i < BENCH_SIZE; i++)
+        sorted[i] = 2 * i;
+    for (int i = BENCH_SIZE - 1; i > 0; i--)
+    {
+        int j = (int)(next_rand() % (unsigned)(i + 1));
+        int temp = sorted[i];
+        sorted[i] = sorted[j];
+        sorted[j] = temp;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_SIZE; i++)
+        skip_insert(list, sorted[i]);
+    printf("Skip list: %d random inserts took %.3f s\n", BENCH_SIZE, now_seconds() - start);
+
+    for (int i = 0; i < BENCH_SIZE; i++)
+    {
+        sorted[i] = 2 * i;
+        insert_node(&plain, create_node(2 * i));
+    }
+
+    int *lookups = (int *)malloc(BENCH_LOOKUPS * sizeof(int));
+    if (!lookups)
+    {
+        free(sorted);
+        destroy_list(&plain);
+        destroy_skip_list(list);
+        return 0;
+    }
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+        lookups[i] = (int)(next_rand() % (2 * BENCH_SIZE));
+
+    int found = 0;
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LIST_LOOKUPS; i++)
+        found += find_node(&plain, lookups[i]) ? 1 : 0;
+    double list_time = (now_seconds() - start) / BENCH_LIST_LOOKUPS;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+        found += skip_find(list, lookups[i]) ? 1 : 0;
+    double skip_time = (now_seconds() - start) / BENCH_LOOKUPS;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+        found += binary_search(sorted, BENCH_SIZE, lookups[i]);
+    double array_time = (now_seconds() - start) / BENCH_LOOKUPS;
+
+    printf("Average lookup over %d elements (%d hits):\n", BENCH_SIZE, found);
+    printf("  Linear scan of Node list:   %10.1f ns\n", list_time * 1e9);
+    printf("  Skip list:                  %10.1f ns\n", skip_time * 1e9);
+    printf("  Sorted array binary search: %10.1f ns\n", array_time * 1e9);
+
+    free(lookups);
+    free(sorted);
+    destroy_list(&plain);
+    destroy_skip_list(list);
+
+    return 0;
+}
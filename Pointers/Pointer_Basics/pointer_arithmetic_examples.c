@@ -265,18 +265,20 @@ int main(void)
     int arr2[M][N];   // This is, in effect, the same as `int* arr2;`
     int *ptr = *arr2; // ptr contains the address of the start of arr2
 
-    for (int row = 1; row <= N; row++)
+    // NOTICE: `arr2` has M rows of N elements each, so the distance between
+    // the starts of two consecutive rows (the "row stride") is N, not M.
+    for (int row = 1; row <= M; row++)
     {
-        for (int col = 1; col <= M; col++)
+        for (int col = 1; col <= N; col++)
         {
-            *(ptr + FIT(row) * M + FIT(col)) = row * col;
+            *(ptr + FIT(row) * N + FIT(col)) = row * col;
         }
     }
 
-    int e2_5_5 = *(ptr + FIT(5) * M + FIT(5));
+    int e2_5_5 = *(ptr + FIT(5) * N + FIT(5));
     printf("The (5,5) element in arr is: %d\n", e2_5_5);
 
-    int e2_7_4 = *(ptr + FIT(7) * M + FIT(4));
+    int e2_7_4 = *(ptr + FIT(7) * N + FIT(4));
     printf("The (7,4) element in arr is: %d\n", e2_7_4);
 
     return 0;
@@ -0,0 +1,720 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define MAX_STACK 32
+#define MAX_CODE 256
+#define MAX_STRINGS 16
+#define NAME_LEN 16
+#define NUM_FIELDS 4
+#define BENCH_RECORDS 1000000
+#define BENCH_PASSES 10
+
+// Computed goto ("labels as values") is a GCC/Clang extension
+#if defined(__GNUC__)
+#define HAVE_COMPUTED_GOTO 1
+#else
+#define HAVE_COMPUTED_GOTO 0
+#endif
+
+/**
+ * A record that scripts run on.
+ *
+ * @param fields The record's int fields, named in `field_names`
+ * @param name The record's name
+ */
+typedef struct record
+{
+    int fields[NUM_FIELDS];
+    char name[NAME_LEN];
+} Record;
+
+const char *field_names[NUM_FIELDS] = {"id", "age", "salary", "dept"};
+
+/**
+ * The VM's instructions. Each is stored as its opcode followed by its operands
+ * (the number of which is in `op_lengths`), and works on a stack of values.
+ */
+typedef enum opcode
+{
+    OP_FIELD,     // field -> push the record's field
+    OP_CONST,     // value -> push the value
+    OP_NAME_EQ,   // string -> push whether the record's name equals the string
+    OP_ADD,       // a b -> a + b
+    OP_SUB,       // a b -> a - b
+    OP_MUL,       // a b -> a * b
+    OP_LT,        // a b -> a < b
+    OP_GT,        // a b -> a > b
+    OP_EQ,        // a b -> a == b
+    OP_AND,       // a b -> a && b
+    OP_OR,        // a b -> a || b
+    OP_NOT,       // a -> !a
+    OP_HALT,      // a -> stop, with the result a
+    // "Superinstructions", which do the work of a common sequence of instructions in one
+    // dispatch; never written in scripts, only produced by `fuse_superinstructions`
+    OP_FIELD_LT_CONST, // field value -> push field < value
+    OP_FIELD_GT_CONST, // field value -> push field > value
+    OP_FIELD_EQ_CONST, // field value -> push field == value
+    OP_FIELD_ADD_FIELD, // field field -> push the sum of the fields
+    NUM_OPCODES
+} Opcode;
+
+const int op_lengths[NUM_OPCODES] = {2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3};
+
+/**
+ * A cell of "threaded" code: instead of an opcode, each instruction starts with the
+ * address of the code that runs it, followed by its operands.
+ */
+typedef union cell
+{
+    const void *label;
+    long operand;
+} Cell;
+
+/**
+ * A compiled script.
+ *
+ * @param code The instructions
+ * @param length Number of ints in `code`
+ * @param strings The strings used by OP_NAME_EQ, by index
+ * @param threaded The threaded version of `code`, made on its first run by `run_threaded`
+ */
+typedef struct program
+{
+    int code[MAX_CODE];
+    int length;
+    char strings[MAX_STRINGS][NAME_LEN];
+    int num_strings;
+    Cell *threaded;
+} Program;
+
+static bool emit(Program *program, int op, int operand_1, int operand_2)
+{
+    if (program->length + op_lengths[op] > MAX_CODE)
+        return false;
+
+    int operands[2] = {operand_1, operand_2};
+    program->code[program->length++] = op;
+    for (int i = 1; i < op_lengths[op]; i++)
+        program->code[program->length++] = operands[i - 1];
+    return true;
+}
+
+/**
+ * Compiles a script, written in postfix notation: each word either pushes a value or
+ * replaces the values on top of the stack by the result of an operation. Words:
+ * - A field name (`id`, `age`, `salary`, `dept`) or a number: pushes it
+ * - `name:<string>`: pushes 1 if the record's name is <string>, otherwise 0
+ * - `+`, `-`, `*`, `<`, `>`, `=`, `and`, `or`, `not`: operations
+ * For example, "age 30 > dept 2 = and" selects records with age > 30 in department 2.
+ *
+ * @returns A new program, or NULL if the script is invalid (the reason is printed) or on error.
+ */
+Program *compile_script(const char *source)
+{
+    static const char *operators[9] = {"+", "-", "*", "<", ">", "=", "and", "or", "not"};
+    if (!source)
+        return 0;
+
+    Program *program = (Program *)calloc(1, sizeof(Program));
+    char *words = strdup(source);
+    if (!program || !words)
+    {
+        free(program);
+        free(words);
+        return 0;
+    }
+
+    int depth = 0;
+    bool ok = true;
+    for (char *word = strtok(words, " \t\n"); word && ok; word = strtok(0, " \t\n"))
+    {
+        char *end;
+        long number = strtol(word, &end, 10);
+        int field = 0, op = 0;
+        while (field < NUM_FIELDS && strcmp(word, field_names[field]))
+            field++;
+        while (op < 9 && strcmp(word, operators[op]))
+            op++;
+
+        if (field < NUM_FIELDS)
+            ok = emit(program, OP_FIELD, field, 0) && ++depth;
+        else if (!*end)
+            ok = emit(program, OP_CONST, (int)number, 0) && ++depth;
+        else if (!strncmp(word, "name:", 5) && strlen(word + 5) < NAME_LEN && program->num_strings < MAX_STRINGS)
+        {
+            strcpy(program->strings[program->num_strings], word + 5);
+            ok = emit(program, OP_NAME_EQ, program->num_strings++, 0) && ++depth;
+        }
+        else if (op < 9)
+        {
+            // `not` takes one value, the rest take two and leave one
+            int needed = (op == 8) ? 1 : 2;
+            if (depth < needed)
+            {
+                printf("Not enough values for '%s'\n", word);
+                ok = false;
+            }
+            else
+            {
+                ok = emit(program, OP_ADD + op, 0, 0);
+                depth -= needed - 1;
+            }
+        }
+        else
+        {
+            printf("Unknown word '%s'\n", word);
+            ok = false;
+        }
+
+        if (depth > MAX_STACK)
+        {
+            printf("The script needs too deep a stack\n");
+            ok = false;
+        }
+    }
+
+    if (ok && depth != 1)
+    {
+        printf("The script must leave exactly one value, but leaves %d\n", depth);
+        ok = false;
+    }
+    free(words);
+    if (!ok || !emit(program, OP_HALT, 0, 0))
+    {
+        free(program);
+        return 0;
+    }
+    return program;
+}
+
+/**
+ * @brief Frees a program, and points the given program to NULL.
+ */
+void destroy_program(Program **program)
+{
+    if (!program || !(*program))
+        return;
+
+    free((*program)->threaded);
+    free(*program);
+    (*program) = 0;
+}
+
+/**
+ * Replaces common sequences of instructions by superinstructions, e.g.
+ * `age 30 <` (OP_FIELD, OP_CONST, OP_LT) by a single OP_FIELD_LT_CONST.
+ * Each instruction costs one dispatch (one hard-to-predict indirect jump), so
+ * fewer, bigger instructions run faster. Scripts have no jumps, so instructions
+ * can be merged without fixing any jump targets.
+ */
+void fuse_superinstructions(Program *program)
+{
+    if (!program)
+        return;
+
+    int *code = program->code;
+    int fused[MAX_CODE];
+    int length = 0;
+
+    int i = 0;
+    while (i < program->length)
+    {
+        int next = i + op_lengths[code[i]];
+        int after = (next < program->length) ? next + op_lengths[code[next]] : next;
+
+        if (code[i] == OP_FIELD && after < program->length)
+        {
+            int fused_op = -1;
+            if (code[next] == OP_CONST && (code[after] == OP_LT || code[after] == OP_GT || code[after] == OP_EQ))
+                fused_op = OP_FIELD_LT_CONST + (code[after] - OP_LT);
+            else if (code[next] == OP_FIELD && code[after] == OP_ADD)
+                fused_op = OP_FIELD_ADD_FIELD;
+
+            if (fused_op >= 0)
+            {
+                fused[length++] = fused_op;
+                fused[length++] = code[i + 1];
+                fused[length++] = code[next + 1];
+                i = after + op_lengths[code[after]];
+                continue;
+            }
+        }
+        for (int k = 0; k < op_lengths[code[i]]; k++)
+            fused[length++] = code[i + k];
+        i = next;
+    }
+
+    memcpy(program->code, fused, length * sizeof(int));
+    program->length = length;
+    free(program->threaded); // Made again from the new code on the next run
+    program->threaded = 0;
+}
+
+/**
+ * @brief Prints the instructions of a program.
+ */
+void print_program(const Program *program)
+{
+    static const char *op_names[NUM_OPCODES] = {"FIELD", "CONST", "NAME_EQ", "ADD", "SUB", "MUL", "LT", "GT", "EQ",
+                                                "AND", "OR", "NOT", "HALT", "FIELD_LT_CONST", "FIELD_GT_CONST",
+                                                "FIELD_EQ_CONST", "FIELD_ADD_FIELD"};
+    if (!program)
+        return;
+
+    for (int i = 0; i < program->length; i += op_lengths[program->code[i]])
+    {
+        printf("  %-16s", op_names[program->code[i]]);
+        for (int k = 1; k < op_lengths[program->code[i]]; k++)
+            printf(" %d", program->code[i + k]);
+        printf("\n");
+    }
+}
+
+/**
+ * Runs a program on a record, dispatching with a `switch` on every opcode.
+ * Portable, but every instruction jumps back to the same `switch`, whose single
+ * indirect jump the CPU must predict for ALL instructions.
+ *
+ * @returns The value the program leaves on the stack.
+ */
+long run_switch(const Program *program, const Record *record)
+{
+    long stack[MAX_STACK];
+    long *sp = stack;
+    const int *pc = program->code;
+
+    while (true)
+    {
+        switch (*pc)
+        {
+        case OP_FIELD:
+            *sp++ = record->fields[pc[1]];
+            break;
+        case OP_CONST:
+            *sp++ = pc[1];
+            break;
+        case OP_NAME_EQ:
+            *sp++ = !strcmp(record->name, program->strings[pc[1]]);
+            break;
+        case OP_ADD:
+            sp--;
+            sp[-1] += sp[0];
+            break;
+        case OP_SUB:
+            sp--;
+            sp[-1] -= sp[0];
+            break;
+        case OP_MUL:
+            sp--;
+            sp[-1] *= sp[0];
+            break;
+        case OP_LT:
+            sp--;
+            sp[-1] = sp[-1] < sp[0];
+            break;
+        case OP_GT:
+            sp--;
+            sp[-1] = sp[-1] > sp[0];
+            break;
+        case OP_EQ:
+            sp--;
+            sp[-1] = sp[-1] == sp[0];
+            break;
+        case OP_AND:
+            sp--;
+            sp[-1] = sp[-1] && sp[0];
+            break;
+        case OP_OR:
+            sp--;
+            sp[-1] = sp[-1] || sp[0];
+            break;
+        case OP_NOT:
+            sp[-1] = !sp[-1];
+            break;
+        case OP_HALT:
+            return sp[-1];
+        case OP_FIELD_LT_CONST:
+            *sp++ = record->fields[pc[1]] < pc[2];
+            break;
+        case OP_FIELD_GT_CONST:
+            *sp++ = record->fields[pc[1]] > pc[2];
+            break;
+        case OP_FIELD_EQ_CONST:
+            *sp++ = record->fields[pc[1]] == pc[2];
+            break;
+        case OP_FIELD_ADD_FIELD:
+            *sp++ = (long)record->fields[pc[1]] + record->fields[pc[2]];
+            break;
+        }
+        pc += op_lengths[*pc];
+    }
+}
+
+/**
+ * The state of a running program, for the handler functions below.
+ */
+typedef struct vm
+{
+    const Program *program;
+    const Record *record;
+    const int *pc;
+    long *sp;
+    bool running;
+} Vm;
+
+static void op_field(Vm *vm)
+{
+    *vm->sp++ = vm->record->fields[vm->pc[1]];
+    vm->pc += 2;
+}
+
+static void op_const(Vm *vm)
+{
+    *vm->sp++ = vm->pc[1];
+    vm->pc += 2;
+}
+
+static void op_name_eq(Vm *vm)
+{
+    *vm->sp++ = !strcmp(vm->record->name, vm->program->strings[vm->pc[1]]);
+    vm->pc += 2;
+}
+
+static void op_add(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] += vm->sp[0];
+    vm->pc++;
+}
+
+static void op_sub(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] -= vm->sp[0];
+    vm->pc++;
+}
+
+static void op_mul(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] *= vm->sp[0];
+    vm->pc++;
+}
+
+static void op_lt(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] = vm->sp[-1] < vm->sp[0];
+    vm->pc++;
+}
+
+static void op_gt(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] = vm->sp[-1] > vm->sp[0];
+    vm->pc++;
+}
+
+static void op_eq(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] = vm->sp[-1] == vm->sp[0];
+    vm->pc++;
+}
+
+static void op_and(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] = vm->sp[-1] && vm->sp[0];
+    vm->pc++;
+}
+
+static void op_or(Vm *vm)
+{
+    vm->sp--;
+    vm->sp[-1] = vm->sp[-1] || vm->sp[0];
+    vm->pc++;
+}
+
+static void op_not(Vm *vm)
+{
+    vm->sp[-1] = !vm->sp[-1];
+    vm->pc++;
+}
+
+static void op_halt(Vm *vm)
+{
+    vm->running = false;
+}
+
+static void op_field_lt_const(Vm *vm)
+{
+    *vm->sp++ = vm->record->fields[vm->pc[1]] < vm->pc[2];
+    vm->pc += 3;
+}
+
+static void op_field_gt_const(Vm *vm)
+{
+    *vm->sp++ = vm->record->fields[vm->pc[1]] > vm->pc[2];
+    vm->pc += 3;
+}
+
+static void op_field_eq_const(Vm *vm)
+{
+    *vm->sp++ = vm->record->fields[vm->pc[1]] == vm->pc[2];
+    vm->pc += 3;
+}
+
+static void op_field_add_field(Vm *vm)
+{
+    *vm->sp++ = (long)vm->record->fields[vm->pc[1]] + vm->record->fields[vm->pc[2]];
+    vm->pc += 3;
+}
+
+// Like `functions` in `run_menu`: the handler of opcode i is the ith function
+static void (*handlers[NUM_OPCODES])(Vm *) = {&op_field, &op_const, &op_name_eq, &op_add, &op_sub, &op_mul,
+                                              &op_lt, &op_gt, &op_eq, &op_and, &op_or, &op_not, &op_halt,
+                                              &op_field_lt_const, &op_field_gt_const, &op_field_eq_const,
+                                              &op_field_add_field};
+
+/**
+ * Runs a program on a record, calling the handler of each opcode from the `handlers`
+ * table, the way `run_menu` calls the chosen function from `functions`.
+ *
+ * @returns The value the program leaves on the stack.
+ */
+long run_handlers(const Program *program, const Record *record)
+{
+    long stack[MAX_STACK];
+    Vm vm = {program, record, program->code, stack, true};
+
+    while (vm.running)
+        handlers[*vm.pc](&vm);
+    return vm.sp[-1];
+}
+
+/**
+ * Runs a program on a record with "direct threading": the program is first translated
+ * into `Cell`s, where each opcode is replaced by the address of the code that runs it,
+ * and each instruction ends by jumping straight to the next one's code. Every
+ * instruction has its own indirect jump, which the CPU predicts separately - and
+ * there's no loop or range check in between.
+ * Uses computed goto (`goto *address`) where available, and `run_switch` otherwise.
+ *
+ * @returns The value the program leaves on the stack.
+ */
+long run_threaded(Program *program, const Record *record)
+{
+#if HAVE_COMPUTED_GOTO
+    static const void *labels[NUM_OPCODES] = {&&op_field, &&op_const, &&op_name_eq, &&op_add, &&op_sub, &&op_mul,
+                                              &&op_lt, &&op_gt, &&op_eq, &&op_and, &&op_or, &&op_not, &&op_halt,
+                                              &&op_field_lt_const, &&op_field_gt_const, &&op_field_eq_const,
+                                              &&op_field_add_field};
+    if (!program->threaded)
+    {
+        program->threaded = (Cell *)malloc(program->length * sizeof(Cell));
+        if (!program->threaded)
+            return run_switch(program, record);
+        for (int i = 0; i < program->length; i += op_lengths[program->code[i]])
+        {
+            program->threaded[i].label = labels[program->code[i]];
+            for (int k = 1; k < op_lengths[program->code[i]]; k++)
+                program->threaded[i + k].operand = program->code[i + k];
+        }
+    }
+
+    long stack[MAX_STACK];
+    long *sp = stack;
+    const Cell *pc = program->threaded;
+
+#define DISPATCH(length) \
+    pc += (length);      \
+    goto *pc->label
+
+    goto *pc->label;
+op_field:
+    *sp++ = record->fields[pc[1].operand];
+    DISPATCH(2);
+op_const:
+    *sp++ = pc[1].operand;
+    DISPATCH(2);
+op_name_eq:
+    *sp++ = !strcmp(record->name, program->strings[pc[1].operand]);
+    DISPATCH(2);
+op_add:
+    sp--;
+    sp[-1] += sp[0];
+    DISPATCH(1);
+op_sub:
+    sp--;
+    sp[-1] -= sp[0];
+    DISPATCH(1);
+op_mul:
+    sp--;
+    sp[-1] *= sp[0];
+    DISPATCH(1);
+op_lt:
+    sp--;
+    sp[-1] = sp[-1] < sp[0];
+    DISPATCH(1);
+op_gt:
+    sp--;
+    sp[-1] = sp[-1] > sp[0];
+    DISPATCH(1);
+op_eq:
+    sp--;
+    sp[-1] = sp[-1] == sp[0];
+    DISPATCH(1);
+op_and:
+    sp--;
+    sp[-1] = sp[-1] && sp[0];
+    DISPATCH(1);
+op_or:
+    sp--;
+    sp[-1] = sp[-1] || sp[0];
+    DISPATCH(1);
+op_not:
+    sp[-1] = !sp[-1];
+    DISPATCH(1);
+op_field_lt_const:
+    *sp++ = record->fields[pc[1].operand] < pc[2].operand;
+    DISPATCH(3);
+op_field_gt_const:
+    *sp++ = record->fields[pc[1].operand] > pc[2].operand;
+    DISPATCH(3);
+op_field_eq_const:
+    *sp++ = record->fields[pc[1].operand] == pc[2].operand;
+    DISPATCH(3);
+op_field_add_field:
+    *sp++ = (long)record->fields[pc[1].operand] + record->fields[pc[2].operand];
+    DISPATCH(3);
+op_halt:
+    return sp[-1];
+#undef DISPATCH
+#else
+    return run_switch(program, record);
+#endif
+}
+
+/**
+ * @brief Counts the records for which a program returns a non-zero value.
+ */
+int filter_records(Program *program, const Record *records, int num_records,
+                   long (*run)(Program *, const Record *))
+{
+    if (!program || !records || !run)
+        return 0;
+
+    int count = 0;
+    for (int i = 0; i < num_records; i++)
+        count += run(program, &records[i]) != 0;
+    return count;
+}
+
+static long run_switch_adapter(Program *program, const Record *record)
+{
+    return run_switch(program, record);
+}
+
+static long run_handlers_adapter(Program *program, const Record *record)
+{
+    return run_handlers(program, record);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Times BENCH_PASSES passes of `filter_records` over all the records, and prints
+ *        the time per record and per executed instruction.
+ */
+void bench_dispatch(const char *name, Program *program, const Record *records, int num_records,
+                    long (*run)(Program *, const Record *))
+{
+    int instructions = 0;
+    for (int i = 0; i < program->length; i += op_lengths[program->code[i]])
+        instructions++;
+
+    int matches = 0;
+    double start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        matches = filter_records(program, records, num_records, run);
+    double elapsed = now_seconds() - start;
+
+    double runs = (double)num_records * BENCH_PASSES;
+    printf("  %-28s | %2d instructions | %6.2f ns/record | %5.2f ns/instruction | %d matches\n",
+           name, instructions, elapsed / runs * 1e9, elapsed / (runs * instructions) * 1e9, matches);
+}
+
+int main(void)
+{
+    printf("*********************************BYTECODE INTERPRETER:*********************************\n");
+    // `run_menu` calls a function from an array by its index; a bytecode interpreter
+    // ("virtual machine") does exactly the same, for every instruction of a program.
+    // Here, programs are small filters over records, compiled from a postfix script.
+    // How the interpreter gets from one instruction to the next ("dispatch") is
+    // most of its cost, so we compare three ways of doing it.
+
+    Record people[4] = {{{1, 25, 4000, 1}, "Alice"}, {{2, 41, 9000, 2}, "Bob"},
+                        {{3, 35, 5500, 2}, "Carol"}, {{4, 52, 3000, 3}, "Dave"}};
+    Program *program = compile_script("age 30 > dept 2 = and name:Dave or");
+    if (!program)
+        return 0;
+
+    printf("Program for \"age 30 > dept 2 = and name:Dave or\":\n");
+    print_program(program);
+    for (int i = 0; i < 4; i++)
+        printf("%-6s -> switch: %ld, handlers: %ld, threaded: %ld\n", people[i].name,
+               run_switch(program, &people[i]), run_handlers(program, &people[i]), run_threaded(program, &people[i]));
+
+    fuse_superinstructions(program);
+    printf("With superinstructions:\n");
+    print_program(program);
+    for (int i = 0; i < 4; i++)
+        printf("%-6s -> %ld\n", people[i].name, run_threaded(program, &people[i]));
+    destroy_program(&program);
+
+    Program *invalid = compile_script("age 30 > and");
+    printf("Invalid script compiled to %p\n", (void *)invalid);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    Record *records = (Record *)malloc(BENCH_RECORDS * sizeof(Record));
+    if (!records)
+        return 0;
+
+    srand(time(NULL));
+    const char *names[4] = {"Alice", "Bob", "Carol", "Dave"};
+    for (int i = 0; i < BENCH_RECORDS; i++)
+    {
+        records[i] = (Record){{i, 18 + rand() % 50, 2000 + rand() % 10000, rand() % 5}, ""};
+        strcpy(records[i].name, names[rand() % 4]);
+    }
+
+    const char *script = "age 30 > salary 5000 < and dept 3 = or id 7 * age salary + > not and";
+    printf("%d records x %d passes, script \"%s\"%s:\n", BENCH_RECORDS, BENCH_PASSES, script,
+           HAVE_COMPUTED_GOTO ? "" : " (no computed goto: \"threaded\" runs the switch)");
+
+    program = compile_script(script);
+    if (!program)
+    {
+        free(records);
+        return 0;
+    }
+    bench_dispatch("switch", program, records, BENCH_RECORDS, &run_switch_adapter);
+    bench_dispatch("handler table", program, records, BENCH_RECORDS, &run_handlers_adapter);
+    bench_dispatch("threaded", program, records, BENCH_RECORDS, &run_threaded);
+    fuse_superinstructions(program);
+    bench_dispatch("switch + superinstructions", program, records, BENCH_RECORDS, &run_switch_adapter);
+    bench_dispatch("threaded + superinstructions", program, records, BENCH_RECORDS, &run_threaded);
+
+    destroy_program(&program);
+    free(records);
+    return 0;
+}
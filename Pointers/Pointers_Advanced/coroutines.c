@@ -0,0 +1,776 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+// The context switch is hand-written for x86-64; elsewhere (or with -DCO_USE_UCONTEXT) we use `ucontext`
+#if !defined(__x86_64__) && !defined(CO_USE_UCONTEXT)
+#define CO_USE_UCONTEXT
+#endif
+#include <ucontext.h>
+
+#define CO_STACK_SIZE (16 * 1024)
+#define MAX_EVENTS 64
+#define FD_POLL_EVERY 64 // While coroutines keep yielding, check the fds every this many switches
+#define STACKS_PER_SLAB 256
+#define MAPPINGS_KEPT 4096 // Mappings left for the rest of the program when giving stacks guard pages
+#define MAX_LINE 64
+#define BENCH_SWITCHES 5000000
+#define BENCH_TASKS 100000
+#define BENCH_TASK_YIELDS 10
+
+typedef enum co_state
+{
+    CO_READY,
+    CO_RUNNING,
+    CO_SLEEPING,
+    CO_WAITING_FD,
+    CO_DONE
+} CoState;
+
+/**
+ * The saved registers of a suspended coroutine (or of the scheduler).
+ * With the assembly switch, everything that must be saved is pushed on the
+ * coroutine's own stack, so all we keep is the stack pointer.
+ */
+typedef struct context
+{
+#ifdef CO_USE_UCONTEXT
+    ucontext_t uc;
+#else
+    void *sp;
+#endif
+} Context;
+
+/**
+ * A coroutine: a function with its own stack, which can stop in the middle
+ * (`co_yield`, `co_sleep`, `co_wait_fd`) and later continue where it stopped.
+ *
+ * @param stack The coroutine's mapping: a guard page, then the stack itself
+ * @param mapping_size Size of `stack` in bytes
+ * @param wake_time When a sleeping coroutine should continue (CLOCK_MONOTONIC nanoseconds)
+ * @param events The fd events that woke a coroutine waiting on an fd
+ * @param next Next coroutine in the ready queue
+ */
+typedef struct coroutine
+{
+    Context context;
+    CoState state;
+    void (*func)(void *);
+    void *arg;
+    char *stack;
+    size_t mapping_size;
+    uint64_t wake_time;
+    int events;
+    struct coroutine *next;
+} Coroutine;
+
+/**
+ * The scheduler, which runs the coroutines one at a time, on the thread that calls `co_run`.
+ *
+ * @param context The scheduler's own context, which coroutines switch back to
+ * @param ready_head,ready_tail Queue of coroutines ready to run
+ * @param sleepers Heap of sleeping coroutines, earliest `wake_time` first
+ * @param epoll_fd Where the fds coroutines wait on are registered
+ * @param free_stacks Stacks of finished coroutines, kept for reuse
+ * @param unguarded_stacks Stacks that didn't get a guard page (see `allocate_stack`)
+ */
+typedef struct scheduler
+{
+    Context context;
+    Coroutine *current;
+    Coroutine *ready_head;
+    Coroutine *ready_tail;
+    Coroutine **sleepers;
+    int num_sleepers;
+    int sleepers_capacity;
+    int num_waiting_fd;
+    int epoll_fd;
+    int live;
+    char *free_stacks;
+    long unguarded_stacks;
+} Scheduler;
+
+static Scheduler sched = {.epoll_fd = -1};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void coroutine_entry(void);
+
+#ifdef CO_USE_UCONTEXT
+static void context_switch(Context *from, Context *to)
+{
+    swapcontext(&from->uc, &to->uc);
+}
+
+static bool context_init(Context *context, char *stack, size_t size)
+{
+    if (getcontext(&context->uc) < 0)
+        return false;
+    context->uc.uc_stack.ss_sp = stack;
+    context->uc.uc_stack.ss_size = size;
+    context->uc.uc_link = 0;
+    makecontext(&context->uc, &coroutine_entry, 0);
+    return true;
+}
+#else
+/*
+ * void co_switch(void **from_sp, void *to_sp)
+ * Pushes the registers a function must preserve (System V ABI) on the current stack,
+ * saves the stack pointer in *from_sp, moves to `to_sp` and pops that stack's registers.
+ * The final `ret` continues wherever the other stack was switched away from.
+ * (`swapcontext` does the same, but also saves the signal mask - a system call each time.)
+ */
+void co_switch(void **from_sp, void *to_sp);
+__asm__(
+    ".text\n"
+    ".globl co_switch\n"
+    ".type co_switch, @function\n"
+    "co_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size co_switch, .-co_switch\n");
+
+static void context_switch(Context *from, Context *to)
+{
+    co_switch(&from->sp, to->sp);
+}
+
+/**
+ * @brief Prepares a new stack so that the first switch to it "returns" into `coroutine_entry`.
+ */
+static bool context_init(Context *context, char *stack, size_t size)
+{
+    uintptr_t top = ((uintptr_t)(stack + size)) & ~(uintptr_t)15;
+    void **sp = (void **)top;
+
+    *(--sp) = 0;                         // Fake return address of `coroutine_entry`, which never returns
+    *(--sp) = (void *)&coroutine_entry;  // Popped by the `ret` of `co_switch`
+    for (int i = 0; i < 6; i++)
+        *(--sp) = 0;                     // rbp, rbx, r12-r15
+    context->sp = sp;
+    return true;
+}
+#endif
+
+/**
+ * @brief Returns how many stacks may still get a guard page, from the kernel's limit on the
+ *        number of mappings (vm.max_map_count), keeping some mappings for the rest of the program.
+ */
+static long guard_page_budget(void)
+{
+    long max_map_count = 65530;
+    FILE *file = fopen("/proc/sys/vm/max_map_count", "r");
+    if (file)
+    {
+        if (fscanf(file, "%ld", &max_map_count) != 1)
+            max_map_count = 65530;
+        fclose(file);
+    }
+    return (max_map_count - MAPPINGS_KEPT) / 2;
+}
+
+/**
+ * Gets a stack for a coroutine: a mapping of a page followed by the stack itself.
+ * Normally the first page is a "guard page": the stack grows down, so a coroutine that
+ * overflows its stack hits the guard page and crashes right away, instead of quietly
+ * overwriting whatever memory lies below.
+ * Every guard page splits its mapping in two, and the kernel limits the number of mappings
+ * a process may have (vm.max_map_count, usually 65530). Once that budget runs out, stacks
+ * are cut from big shared mappings without guard pages, and counted in `sched.unguarded_stacks`.
+ * Stacks of finished coroutines are kept for reuse rather than unmapped.
+ *
+ * @returns The mapping, or NULL on error.
+ */
+static char *allocate_stack(size_t *mapping_size)
+{
+    static long budget = -1;
+    static char *slab = 0;
+    static int slab_left = 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *mapping_size = page + ((CO_STACK_SIZE + page - 1) & ~(page - 1));
+
+    if (sched.free_stacks)
+    {
+        char *stack = sched.free_stacks;
+        sched.free_stacks = *(char **)(stack + page);
+        return stack;
+    }
+
+    if (budget < 0)
+        budget = guard_page_budget();
+    if (budget > 0)
+    {
+        char *mapping = (char *)mmap(0, *mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapping == MAP_FAILED)
+            return 0;
+        budget--;
+        if (mprotect(mapping, page, PROT_NONE) < 0)
+            sched.unguarded_stacks++;
+        return mapping;
+    }
+
+    if (!slab_left)
+    {
+        slab = (char *)mmap(0, *mapping_size * STACKS_PER_SLAB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (slab == MAP_FAILED)
+            return 0;
+        slab_left = STACKS_PER_SLAB;
+    }
+    sched.unguarded_stacks++;
+    slab_left--;
+    return slab + slab_left * *mapping_size;
+}
+
+/**
+ * @brief Keeps a stack for reuse, in a list linked through the lowest word above each guard page.
+ */
+static void release_stack(char *stack)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *(char **)(stack + page) = sched.free_stacks;
+    sched.free_stacks = stack;
+}
+
+static void enqueue_ready(Coroutine *co)
+{
+    co->state = CO_READY;
+    co->next = 0;
+    if (sched.ready_tail)
+        sched.ready_tail->next = co;
+    else
+        sched.ready_head = co;
+    sched.ready_tail = co;
+}
+
+/**
+ * Creates a coroutine which will run `func(arg)`. It starts running once `co_run` is called
+ * (or, if called from a coroutine, once that coroutine stops).
+ *
+ * @returns The new coroutine, or NULL on error.
+ */
+Coroutine *co_spawn(void (*func)(void *), void *arg)
+{
+    if (!func)
+        return 0;
+
+    Coroutine *co = (Coroutine *)calloc(1, sizeof(Coroutine));
+    if (!co)
+        return 0;
+
+    co->stack = allocate_stack(&co->mapping_size);
+    if (!co->stack || !context_init(&co->context, co->stack, co->mapping_size))
+    {
+        if (co->stack)
+            release_stack(co->stack);
+        free(co);
+        return 0;
+    }
+    co->func = func;
+    co->arg = arg;
+    sched.live++;
+    enqueue_ready(co);
+    return co;
+}
+
+static void run_callback(void *arg)
+{
+    void (**func)() = (void (**)())arg;
+    (*func)();
+    free(func);
+}
+
+/**
+ * @brief Runs an existing `void (*)()` callback (e.g. from function_pointers_callback.c) as a coroutine.
+ *
+ * @returns The new coroutine, or NULL on error.
+ */
+Coroutine *co_spawn_callback(void (*func)())
+{
+    if (!func)
+        return 0;
+
+    void (**copy)() = (void (**)())malloc(sizeof(func));
+    if (!copy)
+        return 0;
+    *copy = func;
+
+    Coroutine *co = co_spawn(&run_callback, copy);
+    if (!co)
+        free(copy);
+    return co;
+}
+
+/**
+ * @brief Where every coroutine starts: runs its function, and then goes back to the scheduler for good.
+ */
+static void coroutine_entry(void)
+{
+    Coroutine *co = sched.current;
+    co->func(co->arg);
+    co->state = CO_DONE;
+    context_switch(&co->context, &sched.context);
+}
+
+/**
+ * @brief Stops the current coroutine and lets the others run; it continues after
+ *        every coroutine that was ready before it had its turn.
+ */
+void co_yield(void)
+{
+    Coroutine *co = sched.current;
+    if (!co)
+        return;
+
+    enqueue_ready(co);
+    context_switch(&co->context, &sched.context);
+}
+
+static void sleepers_swap(int a, int b)
+{
+    Coroutine *temp = sched.sleepers[a];
+    sched.sleepers[a] = sched.sleepers[b];
+    sched.sleepers[b] = temp;
+}
+
+static Coroutine *pop_sleeper(void)
+{
+    Coroutine *earliest = sched.sleepers[0];
+    sched.sleepers[0] = sched.sleepers[--sched.num_sleepers];
+
+    int index = 0;
+    while (true)
+    {
+        int smallest = index, left = 2 * index + 1, right = left + 1;
+        if (left < sched.num_sleepers && sched.sleepers[left]->wake_time < sched.sleepers[smallest]->wake_time)
+            smallest = left;
+        if (right < sched.num_sleepers && sched.sleepers[right]->wake_time < sched.sleepers[smallest]->wake_time)
+            smallest = right;
+        if (smallest == index)
+            return earliest;
+        sleepers_swap(index, smallest);
+        index = smallest;
+    }
+}
+
+/**
+ * @brief Suspends the current coroutine for (at least) `msecs` milliseconds,
+ *        while the other coroutines keep running. Unlike `sleep`, nothing blocks.
+ */
+void co_sleep(int msecs)
+{
+    Coroutine *co = sched.current;
+    if (!co)
+        return;
+
+    if (sched.num_sleepers == sched.sleepers_capacity)
+    {
+        int capacity = sched.sleepers_capacity ? 2 * sched.sleepers_capacity : 64;
+        Coroutine **sleepers = (Coroutine **)realloc(sched.sleepers, capacity * sizeof(Coroutine *));
+        if (!sleepers)
+        {
+            co_yield(); // Can't sleep; at least let the others run
+            return;
+        }
+        sched.sleepers = sleepers;
+        sched.sleepers_capacity = capacity;
+    }
+
+    co->wake_time = now_ns() + (uint64_t)(msecs > 0 ? msecs : 0) * 1000000ull;
+    co->state = CO_SLEEPING;
+    int index = sched.num_sleepers++;
+    sched.sleepers[index] = co;
+    while (index > 0 && sched.sleepers[(index - 1) / 2]->wake_time > co->wake_time)
+    {
+        sleepers_swap(index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+    context_switch(&co->context, &sched.context);
+}
+
+/**
+ * Suspends the current coroutine until an fd is ready.
+ *
+ * @param events The events to wait for, e.g. EPOLLIN
+ *
+ * @returns The events that happened (regular files, which are always ready, return `events`
+ *          right away), or 0 on error.
+ */
+int co_wait_fd(int fd, int events)
+{
+    Coroutine *co = sched.current;
+    if (!co)
+        return 0;
+
+    if (sched.epoll_fd < 0 && (sched.epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        return 0;
+
+    struct epoll_event event = {(uint32_t)events | EPOLLONESHOT, {.ptr = co}};
+    if (epoll_ctl(sched.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+        return errno == EPERM ? events : 0;
+
+    co->state = CO_WAITING_FD;
+    sched.num_waiting_fd++;
+    context_switch(&co->context, &sched.context);
+
+    epoll_ctl(sched.epoll_fd, EPOLL_CTL_DEL, fd, 0);
+    return co->events;
+}
+
+/**
+ * Reads a line from an fd inside a coroutine: while there's no input, the other
+ * coroutines run. The newline is not stored.
+ *
+ * @returns The length of the line, or -1 at end of file (with no line) or on error.
+ */
+int co_read_line(int fd, char *buffer, int size)
+{
+    if (!buffer || size <= 0)
+        return -1;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return -1;
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    // One byte at a time, so we never take input that belongs to the next reader
+    int length = 0;
+    bool eof = false;
+    while (length < size - 1)
+    {
+        char c;
+        ssize_t count = read(fd, &c, 1);
+        if (count < 0 && errno == EAGAIN)
+        {
+            if (!co_wait_fd(fd, EPOLLIN))
+                break;
+            continue;
+        }
+        if (count <= 0)
+        {
+            eof = true;
+            break;
+        }
+        if (c == '\n')
+            break;
+        buffer[length++] = c;
+    }
+
+    fcntl(fd, F_SETFL, flags);
+    buffer[length] = '\0';
+    return (eof && !length) ? -1 : length;
+}
+
+static void free_coroutine(Coroutine *co)
+{
+    release_stack(co->stack);
+    free(co);
+    sched.live--;
+}
+
+/**
+ * @brief Waits until a sleeping coroutine's time comes or a waited-for fd is ready,
+ *        and makes those coroutines ready.
+ */
+static void wait_for_events(void)
+{
+    int timeout = -1;
+    if (sched.ready_head)
+        timeout = 0;
+    else if (sched.num_sleepers)
+    {
+        uint64_t now = now_ns(), wake = sched.sleepers[0]->wake_time;
+        timeout = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+    }
+
+    if (sched.num_waiting_fd)
+    {
+        struct epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(sched.epoll_fd, events, MAX_EVENTS, timeout);
+        for (int i = 0; i < count; i++)
+        {
+            Coroutine *co = (Coroutine *)events[i].data.ptr;
+            co->events = events[i].events;
+            sched.num_waiting_fd--;
+            enqueue_ready(co);
+        }
+    }
+    else if (timeout > 0)
+    {
+        struct timespec pause = {timeout / 1000, (timeout % 1000) * 1000000L};
+        nanosleep(&pause, 0);
+    }
+
+    uint64_t now = now_ns();
+    while (sched.num_sleepers && sched.sleepers[0]->wake_time <= now)
+        enqueue_ready(pop_sleeper());
+}
+
+/**
+ * Runs coroutines until all of them are done.
+ * Must be called from the main program (not from a coroutine).
+ */
+void co_run(void)
+{
+    if (sched.current)
+        return;
+
+    long switches = 0;
+    while (sched.live > 0)
+    {
+        if (!sched.ready_head)
+        {
+            if (!sched.num_sleepers && !sched.num_waiting_fd)
+                break; // Nothing can ever become ready
+            wait_for_events();
+            continue;
+        }
+
+        Coroutine *co = sched.ready_head;
+        sched.ready_head = co->next;
+        if (!sched.ready_head)
+            sched.ready_tail = 0;
+
+        co->state = CO_RUNNING;
+        sched.current = co;
+        context_switch(&sched.context, &co->context);
+        sched.current = 0;
+
+        if (co->state == CO_DONE)
+            free_coroutine(co);
+
+        // Let sleepers and fds in even while coroutines keep yielding
+        if ((sched.num_waiting_fd && ++switches % FD_POLL_EVERY == 0) ||
+            (sched.num_sleepers && sched.sleepers[0]->wake_time <= now_ns()))
+            wait_for_events();
+    }
+}
+
+typedef enum type
+{
+    INT,
+    FLOAT,
+    STRING
+} Type;
+
+const char *type_names[3] = {"int", "float", "string"};
+
+/**
+ * @brief `input_vars` from function_pointer_arrays.c, for ints, as a coroutine:
+ *        waiting for the user doesn't stop the other coroutines.
+ */
+void input_vars_task(void *arg)
+{
+    Type type = *(Type *)arg;
+    char line[MAX_LINE];
+
+    printf("Enter two %ss: ", type_names[type]);
+    fflush(stdout);
+    if (co_read_line(STDIN_FILENO, line, MAX_LINE) < 0)
+    {
+        printf("\n(no input)\n");
+        return;
+    }
+
+    int a, b;
+    if (sscanf(line, "%d %d", &a, &b) != 2)
+    {
+        printf("Invalid input \"%s\"\n", line);
+        return;
+    }
+    printf("%d %s %d holds.\n", a, a > b ? ">" : a < b ? "<" : "=", b);
+}
+
+void callback_1()
+{
+    printf("\n[coroutine] This callback function prints this message\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief `sleep_and_callback` from function_pointers_callback.c, as a coroutine.
+ */
+void sleep_and_callback_task(void *arg)
+{
+    co_sleep(*(int *)arg);
+    callback_1();
+}
+
+void ticker_task(void *arg)
+{
+    int ticks = *(int *)arg;
+    for (int i = 1; i <= ticks; i++)
+    {
+        co_sleep(700);
+        printf("\n[coroutine] tick %d\n", i);
+        fflush(stdout);
+    }
+}
+
+static double now_seconds(void)
+{
+    return now_ns() / 1e9;
+}
+
+static void ping_pong_task(void *arg)
+{
+    long *count = (long *)arg;
+    for (long i = 0; i < BENCH_SWITCHES; i++)
+    {
+        (*count)++;
+        co_yield();
+    }
+}
+
+/**
+ * @brief Returns the memory the process actually uses (resident set size), in bytes.
+ */
+static long resident_bytes(void)
+{
+    long pages_total = 0, pages_resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    if (fscanf(statm, "%ld %ld", &pages_total, &pages_resident) != 2)
+        pages_resident = 0;
+    fclose(statm);
+    return pages_resident * sysconf(_SC_PAGESIZE);
+}
+
+static long resident_at_peak = 0;
+
+static void measure_memory_task(void *arg)
+{
+    (void)arg;
+    resident_at_peak = resident_bytes();
+}
+
+static void many_yields_task(void *arg)
+{
+    long *count = (long *)arg;
+    for (int i = 0; i < BENCH_TASK_YIELDS; i++)
+    {
+        (*count)++;
+        co_yield();
+    }
+}
+
+#ifdef CO_USE_UCONTEXT
+#define BACKEND_NAME "ucontext"
+#else
+#define BACKEND_NAME "assembly"
+
+static ucontext_t uc_main, uc_task;
+
+static void ucontext_task(void)
+{
+    while (true)
+        swapcontext(&uc_task, &uc_main);
+}
+
+/**
+ * @brief Measures a raw `swapcontext` round trip, for comparison with `co_switch`.
+ */
+static double bench_swapcontext(void)
+{
+    static char stack[CO_STACK_SIZE];
+    getcontext(&uc_task);
+    uc_task.uc_stack.ss_sp = stack;
+    uc_task.uc_stack.ss_size = sizeof(stack);
+    uc_task.uc_link = 0;
+    makecontext(&uc_task, &ucontext_task, 0);
+
+    double start = now_seconds();
+    for (long i = 0; i < BENCH_SWITCHES; i++)
+        swapcontext(&uc_main, &uc_task);
+    return (now_seconds() - start) / (2.0 * BENCH_SWITCHES);
+}
+#endif
+
+int main(void)
+{
+    printf("*********************************COROUTINES:*********************************\n");
+    // A coroutine is a function that can stop in the middle and continue later, with
+    // its own small stack. Instead of blocking in `scanf` or `sleep`, it tells the
+    // scheduler what it's waiting for and switches to another coroutine - all on a
+    // single thread, with no locks. Here a menu handler waits for input while a
+    // callback and a ticker keep running.
+    printf("Context switch: %s\n", BACKEND_NAME);
+
+    Type type = INT;
+    int delay = 500, ticks = 3;
+    co_spawn(&input_vars_task, &type);
+    co_spawn(&sleep_and_callback_task, &delay);
+    co_spawn(&ticker_task, &ticks);
+    co_spawn_callback(&callback_1);
+    co_run();
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    long count = 0;
+    co_spawn(&ping_pong_task, &count);
+    co_spawn(&ping_pong_task, &count);
+    double start = now_seconds();
+    co_run();
+    double elapsed = now_seconds() - start;
+    // Every yield is two switches: to the scheduler, and from it to the next coroutine
+    printf("2 coroutines, %ld yields: %.1f ns per context switch (%s)\n", count, elapsed / (2.0 * count) * 1e9, BACKEND_NAME);
+#ifndef CO_USE_UCONTEXT
+    printf("Raw swapcontext for comparison: %.1f ns per context switch\n", bench_swapcontext() * 1e9);
+#endif
+
+    count = 0;
+    long resident_before = resident_bytes();
+    long virtual_per_task = 0;
+    start = now_seconds();
+    int spawned = 0;
+    for (; spawned < BENCH_TASKS; spawned++)
+    {
+        Coroutine *co = co_spawn(&many_yields_task, &count);
+        if (!co)
+            break;
+        virtual_per_task = (long)(co->mapping_size + sizeof(Coroutine));
+    }
+    double spawn_time = now_seconds() - start;
+    // Runs after every task has run once (and so used its stack), as coroutines run in order
+    co_spawn(&measure_memory_task, 0);
+
+    start = now_seconds();
+    co_run();
+    elapsed = now_seconds() - start;
+    long resident_per_task = spawned ? (resident_at_peak - resident_before) / spawned : 0;
+
+    printf("%d concurrent coroutines (%ld without a guard page): spawned in %.3f s, %ld yields in %.3f s (%.1f ns per yield)\n",
+           spawned, sched.unguarded_stacks, spawn_time, count, elapsed, elapsed / count * 1e9);
+    printf("Memory per coroutine: %ld bytes reserved, %ld bytes resident (a thread reserves 8 MB of stack by default)\n",
+           virtual_per_task, resident_per_task);
+
+    if (sched.epoll_fd >= 0)
+        close(sched.epoll_fd);
+    free(sched.sleepers);
+    return 0;
+}
@@ -0,0 +1,802 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define MAX_FDS 1024
+#define MAX_EVENTS 64
+#define LINE_BUFF_SIZE 4096
+#define BENCH_TIMERS 20000
+#define BENCH_TIMER_SPREAD_MS 200
+#define BENCH_STREAMS 64
+#define BENCH_LINES_PER_STREAM 5000
+
+typedef struct event_loop EventLoop;
+
+// A callback run by the loop - queued with `loop_post`, or when a timer expires
+typedef void (*Callback)(EventLoop *loop, void *arg);
+
+// Called for every line read from a watched fd, and once with `line` == NULL at end of file
+typedef void (*LineCallback)(EventLoop *loop, int fd, const char *line, void *arg);
+
+/**
+ * A timer, kept in the loop's heap of timers.
+ *
+ * @param deadline When the timer expires (CLOCK_MONOTONIC nanoseconds)
+ * @param interval If not 0, the timer is started again this many nanoseconds after it expires
+ * @param id The timer's id, for `loop_cancel_timer`
+ */
+typedef struct timer
+{
+    uint64_t deadline;
+    uint64_t interval;
+    int id;
+    Callback callback;
+    void *arg;
+} Timer;
+
+/**
+ * An fd watched by the loop, and the data read from it that isn't a complete line yet.
+ *
+ * @param old_flags The fd's flags before it was made non-blocking, restored when it's unwatched
+ * @param polled `false` if epoll can't watch the fd (a regular file - which is always readable)
+ */
+typedef struct watcher
+{
+    int fd;
+    int old_flags;
+    bool polled;
+    LineCallback on_line;
+    void *arg;
+    int length;
+    char buffer[LINE_BUFF_SIZE];
+} Watcher;
+
+typedef struct posted
+{
+    Callback callback;
+    void *arg;
+} Posted;
+
+/**
+ * A single-threaded event loop: waits (with epoll) until one of the watched fds has
+ * input or the earliest timer expires, and then runs the callbacks for what happened.
+ * Nothing blocks, so input and scheduled work are handled side by side.
+ *
+ * @param epoll_fd The epoll instance all fds are registered in
+ * @param timer_fd A timerfd, always set to expire with the earliest timer
+ * @param timers Heap of the timers, earliest deadline first
+ * @param watchers The watched fds, indexed by fd
+ * @param queue Callbacks posted with `loop_post`, in a circular array
+ */
+struct event_loop
+{
+    int epoll_fd;
+    int timer_fd;
+    Timer *timers;
+    int num_timers;
+    int timers_capacity;
+    int next_timer_id;
+    Watcher *watchers[MAX_FDS];
+    int num_watchers;
+    Posted *queue;
+    int queue_head;
+    int queue_length;
+    int queue_capacity;
+    bool stopped;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Creates an event loop.
+ *
+ * @returns A new event loop, or NULL on error.
+ */
+EventLoop *create_event_loop(void)
+{
+    EventLoop *loop = (EventLoop *)calloc(1, sizeof(EventLoop));
+    if (!loop)
+        return 0;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event event = {EPOLLIN, {.fd = loop->timer_fd}};
+    if (loop->epoll_fd < 0 || loop->timer_fd < 0 ||
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &event) < 0)
+    {
+        if (loop->epoll_fd >= 0)
+            close(loop->epoll_fd);
+        if (loop->timer_fd >= 0)
+            close(loop->timer_fd);
+        free(loop);
+        return 0;
+    }
+    return loop;
+}
+
+/**
+ * @brief Adds a callback to the loop's queue; it runs on the loop's next iteration.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool loop_post(EventLoop *loop, Callback callback, void *arg)
+{
+    if (!loop || !callback)
+        return false;
+
+    if (loop->queue_length == loop->queue_capacity)
+    {
+        int capacity = loop->queue_capacity ? 2 * loop->queue_capacity : 16;
+        Posted *queue = (Posted *)malloc(capacity * sizeof(Posted));
+        if (!queue)
+            return false;
+        for (int i = 0; i < loop->queue_length; i++)
+            queue[i] = loop->queue[(loop->queue_head + i) % loop->queue_capacity];
+        free(loop->queue);
+        loop->queue = queue;
+        loop->queue_head = 0;
+        loop->queue_capacity = capacity;
+    }
+
+    loop->queue[(loop->queue_head + loop->queue_length) % loop->queue_capacity] = (Posted){callback, arg};
+    loop->queue_length++;
+    return true;
+}
+
+/**
+ * @brief Sets the timerfd to expire with the earliest timer (or disarms it if there are no timers).
+ */
+static void arm_timer_fd(EventLoop *loop)
+{
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+    if (loop->num_timers)
+    {
+        uint64_t deadline = loop->timers[0].deadline;
+        spec.it_value.tv_sec = deadline / 1000000000ull;
+        spec.it_value.tv_nsec = deadline % 1000000000ull;
+        // A zero it_value would disarm the timer
+        if (!spec.it_value.tv_sec && !spec.it_value.tv_nsec)
+            spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, 0);
+}
+
+static void swap_timers(Timer *a, Timer *b)
+{
+    Timer temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+static void timer_sift_up(EventLoop *loop, int index)
+{
+    while (index > 0 && loop->timers[(index - 1) / 2].deadline > loop->timers[index].deadline)
+    {
+        swap_timers(&loop->timers[index], &loop->timers[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+}
+
+static void timer_sift_down(EventLoop *loop, int index)
+{
+    while (true)
+    {
+        int earliest = index, left = 2 * index + 1, right = left + 1;
+        if (left < loop->num_timers && loop->timers[left].deadline < loop->timers[earliest].deadline)
+            earliest = left;
+        if (right < loop->num_timers && loop->timers[right].deadline < loop->timers[earliest].deadline)
+            earliest = right;
+        if (earliest == index)
+            return;
+        swap_timers(&loop->timers[index], &loop->timers[earliest]);
+        index = earliest;
+    }
+}
+
+static bool push_timer(EventLoop *loop, Timer timer)
+{
+    if (loop->num_timers == loop->timers_capacity)
+    {
+        int capacity = loop->timers_capacity ? 2 * loop->timers_capacity : 16;
+        Timer *timers = (Timer *)realloc(loop->timers, capacity * sizeof(Timer));
+        if (!timers)
+            return false;
+        loop->timers = timers;
+        loop->timers_capacity = capacity;
+    }
+
+    loop->timers[loop->num_timers++] = timer;
+    timer_sift_up(loop, loop->num_timers - 1);
+    return true;
+}
+
+static void remove_timer_at(EventLoop *loop, int index)
+{
+    loop->timers[index] = loop->timers[--loop->num_timers];
+    if (index < loop->num_timers)
+    {
+        timer_sift_up(loop, index);
+        timer_sift_down(loop, index);
+    }
+}
+
+/**
+ * Starts a timer.
+ *
+ * @param msecs Milliseconds until the timer expires
+ * @param repeat_msecs If not 0, the timer keeps expiring every `repeat_msecs` milliseconds
+ *                     until it's cancelled
+ * @param callback Called when the timer expires
+ *
+ * @returns The timer's id, or -1 on error.
+ */
+int loop_add_timer(EventLoop *loop, int msecs, int repeat_msecs, Callback callback, void *arg)
+{
+    if (!loop || !callback || msecs < 0 || repeat_msecs < 0)
+        return -1;
+
+    Timer timer = {now_ns() + (uint64_t)msecs * 1000000ull, (uint64_t)repeat_msecs * 1000000ull,
+                   loop->next_timer_id, callback, arg};
+    if (!push_timer(loop, timer))
+        return -1;
+
+    loop->next_timer_id++;
+    if (loop->timers[0].id == timer.id)
+        arm_timer_fd(loop);
+    return timer.id;
+}
+
+/**
+ * @brief Cancels a timer, if it hasn't expired yet (or if it repeats).
+ */
+void loop_cancel_timer(EventLoop *loop, int id)
+{
+    if (!loop)
+        return;
+
+    for (int i = 0; i < loop->num_timers; i++)
+    {
+        if (loop->timers[i].id == id)
+        {
+            remove_timer_at(loop, i);
+            if (i == 0)
+                arm_timer_fd(loop);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Runs the callbacks of all the timers that expired, and sets the timerfd for the next one.
+ */
+static void run_timers(EventLoop *loop)
+{
+    uint64_t expirations;
+    if (read(loop->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return;
+
+    uint64_t now = now_ns();
+    while (loop->num_timers && loop->timers[0].deadline <= now && !loop->stopped)
+    {
+        Timer timer = loop->timers[0];
+        remove_timer_at(loop, 0);
+        if (timer.interval)
+        {
+            timer.deadline += timer.interval;
+            push_timer(loop, timer);
+        }
+        timer.callback(loop, timer.arg);
+    }
+    arm_timer_fd(loop);
+}
+
+/**
+ * @brief Stops watching an fd, and restores its flags. The fd isn't closed.
+ */
+void loop_unwatch_fd(EventLoop *loop, int fd)
+{
+    if (!loop || fd < 0 || fd >= MAX_FDS || !loop->watchers[fd])
+        return;
+
+    Watcher *watcher = loop->watchers[fd];
+    if (watcher->polled)
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, 0);
+    fcntl(fd, F_SETFL, watcher->old_flags);
+    free(watcher);
+    loop->watchers[fd] = 0;
+    loop->num_watchers--;
+}
+
+/**
+ * Reads everything available from a watched fd, without blocking, and calls the
+ * watcher's callback for each complete line. A line longer than LINE_BUFF_SIZE
+ * is passed on in parts.
+ */
+static void read_watcher(EventLoop *loop, int fd)
+{
+    Watcher *watcher = loop->watchers[fd];
+    while (watcher)
+    {
+        ssize_t count = read(fd, watcher->buffer + watcher->length, LINE_BUFF_SIZE - 1 - watcher->length);
+        if (count < 0)
+            return; // EAGAIN: nothing more for now
+
+        watcher->length += count;
+        char *start = watcher->buffer, *end = watcher->buffer + watcher->length;
+        char *newline;
+        while (watcher && (newline = memchr(start, '\n', end - start)))
+        {
+            *newline = '\0';
+            watcher->on_line(loop, fd, start, watcher->arg);
+            start = newline + 1;
+            watcher = loop->watchers[fd]; // The callback may have unwatched the fd
+        }
+        if (!watcher)
+            return;
+
+        watcher->length = end - start;
+        memmove(watcher->buffer, start, watcher->length);
+        if (count == 0 || watcher->length == LINE_BUFF_SIZE - 1)
+        {
+            // End of file, or a line too long for the buffer: pass on what we have
+            if (watcher->length)
+            {
+                watcher->buffer[watcher->length] = '\0';
+                watcher->length = 0;
+                watcher->on_line(loop, fd, watcher->buffer, watcher->arg);
+                watcher = loop->watchers[fd];
+            }
+            if (count == 0 && watcher)
+            {
+                LineCallback on_line = watcher->on_line;
+                void *arg = watcher->arg;
+                loop_unwatch_fd(loop, fd);
+                on_line(loop, fd, 0, arg);
+                return;
+            }
+        }
+    }
+}
+
+static void read_unpolled(EventLoop *loop, void *arg)
+{
+    read_watcher(loop, (int)(intptr_t)arg);
+}
+
+/**
+ * Starts watching an fd for input: the fd is made non-blocking, and `on_line` is called
+ * for every line read from it, and once with NULL when it reaches end of file (after
+ * which the fd is no longer watched).
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool loop_watch_fd(EventLoop *loop, int fd, LineCallback on_line, void *arg)
+{
+    if (!loop || !on_line || fd < 0 || fd >= MAX_FDS || loop->watchers[fd])
+        return false;
+
+    Watcher *watcher = (Watcher *)malloc(sizeof(Watcher));
+    if (!watcher)
+        return false;
+
+    watcher->fd = fd;
+    watcher->old_flags = fcntl(fd, F_GETFL);
+    watcher->on_line = on_line;
+    watcher->arg = arg;
+    watcher->length = 0;
+    watcher->polled = true;
+    if (watcher->old_flags < 0 || fcntl(fd, F_SETFL, watcher->old_flags | O_NONBLOCK) < 0)
+    {
+        free(watcher);
+        return false;
+    }
+
+    struct epoll_event event = {EPOLLIN, {.fd = fd}};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        // Regular files (e.g. stdin redirected from a file) can't be polled, but are always
+        // ready, so we just read them on the next iteration
+        if (errno != EPERM || !loop_post(loop, &read_unpolled, (void *)(intptr_t)fd))
+        {
+            fcntl(fd, F_SETFL, watcher->old_flags);
+            free(watcher);
+            return false;
+        }
+        watcher->polled = false;
+    }
+
+    loop->watchers[fd] = watcher;
+    loop->num_watchers++;
+    return true;
+}
+
+/**
+ * @brief Makes `loop_run` return after the current callback.
+ */
+void loop_stop(EventLoop *loop)
+{
+    if (loop)
+        loop->stopped = true;
+}
+
+/**
+ * Runs the loop, until `loop_stop` is called or there's nothing left to wait for
+ * (no watched fds, timers or posted callbacks).
+ */
+void loop_run(EventLoop *loop)
+{
+    if (!loop)
+        return;
+
+    loop->stopped = false;
+    struct epoll_event events[MAX_EVENTS];
+    while (!loop->stopped && (loop->num_watchers || loop->num_timers || loop->queue_length))
+    {
+        // Don't wait if callbacks are already queued
+        int count = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, loop->queue_length ? 0 : -1);
+        for (int i = 0; i < count && !loop->stopped; i++)
+        {
+            if (events[i].data.fd == loop->timer_fd)
+                run_timers(loop);
+            else
+                read_watcher(loop, events[i].data.fd);
+        }
+
+        // Only the callbacks queued so far: callbacks that post callbacks can't starve the fds
+        for (int queued = loop->queue_length; queued > 0 && !loop->stopped; queued--)
+        {
+            Posted posted = loop->queue[loop->queue_head];
+            loop->queue_head = (loop->queue_head + 1) % loop->queue_capacity;
+            loop->queue_length--;
+            posted.callback(loop, posted.arg);
+        }
+    }
+}
+
+/**
+ * @brief Frees an event loop (unwatching all its fds), and points the given loop to NULL.
+ */
+void destroy_event_loop(EventLoop **loop)
+{
+    if (!loop || !(*loop))
+        return;
+
+    for (int fd = 0; fd < MAX_FDS; fd++)
+        loop_unwatch_fd(*loop, fd);
+    close((*loop)->epoll_fd);
+    close((*loop)->timer_fd);
+    free((*loop)->timers);
+    free((*loop)->queue);
+    free(*loop);
+    (*loop) = 0;
+}
+
+/**
+ * A menu, as run by `run_menu` in function_pointer_arrays.c.
+ */
+typedef struct menu
+{
+    const char *title;
+    const char **choice_text;
+    void (**functions)();
+    int num_choices;
+    bool persistent;
+} Menu;
+
+static void print_menu(const Menu *menu)
+{
+    if (!menu->title || !strcmp("", menu->title))
+        printf("Select an option:\n");
+    else
+        printf("%s\n", menu->title);
+
+    for (int i = 0; i < menu->num_choices; i++)
+        printf("%d. %s\n", (i + 1), menu->choice_text[i]);
+    if (menu->persistent)
+        printf("%d. Quit\n", (menu->num_choices + 1));
+
+    printf("Enter your choice: ");
+    fflush(stdout);
+}
+
+static void on_menu_line(EventLoop *loop, int fd, const char *line, void *arg)
+{
+    Menu *menu = (Menu *)arg;
+    int choice = 0;
+
+    if (!line)
+    {
+        printf("\n");
+        return; // End of input; the loop already stopped watching `fd`
+    }
+    if (sscanf(line, "%d", &choice) != 1 ||
+        !(choice >= 1 && choice <= menu->num_choices + (menu->persistent ? 1 : 0)))
+    {
+        printf("\nPlease select a valid choice\n\n");
+        print_menu(menu);
+        return;
+    }
+
+    if (choice == menu->num_choices + 1)
+    {
+        loop_unwatch_fd(loop, fd);
+        return;
+    }
+
+    void (*chosen_func)() = menu->functions[(choice - 1)];
+    chosen_func();
+
+    if (menu->persistent)
+        print_menu(menu);
+    else
+        loop_unwatch_fd(loop, fd);
+}
+
+/**
+ * Runs a menu on an event loop, reading the choices from stdin.
+ * Same as `run_menu`, except that it returns right away: the menu is handled by the
+ * loop, and timers and other input keep being handled while waiting for the user.
+ *
+ * @param menu The menu (which must remain valid while it runs)
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool run_menu_async(EventLoop *loop, Menu *menu)
+{
+    if (!loop || !menu || !menu->choice_text || !menu->functions || menu->num_choices <= 0)
+        return false;
+
+    print_menu(menu);
+    return loop_watch_fd(loop, STDIN_FILENO, &on_menu_line, menu);
+}
+
+static void call_simple_callback(EventLoop *loop, void *arg)
+{
+    (void)loop;
+    void (**func)() = (void (**)())arg;
+    (*func)();
+    free(func);
+}
+
+/**
+ * Calls a function after a given time, like `sleep_and_callback` in function_pointers_callback.c -
+ * but without blocking: the call is scheduled on the loop, and this returns right away.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool schedule_callback(EventLoop *loop, int msecs, void (*func)())
+{
+    if (!loop || !func || msecs < 0)
+        return false;
+
+    void (**copy)() = (void (**)())malloc(sizeof(func));
+    if (!copy)
+        return false;
+    *copy = func;
+
+    if (loop_add_timer(loop, msecs, 0, &call_simple_callback, copy) < 0)
+    {
+        free(copy);
+        return false;
+    }
+    return true;
+}
+
+void callback_1()
+{
+    printf("\n[timer] This callback function prints this message\n");
+    fflush(stdout);
+}
+
+void choice1()
+{
+    printf("This is choice 1\n");
+}
+
+void choice2()
+{
+    printf("This is choice 2\n");
+}
+
+typedef struct ticker
+{
+    int timer_id;
+    int ticks;
+} Ticker;
+
+static void tick(EventLoop *loop, void *arg)
+{
+    Ticker *ticker = (Ticker *)arg;
+    printf("\n[timer] tick %d\n", ++(ticker->ticks));
+    fflush(stdout);
+    if (ticker->ticks == 3)
+        loop_cancel_timer(loop, ticker->timer_id);
+}
+
+/**
+ * Benchmark state.
+ *
+ * @param lateness How late each timer expired (nanoseconds)
+ * @param line_latency Time from writing each line to handling it (nanoseconds)
+ */
+typedef struct bench_state
+{
+    uint64_t *deadlines;
+    uint64_t *lateness;
+    int timers_fired;
+    uint64_t *line_latency;
+    int lines_read;
+    int streams_open;
+    int write_fds[BENCH_STREAMS];
+} BenchState;
+
+static void bench_timer_expired(EventLoop *loop, void *arg)
+{
+    (void)loop;
+    BenchState *state = (BenchState *)arg;
+    uint64_t now = now_ns();
+    int i = state->timers_fired++;
+    // Timers expire in deadline order, so sorting the deadlines gives the expected order
+    state->lateness[i] = now - state->deadlines[i];
+}
+
+static void bench_line(EventLoop *loop, int fd, const char *line, void *arg)
+{
+    (void)loop;
+    BenchState *state = (BenchState *)arg;
+    if (!line)
+    {
+        close(fd);
+        state->streams_open--;
+        return;
+    }
+    uint64_t sent = strtoull(line, 0, 10);
+    state->line_latency[state->lines_read++] = now_ns() - sent;
+}
+
+static void *bench_writer(void *arg)
+{
+    BenchState *state = (BenchState *)arg;
+    char line[32];
+    for (int i = 0; i < BENCH_LINES_PER_STREAM; i++)
+    {
+        for (int s = 0; s < BENCH_STREAMS; s++)
+        {
+            int length = snprintf(line, sizeof(line), "%llu\n", (unsigned long long)now_ns());
+            if (write(state->write_fds[s], line, length) != length)
+                return 0;
+        }
+    }
+    for (int s = 0; s < BENCH_STREAMS; s++)
+        close(state->write_fds[s]);
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y ? 1
+                              : 0;
+}
+
+static void print_latencies(const char *name, uint64_t *values, int count, double elapsed)
+{
+    if (!count)
+        return;
+
+    qsort(values, count, sizeof(uint64_t), &compare_u64);
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += values[i];
+    printf("    %-6s %7d in %.3f s (%8.0f/s) | latency avg %7.1f us, p50 %7.1f us, p99 %7.1f us, max %8.1f us\n",
+           name, count, elapsed, count / elapsed, sum / count / 1e3, values[count / 2] / 1e3,
+           values[(int)(count * 0.99)] / 1e3, values[count - 1] / 1e3);
+}
+
+/**
+ * @brief Runs `num_timers` timers, spread over BENCH_TIMER_SPREAD_MS, and/or `num_streams` pipes
+ *        fed by another thread, on one loop, and prints how late the timers and the lines were handled.
+ */
+void bench_loop(int num_timers, int num_streams)
+{
+    EventLoop *loop = create_event_loop();
+    BenchState state = {0};
+    state.deadlines = (uint64_t *)malloc((num_timers + 1) * sizeof(uint64_t));
+    state.lateness = (uint64_t *)malloc((num_timers + 1) * sizeof(uint64_t));
+    state.line_latency = (uint64_t *)malloc(((size_t)num_streams * BENCH_LINES_PER_STREAM + 1) * sizeof(uint64_t));
+    if (!loop || !state.deadlines || !state.lateness || !state.line_latency)
+        goto cleanup;
+
+    for (int s = 0; s < num_streams; s++)
+    {
+        int fds[2];
+        if (pipe(fds) < 0)
+            goto cleanup;
+        state.write_fds[s] = fds[1];
+        loop_watch_fd(loop, fds[0], &bench_line, &state);
+        state.streams_open++;
+    }
+
+    double start = now_ns() / 1e9;
+    for (int i = 0; i < num_timers; i++)
+    {
+        int msecs = rand() % BENCH_TIMER_SPREAD_MS;
+        loop_add_timer(loop, msecs, 0, &bench_timer_expired, &state);
+    }
+    for (int i = 0; i < num_timers; i++)
+        state.deadlines[i] = loop->timers[i].deadline;
+    qsort(state.deadlines, num_timers, sizeof(uint64_t), &compare_u64);
+
+    pthread_t writer;
+    bool writing = num_streams && !pthread_create(&writer, 0, &bench_writer, &state);
+    loop_run(loop);
+    double elapsed = now_ns() / 1e9 - start;
+    if (writing)
+        pthread_join(writer, 0);
+
+    printf("%d timers, %d input streams:\n", num_timers, num_streams);
+    print_latencies("Timers", state.lateness, state.timers_fired, elapsed);
+    print_latencies("Lines", state.line_latency, state.lines_read, elapsed);
+
+cleanup:
+    // Read ends still watched (only if something failed) are closed here, the rest at end of file
+    for (int fd = 0; loop && fd < MAX_FDS; fd++)
+    {
+        if (loop->watchers[fd])
+        {
+            loop_unwatch_fd(loop, fd);
+            close(fd);
+        }
+    }
+    destroy_event_loop(&loop);
+    free(state.deadlines);
+    free(state.lateness);
+    free(state.line_latency);
+}
+
+int main(void)
+{
+    printf("*********************************EVENT LOOP:*********************************\n");
+    // `run_menu` waits in `scanf`, and `sleep_and_callback` waits in `sleep` - and while
+    // a program waits for one thing, it can't do anything else. An event loop waits for
+    // ALL of them at once (with `epoll`), and runs a callback for whichever happens first.
+    // Here a menu runs while timers keep firing.
+
+    EventLoop *loop = create_event_loop();
+    if (!loop)
+        return 0;
+
+    Ticker ticker = {0, 0};
+    ticker.timer_id = loop_add_timer(loop, 1000, 1000, &tick, &ticker);
+    schedule_callback(loop, 500, &callback_1);
+
+    const char *option_text[2] = {"Choice 1", "Choice 2"};
+    void (*functions[2])() = {&choice1, &choice2};
+    Menu menu = {"", option_text, functions, 2, true};
+    run_menu_async(loop, &menu);
+
+    loop_run(loop);
+    destroy_event_loop(&loop);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    srand(time(NULL));
+    bench_loop(BENCH_TIMERS, 0);
+    bench_loop(0, BENCH_STREAMS);
+    bench_loop(BENCH_TIMERS, BENCH_STREAMS);
+
+    return 0;
+}
@@ -0,0 +1,606 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#define MAX_THREADS 16
+#define MAX_VALUE_LEN 32
+#define BENCH_VALUES 1000000
+
+typedef enum type
+{
+    INT,
+    FLOAT,
+    STRING
+} Type;
+
+const char *type_names[3] = {"int", "float", "string"};
+
+int cmp_int(const char *str_a, const char *str_b)
+{
+    int a = atoi(str_a);
+    int b = atoi(str_b);
+
+    return a < b ? -1 : a > b ? 1
+                              : 0;
+}
+
+int cmp_float(const char *str_a, const char *str_b)
+{
+    float a = atof(str_a);
+    float b = atof(str_b);
+
+    return a < b ? -1 : a > b ? 1
+                              : 0;
+}
+
+int (*cmp_funcs[3])(const char *, const char *) = {&cmp_int, &cmp_float, &strcmp};
+
+// Number of comparisons made so far by this thread, for the benchmark.
+// Each thread counts its own, so counting costs no more than an increment;
+// `parallel_top_k` adds its workers' counts to the caller's after joining them.
+static __thread long num_comparisons = 0;
+
+/**
+ * The `var_cmp` from function_pointer_arrays.c.
+ */
+int var_cmp(Type type, const char *a, const char *b, int (*cmp_funcs[])(const char *, const char *))
+{
+    num_comparisons++;
+    return cmp_funcs[type](a, b);
+}
+
+/**
+ * @brief Compares two variables so that the ones we're looking for come first:
+ *        the smallest if `largest` is `false`, otherwise the largest.
+ */
+static int order_cmp(Type type, bool largest, const char *a, const char *b)
+{
+    int res = var_cmp(type, a, b, cmp_funcs);
+    return largest ? -res : res;
+}
+
+static void swap_values(const char **a, const char **b)
+{
+    const char *temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+/**
+ * Keeps the k smallest (or largest) of a stream of values, without storing the whole stream.
+ * The kept values are in a heap whose root is the WORST of them, so a new value only
+ * needs one comparison with the root to be rejected, and O(log k) to replace it.
+ *
+ * @param heap The kept values (copies, owned by the TopK)
+ * @param size Number of kept values
+ * @param k Maximal number of kept values
+ * @param largest `true` to keep the largest values, `false` to keep the smallest
+ */
+typedef struct top_k
+{
+    Type type;
+    bool largest;
+    int k;
+    int size;
+    char **heap;
+} TopK;
+
+/**
+ * Creates an empty TopK.
+ *
+ * @param type Type of the values, as defined in enum `Type`
+ * @param k Number of values to keep
+ * @param largest `true` to keep the largest values, `false` to keep the smallest
+ *
+ * @returns A new TopK, or NULL on error.
+ */
+TopK *create_top_k(Type type, int k, bool largest)
+{
+    if (k <= 0)
+        return 0;
+
+    TopK *top = (TopK *)malloc(sizeof(TopK));
+    if (!top)
+        return 0;
+
+    top->heap = (char **)malloc(k * sizeof(char *));
+    if (!(top->heap))
+    {
+        free(top);
+        return 0;
+    }
+    top->type = type;
+    top->largest = largest;
+    top->k = k;
+    top->size = 0;
+    return top;
+}
+
+/**
+ * @brief Moves the value at `index` down the heap until it's no better than its children,
+ *        so that the root is always the worst kept value.
+ */
+static void sift_down(TopK *top, int index)
+{
+    while (true)
+    {
+        int worst = index, left = 2 * index + 1, right = left + 1;
+        if (left < top->size && order_cmp(top->type, top->largest, top->heap[left], top->heap[worst]) > 0)
+            worst = left;
+        if (right < top->size && order_cmp(top->type, top->largest, top->heap[right], top->heap[worst]) > 0)
+            worst = right;
+        if (worst == index)
+            return;
+        swap_values((const char **)&top->heap[index], (const char **)&top->heap[worst]);
+        index = worst;
+    }
+}
+
+static void sift_up(TopK *top, int index)
+{
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (order_cmp(top->type, top->largest, top->heap[index], top->heap[parent]) <= 0)
+            return;
+        swap_values((const char **)&top->heap[index], (const char **)&top->heap[parent]);
+        index = parent;
+    }
+}
+
+/**
+ * Offers a value to a TopK. If it's among the k best values seen so far, a copy of it
+ * is kept (so `value` may be reused by the caller right away).
+ *
+ * @returns `true` if the value was kept.
+ */
+bool top_k_push(TopK *top, const char *value)
+{
+    if (!top || !value)
+        return false;
+
+    if (top->size == top->k)
+    {
+        // Not better than the worst kept value - the common case, after the first few values
+        if (order_cmp(top->type, top->largest, value, top->heap[0]) >= 0)
+            return false;
+
+        char *copy = strdup(value);
+        if (!copy)
+            return false;
+        free(top->heap[0]);
+        top->heap[0] = copy;
+        sift_down(top, 0);
+        return true;
+    }
+
+    char *copy = strdup(value);
+    if (!copy)
+        return false;
+    top->heap[top->size++] = copy;
+    sift_up(top, top->size - 1);
+    return true;
+}
+
+/**
+ * Empties a TopK into an array, best value first.
+ *
+ * @param count Will hold the number of values in the array
+ *
+ * @returns An array of the kept values (the array and every value in it must be freed
+ *          by the caller), or NULL if the TopK is empty or on error.
+ */
+char **top_k_take(TopK *top, int *count)
+{
+    if (count)
+        *count = 0;
+    if (!top || !count || !top->size)
+        return 0;
+
+    char **result = (char **)malloc(top->size * sizeof(char *));
+    if (!result)
+        return 0;
+
+    // Repeatedly taking the worst value out of the heap fills the array from its end
+    *count = top->size;
+    while (top->size)
+    {
+        result[top->size - 1] = top->heap[0];
+        top->heap[0] = top->heap[--top->size];
+        sift_down(top, 0);
+    }
+    return result;
+}
+
+/**
+ * @brief Frees a TopK (and the values it still holds), and points the given TopK to NULL.
+ */
+void destroy_top_k(TopK **top)
+{
+    if (!top || !(*top))
+        return;
+
+    for (int i = 0; i < (*top)->size; i++)
+        free((*top)->heap[i]);
+    free((*top)->heap);
+    free(*top);
+    (*top) = 0;
+}
+
+/**
+ * @brief Places the median of values[low], values[mid] and values[high] at values[high],
+ *        to be used as the pivot. Sorted or reversed input then splits evenly.
+ */
+static void median_of_three(Type type, bool largest, const char **values, int low, int high)
+{
+    int mid = low + (high - low) / 2;
+    if (order_cmp(type, largest, values[mid], values[low]) < 0)
+        swap_values(&values[mid], &values[low]);
+    if (order_cmp(type, largest, values[high], values[low]) < 0)
+        swap_values(&values[high], &values[low]);
+    if (order_cmp(type, largest, values[mid], values[high]) < 0)
+        swap_values(&values[mid], &values[high]);
+}
+
+/**
+ * @brief Splits values[low..high] around the pivot at values[high].
+ *
+ * @returns The final index of the pivot: every value before it is not worse, every value after it is not better.
+ */
+static int partition(Type type, bool largest, const char **values, int low, int high)
+{
+    const char *pivot = values[high];
+    int store = low;
+    for (int i = low; i < high; i++)
+    {
+        if (order_cmp(type, largest, values[i], pivot) < 0)
+            swap_values(&values[i], &values[store++]);
+    }
+    swap_values(&values[store], &values[high]);
+    return store;
+}
+
+/**
+ * @brief Fallback of `select_nth` when partitioning keeps going badly:
+ *        a heap of the n-th best values, which is O(n log n) whatever the input.
+ */
+static void heap_select(Type type, bool largest, const char **values, int low, int high, int n)
+{
+    TopK top = {type, largest, n - low + 1, 0, 0};
+    top.heap = (char **)(values + low);
+
+    // The first `k` values make up the heap (without copies - we only rearrange pointers)
+    for (int i = low; i < low + top.k; i++)
+    {
+        top.size++;
+        sift_up(&top, top.size - 1);
+    }
+    for (int i = low + top.k; i <= high; i++)
+    {
+        if (order_cmp(type, largest, values[i], values[low]) < 0)
+        {
+            swap_values(&values[i], &values[low]);
+            sift_down(&top, 0);
+        }
+    }
+    // The root is the worst of the n-th best, i.e. exactly the n-th
+    swap_values(&values[low], &values[n]);
+}
+
+/**
+ * Rearranges an array of values so that values[n] is the value that would be there if
+ * the array were sorted, every value before it is not worse, and every value after it is
+ * not better ("nth element").
+ * This is "introselect": quickselect (partitioning, and then continuing only in the part
+ * that contains `n`) which takes O(n) on average, switching to a heap if too many
+ * partitions are unbalanced so that it's never worse than O(n log n).
+ *
+ * @param type Type of the values, as defined in enum `Type`
+ * @param largest `true` to order the values from largest to smallest
+ * @param values The values
+ * @param num_values Number of values
+ * @param n Index of the value to select
+ */
+void select_nth(Type type, bool largest, const char **values, int num_values, int n)
+{
+    if (!values || n < 0 || n >= num_values)
+        return;
+
+    int low = 0, high = num_values - 1;
+    int depth_limit = 2;
+    for (int size = num_values; size > 1; size /= 2)
+        depth_limit += 2;
+
+    while (high > low)
+    {
+        if (depth_limit-- == 0)
+        {
+            heap_select(type, largest, values, low, high, n);
+            return;
+        }
+
+        median_of_three(type, largest, values, low, high);
+        int pivot = partition(type, largest, values, low, high);
+        if (pivot == n)
+            return;
+        if (n < pivot)
+            high = pivot - 1;
+        else
+            low = pivot + 1;
+    }
+}
+
+static Type sort_type;
+static bool sort_largest;
+
+static int qsort_cmp(const void *a, const void *b)
+{
+    return order_cmp(sort_type, sort_largest, *(const char **)a, *(const char **)b);
+}
+
+/**
+ * @brief Sorts an array of values with `qsort`, best value first.
+ *        Not thread-safe, since `qsort` passes no context to the comparison.
+ */
+void sort_values(Type type, bool largest, const char **values, int num_values)
+{
+    if (!values || num_values <= 0)
+        return;
+
+    sort_type = type;
+    sort_largest = largest;
+    qsort(values, num_values, sizeof(char *), &qsort_cmp);
+}
+
+/**
+ * @brief Like `sort_values`, but thread-safe: a simple insertion sort, for the few values
+ *        left after selection.
+ */
+static void insertion_sort(Type type, bool largest, const char **values, int num_values)
+{
+    for (int i = 1; i < num_values; i++)
+    {
+        for (int j = i; j > 0 && order_cmp(type, largest, values[j], values[j - 1]) < 0; j--)
+            swap_values(&values[j], &values[j - 1]);
+    }
+}
+
+/**
+ * Rearranges an array of values so that its first k values are the k best, in order.
+ *
+ * @returns The number of values placed (the smaller of k and `num_values`).
+ */
+int top_k_select(Type type, bool largest, const char **values, int num_values, int k)
+{
+    if (!values || num_values <= 0 || k <= 0)
+        return 0;
+    if (k > num_values)
+        k = num_values;
+
+    if (k < num_values)
+        select_nth(type, largest, values, num_values, k - 1);
+    if (k <= 64)
+        insertion_sort(type, largest, values, k);
+    else
+    {
+        select_nth(type, largest, values, k, k / 2);
+        top_k_select(type, largest, values, k / 2, k / 2);
+        top_k_select(type, largest, values + k / 2, k - k / 2, k - k / 2);
+    }
+    return k;
+}
+
+typedef struct select_args
+{
+    Type type;
+    bool largest;
+    const char **values;
+    int num_values;
+    int k;
+    long comparisons; // Set by the thread: the comparisons it made
+} SelectArgs;
+
+static void *select_part(void *arg)
+{
+    SelectArgs *args = (SelectArgs *)arg;
+    if (args->k < args->num_values)
+        select_nth(args->type, args->largest, args->values, args->num_values, args->k - 1);
+    args->comparisons = num_comparisons;
+    return 0;
+}
+
+/**
+ * Like `top_k_select`, for big arrays: the array is split into one part per thread, each
+ * thread moves the k best values of its part to the front of the part, and then the k
+ * best of those candidates are selected.
+ *
+ * @param num_threads Number of threads to use (at most MAX_THREADS)
+ *
+ * @returns The number of values placed at the front of `values`.
+ */
+int parallel_top_k(Type type, bool largest, const char **values, int num_values, int k, int num_threads)
+{
+    if (!values || num_values <= 0 || k <= 0)
+        return 0;
+    if (num_threads > MAX_THREADS)
+        num_threads = MAX_THREADS;
+    // Each part must be much bigger than k, otherwise there's little to gain
+    while (num_threads > 1 && num_values / num_threads < 4 * k)
+        num_threads--;
+    if (num_threads <= 1)
+        return top_k_select(type, largest, values, num_values, k);
+
+    pthread_t threads[MAX_THREADS];
+    SelectArgs args[MAX_THREADS];
+    int part = num_values / num_threads;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        int size = (i == num_threads - 1) ? num_values - i * part : part;
+        args[i] = (SelectArgs){type, largest, values + i * part, size, k, 0};
+        pthread_create(&threads[i], 0, &select_part, &args[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], 0);
+        num_comparisons += args[i].comparisons;
+    }
+
+    // Gather each part's k candidates at the front of the array
+    for (int i = 1; i < num_threads; i++)
+    {
+        for (int j = 0; j < k; j++)
+            swap_values(&values[i * k + j], &values[i * part + j]);
+    }
+    return top_k_select(type, largest, values, num_threads * k, k);
+}
+
+/**
+ * @brief Writes a random value of a given type, as a string.
+ */
+void random_value(Type type, char *buffer)
+{
+    switch (type)
+    {
+    case INT:
+        snprintf(buffer, MAX_VALUE_LEN, "%d", rand() - RAND_MAX / 2);
+        break;
+    case FLOAT:
+        snprintf(buffer, MAX_VALUE_LEN, "%.4f", (rand() - RAND_MAX / 2) / 1000.0);
+        break;
+    case STRING:
+        for (int i = 0; i < 8; i++)
+            buffer[i] = 'a' + rand() % 26;
+        buffer[8] = '\0';
+        break;
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Times one way of finding the k smallest values, on a fresh copy of `values`.
+ *
+ * @param method 0 - full sort, 1 - streaming TopK, 2 - introselect, 3 - parallel introselect
+ * @param first Will hold the best value found (for checking that all methods agree)
+ */
+static void bench_method(Type type, const char **values, const char **copy, int num_values, int k,
+                         int method, char *first)
+{
+    static const char *method_names[4] = {"Full sort", "Streaming heap", "Introselect", "Parallel"};
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    memcpy(copy, values, num_values * sizeof(char *));
+    num_comparisons = 0;
+
+    double start = now_seconds();
+    switch (method)
+    {
+    case 0:
+        sort_values(type, false, copy, num_values);
+        strcpy(first, copy[k - 1]);
+        break;
+    case 1:
+    {
+        TopK *top = create_top_k(type, k, false);
+        for (int i = 0; i < num_values; i++)
+            top_k_push(top, values[i]);
+        int count = 0;
+        char **result = top_k_take(top, &count);
+        strcpy(first, result ? result[count - 1] : "");
+        for (int i = 0; i < count; i++)
+            free(result[i]);
+        free(result);
+        destroy_top_k(&top);
+        break;
+    }
+    case 2:
+        top_k_select(type, false, copy, num_values, k);
+        strcpy(first, copy[k - 1]);
+        break;
+    case 3:
+        parallel_top_k(type, false, copy, num_values, k, num_threads);
+        strcpy(first, copy[k - 1]);
+        break;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("    %-15s | %7.3f s | %10ld comparisons | k-th: %s\n", method_names[method], elapsed, num_comparisons, first);
+}
+
+int main(void)
+{
+    printf("*********************************TYPED SELECTION:*********************************\n");
+    // To find the k smallest values there's no need to sort them all.
+    // A heap of k values handles a stream of values one at a time, and "introselect"
+    // rearranges an array only as much as needed. Both compare values through the
+    // same `var_cmp` and `cmp_funcs` table as function_pointer_arrays.c, so they work
+    // for all the types in `Type`.
+
+    const char *numbers[8] = {"42", "-7", "13", "1000", "0", "8", "-300", "77"};
+    TopK *top = create_top_k(INT, 3, true);
+    for (int i = 0; i < 8; i++)
+        top_k_push(top, numbers[i]);
+
+    int count = 0;
+    char **largest = top_k_take(top, &count);
+    printf("The 3 largest ints:");
+    for (int i = 0; i < count; i++)
+    {
+        printf(" %s", largest[i]);
+        free(largest[i]);
+    }
+    printf("\n");
+    free(largest);
+    destroy_top_k(&top);
+
+    select_nth(INT, false, numbers, 8, 4);
+    printf("The median (5th smallest) int: %s\n", numbers[4]);
+
+    const char *words[5] = {"pear", "apple", "fig", "banana", "cherry"};
+    top_k_select(STRING, false, words, 5, 2);
+    printf("The 2 first strings: %s %s\n", words[0], words[1]);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    char *storage = (char *)malloc((size_t)BENCH_VALUES * MAX_VALUE_LEN);
+    const char **values = (const char **)malloc(BENCH_VALUES * sizeof(char *));
+    const char **copy = (const char **)malloc(BENCH_VALUES * sizeof(char *));
+    if (!storage || !values || !copy)
+    {
+        free(storage);
+        free(values);
+        free(copy);
+        return 0;
+    }
+
+    char first[MAX_VALUE_LEN];
+    srand(time(NULL));
+    for (Type type = INT; type <= STRING; type++)
+    {
+        for (int i = 0; i < BENCH_VALUES; i++)
+        {
+            values[i] = storage + (size_t)i * MAX_VALUE_LEN;
+            random_value(type, storage + (size_t)i * MAX_VALUE_LEN);
+        }
+
+        for (int k = 10; k <= 1000; k *= 100)
+        {
+            printf("%d %ss, k = %d:\n", BENCH_VALUES, type_names[type], k);
+            for (int method = 0; method < 4; method++)
+                bench_method(type, values, copy, BENCH_VALUES, k, method, first);
+        }
+    }
+
+    free(storage);
+    free(values);
+    free(copy);
+    return 0;
+}
@@ -0,0 +1,842 @@
+#define _GNU_SOURCE // For `memmem`
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+#define MAX_PATTERNS 64
+#define MAX_AC_STATES 65535
+#define TEDDY_BUCKETS 8
+#define TEDDY_PREFIX 3 // Bytes of each pattern the SIMD filter looks at
+#define MAX_RESULTS 1000000
+#define BENCH_SIZE (64 * 1024 * 1024)
+#define BENCH_PASSES 5
+#define BENCH_NUM_KEYWORDS 32
+#define BENCH_KEYWORD_EVERY 2000 // About one record in this many contains a keyword
+
+/*
+ * A record buffer holds records one after the other, each ending with '\0' or '\n'
+ * (like the strings `nth_string` walks). The first record has index 0.
+ * Patterns may not contain '\0' or '\n', so a match never spans two records.
+ */
+
+static inline bool is_delimiter(char c)
+{
+    return c == '\0' || c == '\n';
+}
+
+// Finds the first occurrence of a pattern in `size` bytes, or returns NULL
+typedef const char *(*FindFunc)(const char *text, size_t size, const char *pattern, size_t length);
+
+/**
+ * @brief Finds a pattern byte by byte: the obvious loop.
+ */
+const char *find_naive(const char *text, size_t size, const char *pattern, size_t length)
+{
+    if (length > size)
+        return 0;
+
+    for (size_t i = 0; i + length <= size; i++)
+    {
+        size_t j = 0;
+        while (j < length && text[i + j] == pattern[j])
+            j++;
+        if (j == length)
+            return text + i;
+    }
+    return 0;
+}
+
+const char *find_memmem(const char *text, size_t size, const char *pattern, size_t length)
+{
+    return (const char *)memmem(text, size, pattern, length);
+}
+
+#if HAVE_X86
+/**
+ * Finds a pattern 32 positions at a time with AVX2.
+ * For every position we compare, in parallel, the text's byte with the pattern's FIRST
+ * byte, and the byte `length - 1` further with the pattern's LAST byte. Only positions
+ * where both match (rare in real text) are compared in full.
+ */
+__attribute__((target("avx2"))) const char *find_avx2(const char *text, size_t size, const char *pattern, size_t length)
+{
+    if (length > size)
+        return 0;
+    if (length <= 1)
+        return length ? (const char *)memchr(text, pattern[0], size) : text;
+
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[length - 1]);
+    size_t i = 0;
+    for (; i + length - 1 + 32 <= size; i += 32)
+    {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *)(text + i + length - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (!memcmp(text + i + bit + 1, pattern + 1, length - 2))
+                return text + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_naive(text + i, size - i, pattern, length);
+}
+
+/**
+ * @brief Counts the '\0' and '\n' bytes in a range, 32 bytes at a time.
+ */
+__attribute__((target("avx2,popcnt"))) static size_t count_delimiters_avx2(const char *text, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256(), newline = _mm256_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, zero), _mm256_cmpeq_epi8(block, newline)));
+        count += __builtin_popcount(mask);
+    }
+    for (; i < size; i++)
+        count += is_delimiter(text[i]);
+    return count;
+}
+
+/**
+ * @brief Returns the offset of the first '\0' or '\n' in a range (or `size` if there's none).
+ */
+__attribute__((target("avx2"))) static size_t find_delimiter_avx2(const char *text, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256(), newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, zero), _mm256_cmpeq_epi8(block, newline)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    while (i < size && !is_delimiter(text[i]))
+        i++;
+    return i;
+}
+#endif
+
+static size_t count_delimiters_scalar(const char *text, size_t size)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++)
+        count += is_delimiter(text[i]);
+    return count;
+}
+
+static size_t find_delimiter_scalar(const char *text, size_t size)
+{
+    size_t i = 0;
+    while (i < size && !is_delimiter(text[i]))
+        i++;
+    return i;
+}
+
+static bool has_avx2(void)
+{
+#if HAVE_X86
+    static int supported = -1;
+    if (supported < 0)
+        supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Returns the fastest pattern finder this CPU supports.
+ */
+FindFunc best_finder(void)
+{
+#if HAVE_X86
+    if (has_avx2())
+        return &find_avx2;
+#endif
+    return &find_memmem;
+}
+
+static size_t count_delimiters(const char *text, size_t size)
+{
+#if HAVE_X86
+    if (has_avx2())
+        return count_delimiters_avx2(text, size);
+#endif
+    return count_delimiters_scalar(text, size);
+}
+
+static size_t find_delimiter(const char *text, size_t size)
+{
+#if HAVE_X86
+    if (has_avx2())
+        return find_delimiter_avx2(text, size);
+#endif
+    return find_delimiter_scalar(text, size);
+}
+
+/**
+ * Finds the records of a buffer that contain a pattern.
+ * The buffer is searched as a whole (not record by record); for every match we count the
+ * record delimiters since the previous one to know its record, and then skip to the next record.
+ *
+ * @param buffer The records
+ * @param size Size of the buffer in bytes
+ * @param pattern The pattern (which may not contain '\0' or '\n')
+ * @param length Length of the pattern
+ * @param find How to find the pattern (`find_avx2`, `find_memmem`...), or NULL for the fastest available
+ * @param records Where the indices of the matching records are written, in increasing order
+ * @param max_records Size of `records`
+ *
+ * @returns The number of matching records (indices past `max_records` aren't written), or -1 on error.
+ */
+long search_records(const char *buffer, size_t size, const char *pattern, size_t length, FindFunc find,
+                    long *records, long max_records)
+{
+    if (!buffer || !pattern || !length || (!records && max_records > 0))
+        return -1;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (is_delimiter(pattern[i]))
+            return -1;
+    }
+    if (!find)
+        find = best_finder();
+
+    long found = 0, record = 0;
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const char *match = find(buffer + pos, size - pos, pattern, length);
+        if (!match)
+            break;
+
+        size_t offset = match - buffer;
+        record += count_delimiters(buffer + pos, offset - pos);
+        if (found < max_records)
+            records[found] = record;
+        found++;
+
+        // Other matches in the same record don't matter
+        pos = offset + find_delimiter(buffer + offset, size - offset) + 1;
+        record++;
+    }
+    return found;
+}
+
+/**
+ * An Aho-Corasick automaton, which finds any number of patterns in a single pass.
+ * Its states are the prefixes of the patterns; reading a byte moves from a state to the
+ * longest prefix that ends there, so after every byte we know which patterns just ended.
+ * Here every transition is precomputed in a table (a "DFA"), so each byte of text costs
+ * one table lookup, however many patterns there are.
+ *
+ * @param next Transitions: the state after state s reads byte c is next[s * 256 + c]
+ * @param matches For each state, the set of patterns (bit i for pattern i) that end there
+ */
+typedef struct aho_corasick
+{
+    uint16_t *next;
+    uint64_t *matches;
+    int num_states;
+    int num_patterns;
+} AhoCorasick;
+
+/**
+ * Builds an Aho-Corasick automaton for a set of patterns.
+ *
+ * @param patterns The patterns (at most MAX_PATTERNS, none of them empty or containing '\0' or '\n')
+ *
+ * @returns A new automaton, or NULL if the patterns are invalid or on error.
+ */
+AhoCorasick *create_matcher(const char **patterns, int num_patterns)
+{
+    if (!patterns || num_patterns <= 0 || num_patterns > MAX_PATTERNS)
+        return 0;
+
+    size_t max_states = 1;
+    for (int i = 0; i < num_patterns; i++)
+    {
+        if (!patterns[i] || !patterns[i][0] || strchr(patterns[i], '\n'))
+            return 0;
+        max_states += strlen(patterns[i]);
+    }
+    if (max_states > MAX_AC_STATES)
+        return 0;
+
+    AhoCorasick *ac = (AhoCorasick *)calloc(1, sizeof(AhoCorasick));
+    int *fail = (int *)calloc(max_states, sizeof(int));
+    int *queue = (int *)malloc(max_states * sizeof(int));
+    if (ac)
+    {
+        ac->next = (uint16_t *)calloc(max_states * 256, sizeof(uint16_t));
+        ac->matches = (uint64_t *)calloc(max_states, sizeof(uint64_t));
+    }
+    if (!ac || !fail || !queue || !ac->next || !ac->matches)
+    {
+        if (ac)
+        {
+            free(ac->next);
+            free(ac->matches);
+        }
+        free(ac);
+        free(fail);
+        free(queue);
+        return 0;
+    }
+
+    // 1. A trie of the patterns (0 is both the root and "no transition yet")
+    ac->num_states = 1;
+    ac->num_patterns = num_patterns;
+    for (int i = 0; i < num_patterns; i++)
+    {
+        int state = 0;
+        for (const unsigned char *c = (const unsigned char *)patterns[i]; *c; c++)
+        {
+            if (!ac->next[state * 256 + *c])
+                ac->next[state * 256 + *c] = ac->num_states++;
+            state = ac->next[state * 256 + *c];
+        }
+        ac->matches[state] |= 1ull << i;
+    }
+
+    // 2. In breadth-first order, fill in the missing transitions from the state's "failure"
+    //    state (its longest proper suffix that is also a prefix), which is closer to the root
+    //    and so already complete. Delimiters always lead back to the root.
+    int head = 0, tail = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        if (ac->next[c] && !is_delimiter((char)c))
+            queue[tail++] = ac->next[c];
+        else
+            ac->next[c] = 0;
+    }
+    while (head < tail)
+    {
+        int state = queue[head++];
+        ac->matches[state] |= ac->matches[fail[state]];
+        for (int c = 0; c < 256; c++)
+        {
+            int child = ac->next[state * 256 + c];
+            if (is_delimiter((char)c))
+                ac->next[state * 256 + c] = 0;
+            else if (child)
+            {
+                fail[child] = ac->next[fail[state] * 256 + c];
+                queue[tail++] = child;
+            }
+            else
+                ac->next[state * 256 + c] = ac->next[fail[state] * 256 + c];
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return ac;
+}
+
+void destroy_matcher(AhoCorasick **ac)
+{
+    if (!ac || !(*ac))
+        return;
+
+    free((*ac)->next);
+    free((*ac)->matches);
+    free(*ac);
+    (*ac) = 0;
+}
+
+/**
+ * Finds the records of a buffer that contain any of a matcher's patterns, in one pass.
+ *
+ * @param records Where the indices of the matching records are written, in increasing order
+ * @param which Where the set of patterns found in each of those records is written
+ *              (bit i for pattern i); may be NULL
+ * @param max_records Size of `records` (and `which`)
+ *
+ * @returns The number of matching records (those past `max_records` aren't written), or -1 on error.
+ */
+long ac_search_records(const AhoCorasick *ac, const char *buffer, size_t size, long *records, uint64_t *which,
+                       long max_records)
+{
+    if (!ac || !buffer || (!records && max_records > 0))
+        return -1;
+
+    const uint16_t *next = ac->next;
+    const uint64_t *matches = ac->matches;
+    const unsigned char *text = (const unsigned char *)buffer;
+    long found = 0, record = 0;
+    uint64_t matched = 0;
+    int state = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        state = next[state * 256 + text[i]];
+        matched |= matches[state];
+        if (is_delimiter((char)text[i]))
+        {
+            if (matched)
+            {
+                if (found < max_records)
+                {
+                    records[found] = record;
+                    if (which)
+                        which[found] = matched;
+                }
+                found++;
+                matched = 0;
+            }
+            record++;
+        }
+    }
+    // A last record without a delimiter
+    if (matched)
+    {
+        if (found < max_records)
+        {
+            records[found] = record;
+            if (which)
+                which[found] = matched;
+        }
+        found++;
+    }
+    return found;
+}
+
+/**
+ * A "Teddy" matcher (the SIMD multi-pattern search from Hyperscan).
+ * Patterns are put in 8 buckets, and for each of the first TEDDY_PREFIX bytes of the patterns
+ * there are two 16-entry tables, indexed by the low and high nibble of a byte, that give the
+ * buckets with a pattern having that nibble there. `vpshufb` looks up 32 bytes in such a
+ * table at once, so ANDing all the lookups gives, for 32 positions, the buckets whose
+ * patterns may start at each of them. Only those few candidates are compared in full.
+ */
+typedef struct teddy Teddy;
+void destroy_teddy(Teddy **td);
+
+struct teddy
+{
+    uint8_t low[TEDDY_PREFIX][16];
+    uint8_t high[TEDDY_PREFIX][16];
+    char **patterns;
+    size_t *lengths;
+    int num_patterns;
+};
+
+/**
+ * Builds a Teddy matcher for a set of patterns.
+ *
+ * @param patterns The patterns (at most MAX_PATTERNS, each at least TEDDY_PREFIX long, none
+ *                 containing '\n'). For shorter patterns, use `create_matcher`.
+ *
+ * @returns A new matcher, or NULL if the patterns are invalid or on error.
+ */
+Teddy *create_teddy(const char **patterns, int num_patterns)
+{
+    if (!patterns || num_patterns <= 0 || num_patterns > MAX_PATTERNS)
+        return 0;
+    for (int i = 0; i < num_patterns; i++)
+    {
+        if (!patterns[i] || strlen(patterns[i]) < TEDDY_PREFIX || strchr(patterns[i], '\n'))
+            return 0;
+    }
+
+    Teddy *td = (Teddy *)calloc(1, sizeof(Teddy));
+    if (!td)
+        return 0;
+    td->patterns = (char **)calloc(num_patterns, sizeof(char *));
+    td->lengths = (size_t *)calloc(num_patterns, sizeof(size_t));
+    if (!td->patterns || !td->lengths)
+    {
+        free(td->patterns);
+        free(td->lengths);
+        free(td);
+        return 0;
+    }
+    td->num_patterns = num_patterns;
+
+    for (int i = 0; i < num_patterns; i++)
+    {
+        td->patterns[i] = strdup(patterns[i]);
+        if (!td->patterns[i])
+        {
+            destroy_teddy(&td);
+            return 0;
+        }
+        td->lengths[i] = strlen(patterns[i]);
+        for (int k = 0; k < TEDDY_PREFIX; k++)
+        {
+            unsigned char c = (unsigned char)patterns[i][k];
+            td->low[k][c & 0x0F] |= 1 << (i % TEDDY_BUCKETS);
+            td->high[k][c >> 4] |= 1 << (i % TEDDY_BUCKETS);
+        }
+    }
+    return td;
+}
+
+void destroy_teddy(Teddy **td)
+{
+    if (!td || !(*td))
+        return;
+
+    for (int i = 0; (*td)->patterns && i < (*td)->num_patterns; i++)
+        free((*td)->patterns[i]);
+    free((*td)->patterns);
+    free((*td)->lengths);
+    free(*td);
+    (*td) = 0;
+}
+
+/**
+ * Where a search over records is: matches come in increasing order, so we only need to count
+ * the delimiters between consecutive matches to know their record.
+ *
+ * @param counted Delimiters before this offset have been counted (it is in record `record`)
+ * @param end End of record `record`
+ * @param which The patterns found in record `record` so far
+ */
+typedef struct record_cursor
+{
+    size_t counted;
+    size_t end;
+    long record;
+    uint64_t which;
+    long found;
+} RecordCursor;
+
+static void flush_record(RecordCursor *cursor, long *records, uint64_t *which, long max_records)
+{
+    if (!cursor->which)
+        return;
+    if (cursor->found < max_records)
+    {
+        records[cursor->found] = cursor->record;
+        if (which)
+            which[cursor->found] = cursor->which;
+    }
+    cursor->found++;
+    cursor->which = 0;
+}
+
+static void add_match(RecordCursor *cursor, const char *buffer, size_t size, size_t offset, uint64_t pattern_bit,
+                      long *records, uint64_t *which, long max_records)
+{
+    if (cursor->which && offset < cursor->end)
+    {
+        cursor->which |= pattern_bit;
+        return;
+    }
+    flush_record(cursor, records, which, max_records);
+    cursor->record += count_delimiters(buffer + cursor->counted, offset - cursor->counted);
+    cursor->counted = offset;
+    cursor->end = offset + find_delimiter(buffer + offset, size - offset);
+    cursor->which = pattern_bit;
+}
+
+/**
+ * @brief Compares the patterns of the candidate buckets at an offset in full.
+ */
+static void teddy_verify(const Teddy *td, const char *buffer, size_t size, size_t offset, unsigned buckets,
+                         RecordCursor *cursor, long *records, uint64_t *which, long max_records)
+{
+    while (buckets)
+    {
+        int bucket = __builtin_ctz(buckets);
+        for (int p = bucket; p < td->num_patterns; p += TEDDY_BUCKETS)
+        {
+            if (offset + td->lengths[p] <= size && !memcmp(buffer + offset, td->patterns[p], td->lengths[p]))
+                add_match(cursor, buffer, size, offset, 1ull << p, records, which, max_records);
+        }
+        buckets &= buckets - 1;
+    }
+}
+
+/**
+ * @brief Looks for candidates one position at a time, starting from `offset`.
+ */
+static void teddy_scan_scalar(const Teddy *td, const char *buffer, size_t size, size_t offset,
+                              RecordCursor *cursor, long *records, uint64_t *which, long max_records)
+{
+    for (; offset + TEDDY_PREFIX <= size; offset++)
+    {
+        unsigned buckets = 0xFF;
+        for (int k = 0; k < TEDDY_PREFIX; k++)
+        {
+            unsigned char c = (unsigned char)buffer[offset + k];
+            buckets &= td->low[k][c & 0x0F] & td->high[k][c >> 4];
+        }
+        if (buckets)
+            teddy_verify(td, buffer, size, offset, buckets, cursor, records, which, max_records);
+    }
+}
+
+#if HAVE_X86
+__attribute__((target("avx2"))) static void teddy_scan_avx2(const Teddy *td, const char *buffer, size_t size,
+                                                            RecordCursor *cursor, long *records, uint64_t *which,
+                                                            long max_records)
+{
+    __m256i low[TEDDY_PREFIX], high[TEDDY_PREFIX];
+    for (int k = 0; k < TEDDY_PREFIX; k++)
+    {
+        low[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)td->low[k]));
+        high[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)td->high[k]));
+    }
+    const __m256i nibble = _mm256_set1_epi8(0x0F), zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 + TEDDY_PREFIX - 1 <= size; i += 32)
+    {
+        __m256i candidates = _mm256_set1_epi8(-1);
+        for (int k = 0; k < TEDDY_PREFIX; k++)
+        {
+            __m256i block = _mm256_loadu_si256((const __m256i *)(buffer + i + k));
+            __m256i low_nibbles = _mm256_and_si256(block, nibble);
+            __m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+            candidates = _mm256_and_si256(candidates, _mm256_and_si256(_mm256_shuffle_epi8(low[k], low_nibbles),
+                                                                       _mm256_shuffle_epi8(high[k], high_nibbles)));
+        }
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero));
+        if (mask)
+        {
+            uint8_t buckets[32];
+            _mm256_storeu_si256((__m256i *)buckets, candidates);
+            while (mask)
+            {
+                int bit = __builtin_ctz(mask);
+                teddy_verify(td, buffer, size, i + bit, buckets[bit], cursor, records, which, max_records);
+                mask &= mask - 1;
+            }
+        }
+    }
+    teddy_scan_scalar(td, buffer, size, i, cursor, records, which, max_records);
+}
+#endif
+
+/**
+ * Finds the records of a buffer that contain any of a Teddy matcher's patterns, in one pass.
+ * Parameters and return value are as in `ac_search_records`.
+ */
+long teddy_search_records(const Teddy *td, const char *buffer, size_t size, long *records, uint64_t *which,
+                          long max_records)
+{
+    if (!td || !buffer || (!records && max_records > 0))
+        return -1;
+
+    RecordCursor cursor = {0, 0, 0, 0, 0};
+#if HAVE_X86
+    if (has_avx2())
+        teddy_scan_avx2(td, buffer, size, &cursor, records, which, max_records);
+    else
+#endif
+        teddy_scan_scalar(td, buffer, size, 0, &cursor, records, which, max_records);
+    flush_record(&cursor, records, which, max_records);
+    return cursor.found;
+}
+
+/**
+ * @brief The usual way: `strstr` on each record in turn. The buffer's records must end with '\0'.
+ */
+long strstr_search_records(const char *buffer, size_t size, const char *pattern, long *records, long max_records)
+{
+    long found = 0, record = 0;
+    for (const char *scan = buffer; scan < buffer + size; record++)
+    {
+        if (strstr(scan, pattern))
+        {
+            if (found < max_records)
+                records[found] = record;
+            found++;
+        }
+        scan += strlen(scan) + 1;
+    }
+    return found;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Fills a buffer with records of random lowercase words; about one record in
+ *        BENCH_KEYWORD_EVERY also gets one of the keywords.
+ */
+static void make_corpus(char *buffer, size_t size, const char **keywords, int num_keywords)
+{
+    size_t pos = 0;
+    while (pos + 128 < size)
+    {
+        int words = 4 + rand() % 8;
+        for (int w = 0; w < words; w++)
+        {
+            int length = 2 + rand() % 8;
+            for (int c = 0; c < length; c++)
+                buffer[pos++] = 'a' + rand() % 26;
+            buffer[pos++] = ' ';
+        }
+        if (rand() % BENCH_KEYWORD_EVERY == 0)
+        {
+            const char *keyword = keywords[rand() % num_keywords];
+            memcpy(buffer + pos, keyword, strlen(keyword));
+            pos += strlen(keyword);
+        }
+        buffer[pos++] = (rand() % 8) ? '\n' : '\0';
+    }
+    while (pos < size)
+        buffer[pos++] = '\n';
+}
+
+static void report(const char *name, size_t size, double elapsed, long found)
+{
+    printf("    %-30s | %6.2f GB/s | %ld records\n", name, size * (double)BENCH_PASSES / elapsed / 1e9, found);
+}
+
+int main(void)
+{
+    printf("*********************************SIMD SEARCH:*********************************\n");
+    // Searching every record with `strstr` first walks the record to its end, and then
+    // compares byte by byte. Searching the WHOLE buffer instead, 32 bytes at a time with
+    // AVX2, is far faster - we only need to count record delimiters when a match is found.
+    // For many patterns at once, an Aho-Corasick automaton reads each byte only once, and
+    // Teddy filters 32 positions at a time for all the patterns together.
+    printf("AVX2 is %savailable\n", has_avx2() ? "" : "NOT ");
+
+    char buffer[] = "first record\0the needle is here\nnothing\0another needle, and a pin\nlast";
+    long records[8];
+    uint64_t which[8];
+    long found = search_records(buffer, sizeof(buffer) - 1, "needle", 6, 0, records, 8);
+    printf("\"needle\" is in %ld records:", found);
+    for (long i = 0; i < found; i++)
+        printf(" %ld", records[i]);
+    printf("\n");
+
+    const char *patterns[3] = {"pin", "needle", "last"};
+    AhoCorasick *ac = create_matcher(patterns, 3);
+    found = ac_search_records(ac, buffer, sizeof(buffer) - 1, records, which, 8);
+    for (long i = 0; i < found; i++)
+    {
+        printf("Record %ld contains:", records[i]);
+        for (int p = 0; p < 3; p++)
+            if (which[i] & (1ull << p))
+                printf(" \"%s\"", patterns[p]);
+        printf("\n");
+    }
+    destroy_matcher(&ac);
+
+    Teddy *td = create_teddy(patterns, 3);
+    found = teddy_search_records(td, buffer, sizeof(buffer) - 1, records, which, 8);
+    printf("Teddy agrees: %s\n", found == 3 && records[1] == 3 && which[1] == 3 ? "yes" : "no");
+    destroy_teddy(&td);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    char *corpus = (char *)malloc(BENCH_SIZE);
+    char *nul_corpus = (char *)malloc(BENCH_SIZE + 1);
+    long *results = (long *)malloc(MAX_RESULTS * sizeof(long));
+    if (!corpus || !nul_corpus || !results)
+    {
+        free(corpus);
+        free(nul_corpus);
+        free(results);
+        return 0;
+    }
+
+    // Keywords have digits, so random words never match them by chance
+    char keyword_storage[BENCH_NUM_KEYWORDS][16];
+    const char *keywords[BENCH_NUM_KEYWORDS];
+    for (int i = 0; i < BENCH_NUM_KEYWORDS; i++)
+    {
+        snprintf(keyword_storage[i], sizeof(keyword_storage[i]), "keyword%02d", i % 100);
+        keywords[i] = keyword_storage[i];
+    }
+    srand(12345);
+    make_corpus(corpus, BENCH_SIZE, keywords, BENCH_NUM_KEYWORDS);
+    // `strstr` needs every record to end with '\0'
+    for (size_t i = 0; i < BENCH_SIZE; i++)
+        nul_corpus[i] = corpus[i] == '\n' ? '\0' : corpus[i];
+    nul_corpus[BENCH_SIZE] = '\0';
+
+    printf("%d MB of records, one pattern (\"%s\"):\n", BENCH_SIZE >> 20, keywords[7]);
+    const char *pattern = keywords[7];
+    double start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        found = strstr_search_records(nul_corpus, BENCH_SIZE, pattern, results, MAX_RESULTS);
+    report("strstr per record", BENCH_SIZE, now_seconds() - start, found);
+
+    struct
+    {
+        const char *name;
+        FindFunc find;
+    } finders[3] = {{"Byte loop, whole buffer", &find_naive}, {"memmem, whole buffer", &find_memmem}, {"AVX2, whole buffer", 0}};
+    for (int f = 0; f < 3; f++)
+    {
+        if (!finders[f].find && !has_avx2())
+            continue;
+        start = now_seconds();
+        for (int pass = 0; pass < BENCH_PASSES; pass++)
+            found = search_records(corpus, BENCH_SIZE, pattern, strlen(pattern), finders[f].find, results, MAX_RESULTS);
+        report(finders[f].name, BENCH_SIZE, now_seconds() - start, found);
+    }
+
+    for (int num_patterns = 4; num_patterns <= BENCH_NUM_KEYWORDS; num_patterns *= 8)
+    {
+        printf("%d MB of records, %d patterns:\n", BENCH_SIZE >> 20, num_patterns);
+
+        // Without a multi-pattern matcher: one full search per pattern, then merge the records
+        start = now_seconds();
+        for (int pass = 0; pass < BENCH_PASSES; pass++)
+        {
+            char *seen = (char *)calloc(BENCH_SIZE / 8, 1); // Records are more than 8 bytes long
+            found = 0;
+            for (int p = 0; seen && p < num_patterns; p++)
+            {
+                long count = search_records(corpus, BENCH_SIZE, keywords[p], strlen(keywords[p]), 0, results, MAX_RESULTS);
+                for (long i = 0; i < count && i < MAX_RESULTS; i++)
+                {
+                    found += !seen[results[i]];
+                    seen[results[i]] = 1;
+                }
+            }
+            free(seen);
+        }
+        report(has_avx2() ? "AVX2, once per pattern" : "memmem, once per pattern", BENCH_SIZE, now_seconds() - start, found);
+
+        ac = create_matcher(keywords, num_patterns);
+        start = now_seconds();
+        for (int pass = 0; ac && pass < BENCH_PASSES; pass++)
+            found = ac_search_records(ac, corpus, BENCH_SIZE, results, 0, MAX_RESULTS);
+        report("Aho-Corasick, single pass", BENCH_SIZE, now_seconds() - start, found);
+        destroy_matcher(&ac);
+
+        td = create_teddy(keywords, num_patterns);
+        start = now_seconds();
+        for (int pass = 0; td && pass < BENCH_PASSES; pass++)
+            found = teddy_search_records(td, corpus, BENCH_SIZE, results, 0, MAX_RESULTS);
+        report(has_avx2() ? "Teddy (AVX2), single pass" : "Teddy (scalar), single pass", BENCH_SIZE, now_seconds() - start, found);
+        destroy_teddy(&td);
+    }
+
+    free(corpus);
+    free(nul_corpus);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define SB_MIN_CAPACITY 16
+#define ROPE_CHUNK 1024
+#define BENCH_ROPE_SIZE (16 * 1024 * 1024)
+#define BENCH_ROPE_EDITS 2000
+
+/**
+ * A "view" of a string: a pointer to its first character and its length.
+ * It doesn't own the characters, and they need not end with '\0'.
+ */
+typedef struct str_view
+{
+    const char *data;
+    size_t length;
+} StrView;
+
+/**
+ * @brief Returns a view of a '\0'-terminated string.
+ */
+StrView view_of(const char *str)
+{
+    StrView view = {str ? str : "", str ? strlen(str) : 0};
+    return view;
+}
+
+/**
+ * A string that's built by appending to it.
+ * Unlike `strcat`, which must first walk the whole destination to find its end and
+ * trusts the caller for the room, a builder knows its length and its capacity: an append
+ * costs only the length of what's appended, and the builder grows as needed.
+ * The capacity doubles each time it grows, so building a string of n characters copies
+ * each character O(1) times on average.
+ *
+ * @param data The characters, always followed by '\0'
+ * @param length Number of characters (not counting the '\0')
+ * @param capacity Number of characters `data` has room for (not counting the '\0')
+ */
+typedef struct string_builder
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} StringBuilder;
+
+/**
+ * Creates an empty string builder.
+ *
+ * @param capacity Initial capacity (0 for the default)
+ *
+ * @returns A new builder, or NULL on error.
+ */
+StringBuilder *create_builder(size_t capacity)
+{
+    StringBuilder *sb = (StringBuilder *)malloc(sizeof(StringBuilder));
+    if (!sb)
+        return 0;
+
+    sb->capacity = capacity > SB_MIN_CAPACITY ? capacity : SB_MIN_CAPACITY;
+    sb->data = (char *)malloc(sb->capacity + 1);
+    if (!(sb->data))
+    {
+        free(sb);
+        return 0;
+    }
+    sb->data[0] = '\0';
+    sb->length = 0;
+    return sb;
+}
+
+/**
+ * @brief Frees a builder, and points the given builder to NULL.
+ */
+void destroy_builder(StringBuilder **sb)
+{
+    if (!sb || !(*sb))
+        return;
+
+    free((*sb)->data);
+    free(*sb);
+    (*sb) = 0;
+}
+
+/**
+ * Makes sure the builder has room for `extra` more characters, so that appending
+ * them won't reallocate.
+ *
+ * @returns `true` on success, `false` on error (in which case the builder is unchanged).
+ */
+bool sb_reserve(StringBuilder *sb, size_t extra)
+{
+    if (!sb)
+        return false;
+    if (sb->capacity - sb->length >= extra)
+        return true;
+
+    size_t capacity = sb->capacity;
+    while (capacity - sb->length < extra)
+    {
+        if (capacity > ((size_t)-1 - 1) / 2)
+            return false;
+        capacity *= 2;
+    }
+
+    char *data = (char *)realloc(sb->data, capacity + 1);
+    if (!data)
+        return false;
+    sb->data = data;
+    sb->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Appends a view's characters.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool sb_append_view(StringBuilder *sb, StrView view)
+{
+    if (!sb)
+        return false;
+
+    // The view may point into the builder itself (e.g. `sb_view(sb)`), which `sb_reserve` can move
+    bool inside = sb->data && view.data >= sb->data && view.data <= sb->data + sb->length;
+    size_t offset = inside ? (size_t)(view.data - sb->data) : 0;
+    if (!sb_reserve(sb, view.length))
+        return false;
+    if (inside)
+        view.data = sb->data + offset;
+
+    memcpy(sb->data + sb->length, view.data, view.length);
+    sb->length += view.length;
+    sb->data[sb->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Appends a '\0'-terminated string.
+ */
+bool sb_append(StringBuilder *sb, const char *str)
+{
+    return sb_append_view(sb, view_of(str));
+}
+
+/**
+ * @brief Appends a single character.
+ */
+bool sb_append_char(StringBuilder *sb, char c)
+{
+    if (!sb || !sb_reserve(sb, 1))
+        return false;
+
+    sb->data[sb->length++] = c;
+    sb->data[sb->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Appends an int in decimal, written straight into the builder.
+ */
+bool sb_append_int(StringBuilder *sb, int value)
+{
+    char digits[12];
+    int count = 0;
+    // Work with the negative value, which (unlike the positive one) always exists for INT_MIN
+    int negative = value < 0 ? value : -value;
+    do
+    {
+        digits[count++] = (char)('0' - negative % 10);
+        negative /= 10;
+    } while (negative);
+
+    if (!sb || !sb_reserve(sb, count + 1))
+        return false;
+    if (value < 0)
+        sb->data[sb->length++] = '-';
+    while (count)
+        sb->data[sb->length++] = digits[--count];
+    sb->data[sb->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Appends a float with a given number of decimal places.
+ */
+bool sb_append_float(StringBuilder *sb, double value, int decimals)
+{
+    if (!sb || decimals < 0)
+        return false;
+
+    int needed = snprintf(0, 0, "%.*f", decimals, value);
+    if (needed < 0 || !sb_reserve(sb, needed))
+        return false;
+    snprintf(sb->data + sb->length, needed + 1, "%.*f", decimals, value);
+    sb->length += needed;
+    return true;
+}
+
+/**
+ * @brief Returns a view of the builder's string, without copying it.
+ *        The view is valid until the builder is changed.
+ */
+StrView sb_view(const StringBuilder *sb)
+{
+    StrView view = {sb ? sb->data : "", sb ? sb->length : 0};
+    return view;
+}
+
+/**
+ * @brief Empties the builder, keeping its capacity.
+ */
+void sb_clear(StringBuilder *sb)
+{
+    if (!sb)
+        return;
+
+    sb->length = 0;
+    sb->data[0] = '\0';
+}
+
+/**
+ * A "rope": a long string kept as a balanced binary tree of pieces ("chunks").
+ * Reading the pieces in order (left subtree, node, right subtree) gives the string.
+ * Inserting into or deleting from the middle of a flat string moves everything after
+ * the edit; a rope only splits and joins trees, in O(log n).
+ * The tree is a "treap": every node gets a random priority, and a parent's priority is
+ * never lower than its children's, which keeps the tree balanced on average.
+ *
+ * @param text The node's own chunk
+ * @param length Length of `text`
+ * @param total Length of the whole subtree's string
+ * @param priority The node's random priority
+ */
+typedef struct rope_node
+{
+    char *text;
+    size_t length;
+    size_t total;
+    unsigned priority;
+    struct rope_node *left;
+    struct rope_node *right;
+} RopeNode;
+
+static size_t rope_total(const RopeNode *rope)
+{
+    return rope ? rope->total : 0;
+}
+
+static void rope_update(RopeNode *node)
+{
+    node->total = rope_total(node->left) + node->length + rope_total(node->right);
+}
+
+static RopeNode *create_rope_node(StrView text)
+{
+    RopeNode *node = (RopeNode *)malloc(sizeof(RopeNode));
+    if (!node)
+        return 0;
+
+    node->text = (char *)malloc(text.length ? text.length : 1);
+    if (!(node->text))
+    {
+        free(node);
+        return 0;
+    }
+    memcpy(node->text, text.data, text.length);
+    node->length = text.length;
+    node->total = text.length;
+    node->priority = (unsigned)rand() ^ ((unsigned)rand() << 16);
+    node->left = 0;
+    node->right = 0;
+    return node;
+}
+
+/**
+ * @brief Joins two ropes (all of `left`'s string, then all of `right`'s) in O(log n).
+ *
+ * @returns The joined rope.
+ */
+RopeNode *rope_concat(RopeNode *left, RopeNode *right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+
+    if (left->priority >= right->priority)
+    {
+        left->right = rope_concat(left->right, right);
+        rope_update(left);
+        return left;
+    }
+    right->left = rope_concat(left, right->left);
+    rope_update(right);
+    return right;
+}
+
+/**
+ * Splits a rope in two, in O(log n): `*left` gets the first `pos` characters, and `*right` the rest.
+ * A chunk that straddles `pos` is cut in two.
+ *
+ * @returns `true` on success, `false` on error (no memory to cut a chunk).
+ */
+bool rope_split(RopeNode *rope, size_t pos, RopeNode **left, RopeNode **right)
+{
+    if (!rope)
+    {
+        *left = *right = 0;
+        return true;
+    }
+
+    size_t left_total = rope_total(rope->left);
+    if (pos <= left_total)
+    {
+        if (!rope_split(rope->left, pos, left, &rope->left))
+            return false;
+        rope_update(rope);
+        *right = rope;
+        return true;
+    }
+    if (pos >= left_total + rope->length)
+    {
+        if (!rope_split(rope->right, pos - left_total - rope->length, &rope->right, right))
+            return false;
+        rope_update(rope);
+        *left = rope;
+        return true;
+    }
+
+    // `pos` falls inside this node's chunk: its tail moves to a new node, at the start of the right part
+    size_t cut = pos - left_total;
+    StrView tail = {rope->text + cut, rope->length - cut};
+    RopeNode *tail_node = create_rope_node(tail);
+    if (!tail_node)
+        return false;
+    // The tail takes this node's place in the heap order, so the treap stays as balanced as it was
+    tail_node->priority = rope->priority;
+    rope->length = cut;
+
+    *right = rope_concat(tail_node, rope->right);
+    rope->right = 0;
+    rope_update(rope);
+    *left = rope;
+    return true;
+}
+
+/**
+ * @brief Appends a string to a rope, in chunks of up to ROPE_CHUNK characters.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool rope_append(RopeNode **rope, StrView text)
+{
+    if (!rope)
+        return false;
+
+    for (size_t start = 0; start < text.length; start += ROPE_CHUNK)
+    {
+        size_t length = text.length - start < ROPE_CHUNK ? text.length - start : ROPE_CHUNK;
+        StrView chunk = {text.data + start, length};
+        RopeNode *node = create_rope_node(chunk);
+        if (!node)
+            return false;
+        *rope = rope_concat(*rope, node);
+    }
+    return true;
+}
+
+/**
+ * @brief Inserts a string at position `pos` of a rope (or at its end, if `pos` is past it).
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool rope_insert(RopeNode **rope, size_t pos, StrView text)
+{
+    if (!rope)
+        return false;
+
+    RopeNode *left, *right, *middle = 0;
+    if (!rope_split(*rope, pos, &left, &right))
+        return false;
+    bool ok = rope_append(&middle, text);
+    *rope = rope_concat(rope_concat(left, middle), right);
+    return ok;
+}
+
+void destroy_rope(RopeNode **rope)
+{
+    if (!rope || !(*rope))
+        return;
+
+    destroy_rope(&(*rope)->left);
+    destroy_rope(&(*rope)->right);
+    free((*rope)->text);
+    free(*rope);
+    (*rope) = 0;
+}
+
+/**
+ * @brief Deletes `length` characters from position `pos` of a rope.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool rope_delete(RopeNode **rope, size_t pos, size_t length)
+{
+    if (!rope)
+        return false;
+
+    RopeNode *left, *middle, *right;
+    if (!rope_split(*rope, pos, &left, &right))
+        return false;
+    if (!rope_split(right, length, &middle, &right))
+    {
+        *rope = rope_concat(left, right);
+        return false;
+    }
+    destroy_rope(&middle);
+    *rope = rope_concat(left, right);
+    return true;
+}
+
+/**
+ * @brief Returns the character at position `pos` of a rope, in O(log n), or '\0' if it's past the end.
+ */
+char rope_char_at(const RopeNode *rope, size_t pos)
+{
+    while (rope)
+    {
+        size_t left_total = rope_total(rope->left);
+        if (pos < left_total)
+            rope = rope->left;
+        else if (pos < left_total + rope->length)
+            return rope->text[pos - left_total];
+        else
+        {
+            pos -= left_total + rope->length;
+            rope = rope->right;
+        }
+    }
+    return '\0';
+}
+
+/**
+ * @brief Appends a rope's whole string to a builder.
+ *
+ * @returns `true` on success, `false` on error.
+ */
+bool rope_to_builder(const RopeNode *rope, StringBuilder *sb)
+{
+    if (!rope)
+        return true;
+
+    StrView text = {rope->text, rope->length};
+    return sb_reserve(sb, rope->total) && rope_to_builder(rope->left, sb) &&
+           sb_append_view(sb, text) && rope_to_builder(rope->right, sb);
+}
+
+/**
+ * The `strcat_pointer` from pointer_arithmetic_examples.c.
+ */
+void strcat_pointer(char *dst, char *src)
+{
+    if (!dst || !src)
+        return;
+
+    if (*dst)
+    {
+        for (; (*dst); ++dst)
+            ;
+    }
+    if (*src)
+    {
+        char *scan = src;
+        *dst = *scan;
+        for (; (*scan); ++scan)
+        {
+            *dst = *scan;
+            ++dst;
+        }
+    }
+    *dst = '\0';
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Builds a string of `pieces` pieces with repeated `strcat_pointer` (into a
+ *        big enough buffer), and with a builder, and prints the time each took.
+ */
+void bench_append(int pieces)
+{
+    char piece[32];
+    size_t total = 0;
+    for (int i = 0; i < pieces; i++)
+        total += snprintf(piece, sizeof(piece), "item %d, ", i);
+
+    char *buffer = (char *)malloc(total + 1);
+    StringBuilder *sb = create_builder(0);
+    if (!buffer || !sb)
+    {
+        free(buffer);
+        destroy_builder(&sb);
+        return;
+    }
+
+    double start = now_seconds();
+    buffer[0] = '\0';
+    for (int i = 0; i < pieces; i++)
+    {
+        snprintf(piece, sizeof(piece), "item %d, ", i);
+        strcat_pointer(buffer, piece);
+    }
+    double strcat_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < pieces; i++)
+    {
+        sb_append(sb, "item ");
+        sb_append_int(sb, i);
+        sb_append(sb, ", ");
+    }
+    double builder_time = now_seconds() - start;
+
+    printf("  %6d pieces (%7zu chars) | strcat_pointer %8.4f s | builder %8.5f s | %7.0fx faster | %s\n",
+           pieces, total, strcat_time, builder_time, strcat_time / builder_time,
+           strcmp(buffer, sb->data) ? "DIFFERENT" : "same result");
+
+    free(buffer);
+    destroy_builder(&sb);
+}
+
+/**
+ * @brief Makes BENCH_ROPE_EDITS random insertions and deletions in a BENCH_ROPE_SIZE string,
+ *        once in a flat string (moving the tail with `memmove`) and once in a rope.
+ */
+void bench_edits(void)
+{
+    StringBuilder *flat = create_builder(BENCH_ROPE_SIZE + BENCH_ROPE_EDITS * 8);
+    RopeNode *rope = 0;
+    if (!flat)
+        return;
+
+    for (size_t i = 0; i < BENCH_ROPE_SIZE; i++)
+        flat->data[i] = 'a' + i % 26;
+    flat->length = BENCH_ROPE_SIZE;
+    flat->data[flat->length] = '\0';
+    if (!rope_append(&rope, sb_view(flat)))
+    {
+        destroy_builder(&flat);
+        destroy_rope(&rope);
+        return;
+    }
+
+    size_t *positions = (size_t *)malloc(BENCH_ROPE_EDITS * sizeof(size_t));
+    if (!positions)
+    {
+        destroy_builder(&flat);
+        destroy_rope(&rope);
+        return;
+    }
+    for (int i = 0; i < BENCH_ROPE_EDITS; i++)
+        positions[i] = ((size_t)rand() * RAND_MAX + rand()) % (BENCH_ROPE_SIZE - 16);
+
+    // Every even edit inserts "[edit]", every odd one deletes 3 characters
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ROPE_EDITS; i++)
+    {
+        size_t pos = positions[i];
+        if (i % 2 == 0)
+        {
+            memmove(flat->data + pos + 6, flat->data + pos, flat->length - pos + 1);
+            memcpy(flat->data + pos, "[edit]", 6);
+            flat->length += 6;
+        }
+        else
+        {
+            memmove(flat->data + pos, flat->data + pos + 3, flat->length - pos - 2);
+            flat->length -= 3;
+        }
+    }
+    double flat_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_ROPE_EDITS; i++)
+    {
+        if (i % 2 == 0)
+            rope_insert(&rope, positions[i], view_of("[edit]"));
+        else
+            rope_delete(&rope, positions[i], 3);
+    }
+    double rope_time = now_seconds() - start;
+
+    StringBuilder *check = create_builder(rope_total(rope));
+    bool same = check && rope_to_builder(rope, check) && check->length == flat->length &&
+                !memcmp(check->data, flat->data, flat->length);
+
+    printf("  %d edits in a %d MB string | memmove %.4f s | rope %.4f s | %.0fx faster | %s\n",
+           BENCH_ROPE_EDITS, BENCH_ROPE_SIZE >> 20, flat_time, rope_time, flat_time / rope_time,
+           same ? "same result" : "DIFFERENT");
+
+    free(positions);
+    destroy_builder(&check);
+    destroy_builder(&flat);
+    destroy_rope(&rope);
+}
+
+int main(void)
+{
+    printf("*********************************STRING BUILDER:*********************************\n");
+    // `strcat_pointer` walks all of `dst` to find its end, every time it's called: building
+    // a string out of n pieces walks the string n times, which is O(n^2). And it simply
+    // trusts that `dst` has room. A builder remembers its length and its capacity instead.
+
+    StringBuilder *sb = create_builder(0);
+    if (!sb)
+        return 0;
+
+    sb_append(sb, "Point ");
+    sb_append_char(sb, '(');
+    sb_append_float(sb, 3.14159, 2);
+    sb_append(sb, ", ");
+    sb_append_int(sb, -465876);
+    sb_append_char(sb, ')');
+    StrView view = sb_view(sb);
+    printf("%.*s (length %zu, capacity %zu)\n", (int)view.length, view.data, sb->length, sb->capacity);
+    destroy_builder(&sb);
+
+    // A rope makes edits in the middle of a long string cheap
+    RopeNode *rope = 0;
+    rope_append(&rope, view_of("This is a sentence."));
+    rope_insert(&rope, 10, view_of("short "));
+    rope_delete(&rope, 0, 5);
+    StringBuilder *text = create_builder(0);
+    rope_to_builder(rope, text);
+    printf("Rope: \"%s\" (character 5 is '%c')\n", text ? text->data : "", rope_char_at(rope, 5));
+    destroy_builder(&text);
+    destroy_rope(&rope);
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    srand(time(NULL));
+    for (int pieces = 2500; pieces <= 20000; pieces *= 2)
+        bench_append(pieces);
+    bench_edits();
+
+    return 0;
+}
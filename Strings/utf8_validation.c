@@ -0,0 +1,709 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+#define BENCH_SIZE (32 * 1024 * 1024)
+#define BENCH_PASSES 5
+#define FUZZ_ROUNDS 20000
+
+/*
+ * UTF-8 encodes a code point in 1 to 4 bytes:
+ *     U+0000   - U+007F     0xxxxxxx
+ *     U+0080   - U+07FF     110xxxxx 10xxxxxx
+ *     U+0800   - U+FFFF     1110xxxx 10xxxxxx 10xxxxxx
+ *     U+10000  - U+10FFFF   11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
+ * A sequence is invalid if it is cut short, has a stray continuation byte (10xxxxxx),
+ * is longer than needed ("overlong"), encodes a surrogate (U+D800 - U+DFFF) or goes past U+10FFFF.
+ * The position of an error is the offset of the first byte of the invalid sequence.
+ */
+
+/**
+ * A "view" of a string: a pointer to its first character and its length.
+ * It doesn't own the characters, and they need not end with '\0'.
+ * The `StrView` from string_builder.c.
+ */
+typedef struct str_view
+{
+    const char *data;
+    size_t length;
+} StrView;
+
+StrView view_of(const char *str)
+{
+    StrView view = {str ? str : "", str ? strlen(str) : 0};
+    return view;
+}
+
+/**
+ * Decodes one UTF-8 sequence.
+ *
+ * @param str The sequence
+ * @param left Number of bytes left in the buffer
+ * @param code_point Where the code point is written
+ *
+ * @returns The length of the sequence (1-4), or 0 if it's invalid.
+ */
+static inline int decode_utf8(const unsigned char *str, size_t left, uint32_t *code_point)
+{
+    unsigned char lead = str[0];
+    if (lead < 0x80)
+    {
+        *code_point = lead;
+        return 1;
+    }
+
+    int length;
+    uint32_t value, min;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        length = 2;
+        value = lead & 0x1F;
+        min = 0x80;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        value = lead & 0x0F;
+        min = 0x800;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        value = lead & 0x07;
+        min = 0x10000;
+    }
+    else
+        return 0;
+
+    if (left < (size_t)length)
+        return 0;
+    for (int i = 1; i < length; i++)
+    {
+        if ((str[i] & 0xC0) != 0x80)
+            return 0;
+        value = (value << 6) | (str[i] & 0x3F);
+    }
+    if (value < min || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+        return 0;
+
+    *code_point = value;
+    return length;
+}
+
+/**
+ * @brief Validates UTF-8 one code point at a time.
+ *
+ * @param error_offset Where the offset of the first invalid sequence is written (may be NULL)
+ * @param count Where the number of code points is written (may be NULL)
+ *
+ * @returns true if the whole buffer is valid UTF-8, false otherwise.
+ */
+bool utf8_validate_scalar(const char *data, size_t length, size_t *error_offset, size_t *count)
+{
+    const unsigned char *str = (const unsigned char *)data;
+    size_t pos = 0, code_points = 0;
+    uint32_t code_point;
+    while (pos < length)
+    {
+        int step = decode_utf8(str + pos, length - pos, &code_point);
+        if (!step)
+        {
+            if (error_offset)
+                *error_offset = pos;
+            return false;
+        }
+        pos += step;
+        code_points++;
+    }
+    if (count)
+        *count = code_points;
+    return true;
+}
+
+#if HAVE_X86
+/*
+ * The vectorized validator (Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction
+ * Per Byte"). Every error shows up in a pair of consecutive bytes, and depends only on the
+ * high nibble of the first, its low nibble, and the high nibble of the second. So we look
+ * up each of the three nibbles (for 32 pairs at once, with `vpshufb`) in a 16-entry table
+ * giving the set of errors it allows; the errors all three allow are real.
+ * The only errors pairs can't see are missing or extra 3rd/4th bytes, which we check by
+ * comparing the bytes 2 and 3 positions back with 0xE0 and 0xF0.
+ */
+#define TOO_SHORT (1 << 0)  // 11______ 0_______ or 11______ 11______
+#define TOO_LONG (1 << 1)   // 0_______ 10______
+#define OVERLONG_3 (1 << 2) // 11100000 100_____
+#define TOO_LARGE (1 << 3)  // 11110100 1001____, 11110100 101_____ or 11110101+ 1_______
+#define SURROGATE (1 << 4)  // 11101101 101_____
+#define OVERLONG_2 (1 << 5) // 1100000_ 10______
+#define TOO_LARGE_1000 (1 << 6) // 11110101+ 1000____
+#define OVERLONG_4 (1 << 6) // 11110000 1000____
+#define TWO_CONTS (1 << 7)  // 10______ 10______ (unless it's a 3rd or 4th byte)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static const int8_t byte_1_high_table[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    (int8_t)TWO_CONTS, (int8_t)TWO_CONTS, (int8_t)TWO_CONTS, (int8_t)TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+
+static const int8_t byte_1_low_table[16] = {
+    (int8_t)(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+    (int8_t)(CARRY | OVERLONG_2),
+    (int8_t)CARRY,
+    (int8_t)CARRY,
+    (int8_t)(CARRY | TOO_LARGE),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000),
+    (int8_t)(CARRY | TOO_LARGE | TOO_LARGE_1000)};
+
+static const int8_t byte_2_high_table[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    (int8_t)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+    (int8_t)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+    (int8_t)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+    (int8_t)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+// The block `input` shifted right by `n` bytes, with the last bytes of `previous` coming in
+#define PREVIOUS_BYTES(input, previous, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((previous), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2"))) static inline __m256i lookup_16(const int8_t *table, __m256i nibbles)
+{
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table)), nibbles);
+}
+
+/**
+ * @brief Returns the errors (non-zero bytes) in a 32-byte block, given the block before it.
+ */
+__attribute__((target("avx2"))) static inline __m256i block_errors(__m256i input, __m256i previous)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = PREVIOUS_BYTES(input, previous, 1);
+    __m256i special_cases = _mm256_and_si256(
+        _mm256_and_si256(lookup_16(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                         lookup_16(byte_1_low_table, _mm256_and_si256(prev1, nibble))),
+        lookup_16(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+    // Bytes 2 positions after a 3/4-byte lead, or 3 after a 4-byte lead, must be continuations:
+    // exactly where TWO_CONTS (0x80) was flagged
+    __m256i prev2 = PREVIOUS_BYTES(input, previous, 2);
+    __m256i prev3 = PREVIOUS_BYTES(input, previous, 3);
+    __m256i must_be_continuation = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+                                                   _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+    must_be_continuation = _mm256_and_si256(must_be_continuation, _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+/**
+ * @brief Non-zero where one of the last 3 bytes of a block starts a sequence that doesn't fit in it.
+ */
+__attribute__((target("avx2"))) static inline __m256i incomplete_at_end(__m256i input)
+{
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_value);
+}
+
+/**
+ * Validates UTF-8 32 bytes at a time with AVX2, counting the code points as it goes
+ * (the bytes that are not continuation bytes).
+ * When a block has an error, the scalar validator finds its exact position, starting from
+ * the last code point that begins before the previous block: everything before that is valid.
+ */
+__attribute__((target("avx2,popcnt"))) static bool utf8_validate_avx2(const char *data, size_t length,
+                                                                      size_t *error_offset, size_t *count)
+{
+    const unsigned char *str = (const unsigned char *)data;
+    __m256i previous = _mm256_setzero_si256(), incomplete = _mm256_setzero_si256();
+    const __m256i last_continuation = _mm256_set1_epi8((char)0xBF);
+    size_t code_points = 0, pos = 0;
+
+    for (; pos + 32 <= length; pos += 32)
+    {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(str + pos));
+        __m256i errors;
+        if (!_mm256_movemask_epi8(input))
+        {
+            // All ASCII: only a sequence cut short by the end of the previous block can be wrong
+            errors = incomplete;
+            code_points += 32;
+        }
+        else
+        {
+            errors = block_errors(input, previous);
+            incomplete = incomplete_at_end(input);
+            // Signed, continuation bytes are the smallest: -128 to -65 (0x80 - 0xBF)
+            code_points += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, last_continuation)));
+        }
+        if (!_mm256_testz_si256(errors, errors))
+            break;
+        previous = input;
+    }
+
+    // Finish (or find the error) in scalar code, from the code point the previous block started in
+    size_t resume = pos >= 32 ? pos - 32 : 0;
+    while (resume > 0 && (str[resume] & 0xC0) == 0x80)
+        resume--;
+    for (size_t i = resume; i < pos; i++)
+        code_points -= (str[i] & 0xC0) != 0x80;
+
+    size_t rest_count = 0, rest_error = 0;
+    if (!utf8_validate_scalar(data + resume, length - resume, &rest_error, &rest_count))
+    {
+        if (error_offset)
+            *error_offset = resume + rest_error;
+        return false;
+    }
+    if (count)
+        *count = code_points + rest_count;
+    return true;
+}
+#endif
+
+static bool has_avx2(void)
+{
+#if HAVE_X86
+    static int supported = -1;
+    if (supported < 0)
+        supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Validates a UTF-8 buffer (with AVX2 if the CPU has it).
+ *
+ * @param data The buffer
+ * @param length Its length in bytes
+ * @param error_offset Where the offset of the first invalid sequence is written, if there is one (may be NULL)
+ *
+ * @returns true if the whole buffer is valid UTF-8, false otherwise.
+ */
+bool utf8_validate(const char *data, size_t length, size_t *error_offset)
+{
+    if (!data)
+        return length == 0;
+#if HAVE_X86
+    if (has_avx2())
+        return utf8_validate_avx2(data, length, error_offset, 0);
+#endif
+    return utf8_validate_scalar(data, length, error_offset, 0);
+}
+
+/**
+ * Counts the code points ("characters") of a UTF-8 buffer - the UTF-8 version of `strlen_pointer`.
+ *
+ * @param error_offset Where the offset of the first invalid sequence is written, if there is one (may be NULL)
+ *
+ * @returns The number of code points, or -1 if the buffer isn't valid UTF-8.
+ */
+long utf8_length(const char *data, size_t length, size_t *error_offset)
+{
+    if (!data)
+        return length ? -1 : 0;
+
+    size_t count = 0;
+    bool valid;
+#if HAVE_X86
+    if (has_avx2())
+        valid = utf8_validate_avx2(data, length, error_offset, &count);
+    else
+#endif
+        valid = utf8_validate_scalar(data, length, error_offset, &count);
+    return valid ? (long)count : -1;
+}
+
+/**
+ * @brief Transcodes UTF-8 to UTF-32 one code point at a time. See `utf8_to_utf32`.
+ */
+long utf8_to_utf32_scalar(const char *data, size_t length, uint32_t *out, size_t capacity, size_t *error_offset)
+{
+    const unsigned char *str = (const unsigned char *)data;
+    size_t pos = 0, written = 0;
+    while (pos < length)
+    {
+        int step = written < capacity ? decode_utf8(str + pos, length - pos, out + written) : 0;
+        if (!step)
+        {
+            if (error_offset)
+                *error_offset = pos;
+            return -1;
+        }
+        pos += step;
+        written++;
+    }
+    return written;
+}
+
+#if HAVE_X86
+/*
+ * For each of the 256 sets of 8 lanes, the indices of the lanes in the set, in order:
+ * `vpermd` with them packs those lanes at the start of a vector.
+ */
+static uint32_t compact_lanes[256][8];
+
+static void init_compact_lanes(void)
+{
+    for (int mask = 0; mask < 256; mask++)
+    {
+        int count = 0;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if (mask & (1 << lane))
+                compact_lanes[mask][count++] = lane;
+        }
+        while (count < 8)
+            compact_lanes[mask][count++] = 0;
+    }
+}
+
+/**
+ * Transcodes VALID UTF-8 with AVX2, 8 bytes at a time: in 32-bit lanes we decode, for every
+ * one of the 8 positions, the code point that would start there if it were a 1, 2, 3 or
+ * 4-byte sequence (from the bytes at +0, +1, +2 and +3), and keep the one its first byte
+ * says. Then the lanes of continuation bytes are dropped, and the others packed together
+ * with `vpermd`. Blocks of 32 ASCII bytes are just widened with four `vpmovzxbd`s.
+ *
+ * @returns The number of bytes decoded (the caller decodes what's left).
+ */
+__attribute__((target("avx2,popcnt"))) static size_t decode_valid_avx2(const unsigned char *str, size_t length,
+                                                                       uint32_t *out, size_t capacity,
+                                                                       size_t *written_out)
+{
+    const __m256i low_6 = _mm256_set1_epi32(0x3F), continuation = _mm256_set1_epi32(0x80);
+    const __m256i below_2 = _mm256_set1_epi32(0xBF), below_3 = _mm256_set1_epi32(0xDF),
+                  below_4 = _mm256_set1_epi32(0xEF), high_2 = _mm256_set1_epi32(0xC0);
+    size_t pos = 0, written = 0;
+
+    // 16 bytes of input are read for each 8 decoded, and up to 32 code points written
+    while (pos + 32 <= length && written + 32 <= capacity)
+    {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(str + pos));
+        if (!_mm256_movemask_epi8(input))
+        {
+            __m128i low = _mm256_castsi256_si128(input), high = _mm256_extracti128_si256(input, 1);
+            _mm256_storeu_si256((__m256i *)(out + written), _mm256_cvtepu8_epi32(low));
+            _mm256_storeu_si256((__m256i *)(out + written + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+            _mm256_storeu_si256((__m256i *)(out + written + 16), _mm256_cvtepu8_epi32(high));
+            _mm256_storeu_si256((__m256i *)(out + written + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+            pos += 32;
+            written += 32;
+            continue;
+        }
+
+        for (size_t end = pos + 24; pos < end; pos += 8)
+        {
+            __m256i b0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(str + pos)));
+            __m256i b1 = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(str + pos + 1))), low_6);
+            __m256i b2 = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(str + pos + 2))), low_6);
+            __m256i b3 = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(str + pos + 3))), low_6);
+
+            __m256i two = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b0, _mm256_set1_epi32(0x1F)), 6), b1);
+            __m256i three = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b0, _mm256_set1_epi32(0x0F)), 12),
+                                            _mm256_or_si256(_mm256_slli_epi32(b1, 6), b2));
+            __m256i four = _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b0, _mm256_set1_epi32(0x07)), 18),
+                                _mm256_slli_epi32(b1, 12)),
+                _mm256_or_si256(_mm256_slli_epi32(b2, 6), b3));
+
+            __m256i code_points = _mm256_blendv_epi8(b0, two, _mm256_cmpgt_epi32(b0, below_2));
+            code_points = _mm256_blendv_epi8(code_points, three, _mm256_cmpgt_epi32(b0, below_3));
+            code_points = _mm256_blendv_epi8(code_points, four, _mm256_cmpgt_epi32(b0, below_4));
+
+            // Lanes whose byte starts a code point
+            __m256i is_continuation = _mm256_cmpeq_epi32(_mm256_and_si256(b0, high_2), continuation);
+            unsigned starts = ~(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(is_continuation)) & 0xFF;
+            __m256i order = _mm256_loadu_si256((const __m256i *)compact_lanes[starts]);
+            _mm256_storeu_si256((__m256i *)(out + written), _mm256_permutevar8x32_epi32(code_points, order));
+            written += __builtin_popcount(starts);
+        }
+
+        // A sequence may have started in the last 3 of those bytes: continue from its end
+        while ((str[pos] & 0xC0) == 0x80)
+            pos++;
+    }
+
+    *written_out = written;
+    return pos;
+}
+
+/**
+ * Transcodes with AVX2: the buffer is validated (and its code points counted) first, so the
+ * decoder doesn't need to check anything. Invalid input, or not enough room in `out`, is left
+ * to the scalar transcoder, which writes what it can and finds the error's position.
+ */
+__attribute__((target("avx2"))) static long utf8_to_utf32_avx2(const char *data, size_t length, uint32_t *out,
+                                                               size_t capacity, size_t *error_offset)
+{
+    static bool initialized = false;
+    if (!initialized)
+    {
+        init_compact_lanes();
+        initialized = true;
+    }
+
+    size_t count = 0;
+    if (!utf8_validate_avx2(data, length, 0, &count) || count > capacity)
+        return utf8_to_utf32_scalar(data, length, out, capacity, error_offset);
+
+    size_t written = 0;
+    size_t pos = decode_valid_avx2((const unsigned char *)data, length, out, capacity, &written);
+    long rest = utf8_to_utf32_scalar(data + pos, length - pos, out + written, capacity - written, 0);
+    return written + rest;
+}
+#endif
+
+/**
+ * Transcodes a UTF-8 buffer to UTF-32 (one `uint32_t` per code point).
+ *
+ * @param out Where the code points are written. `length` slots are always enough.
+ * @param capacity Number of slots in `out`
+ * @param error_offset Where the offset of the first invalid sequence (or of the first code
+ *                     point that didn't fit in `out`) is written (may be NULL)
+ *
+ * @returns The number of code points written, or -1 on error (what came before it is written).
+ */
+long utf8_to_utf32(const char *data, size_t length, uint32_t *out, size_t capacity, size_t *error_offset)
+{
+    if (!data || (!out && capacity))
+        return length ? -1 : 0;
+#if HAVE_X86
+    if (has_avx2())
+        return utf8_to_utf32_avx2(data, length, out, capacity, error_offset);
+#endif
+    return utf8_to_utf32_scalar(data, length, out, capacity, error_offset);
+}
+
+bool utf8_validate_view(StrView view, size_t *error_offset)
+{
+    return utf8_validate(view.data, view.length, error_offset);
+}
+
+long utf8_length_view(StrView view, size_t *error_offset)
+{
+    return utf8_length(view.data, view.length, error_offset);
+}
+
+long utf8_to_utf32_view(StrView view, uint32_t *out, size_t capacity, size_t *error_offset)
+{
+    return utf8_to_utf32(view.data, view.length, out, capacity, error_offset);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Writes the UTF-8 encoding of a code point, and returns its length.
+ */
+static int encode_utf8(uint32_t code_point, char *out)
+{
+    if (code_point < 0x80)
+    {
+        out[0] = (char)code_point;
+        return 1;
+    }
+    if (code_point < 0x800)
+    {
+        out[0] = (char)(0xC0 | (code_point >> 6));
+        out[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if (code_point < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (code_point >> 12));
+        out[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code_point >> 18));
+    out[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief Fills a buffer with random valid UTF-8: ASCII with probability `ascii_percent`,
+ *        and otherwise 2, 3 or 4-byte code points. Returns the number of bytes written.
+ */
+static size_t make_corpus(char *buffer, size_t size, int ascii_percent)
+{
+    size_t pos = 0;
+    while (pos + 4 <= size)
+    {
+        uint32_t code_point;
+        if (rand() % 100 < ascii_percent)
+            code_point = ' ' + rand() % 95;
+        else
+        {
+            switch (rand() % 3)
+            {
+            case 0:
+                code_point = 0x5D0 + rand() % 27; // Hebrew
+                break;
+            case 1:
+                code_point = 0x4E00 + rand() % 0x5000; // CJK
+                break;
+            default:
+                code_point = rand() % 4 ? 0x1F600 + rand() % 80 : 0xE000 + rand() % 0x1000; // Emoji or private use
+            }
+        }
+        pos += encode_utf8(code_point, buffer + pos);
+    }
+    return pos;
+}
+
+/**
+ * @brief Checks the vectorized functions against the scalar ones on random damage to valid text.
+ */
+static bool fuzz(const char *corpus, size_t size)
+{
+    char sample[200];
+    uint32_t scalar_out[200], simd_out[200];
+    for (int round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        size_t length = 1 + rand() % sizeof(sample);
+        size_t start = rand() % (size - length);
+        memcpy(sample, corpus + start, length);
+        int damage = rand() % 3;
+        for (int d = 0; d < damage; d++)
+            sample[rand() % length] = (char)(rand() % 256);
+
+        size_t scalar_error = 0, simd_error = 0, scalar_count = 0;
+        bool scalar_valid = utf8_validate_scalar(sample, length, &scalar_error, &scalar_count);
+        long simd_count = utf8_length(sample, length, &simd_error);
+        long scalar_written = utf8_to_utf32_scalar(sample, length, scalar_out, length, 0);
+        size_t transcode_error = 0;
+        long simd_written = utf8_to_utf32(sample, length, simd_out, length, &transcode_error);
+        if (scalar_valid != utf8_validate(sample, length, 0) || scalar_valid != (simd_count >= 0) ||
+            (scalar_valid && (size_t)simd_count != scalar_count) ||
+            (!scalar_valid && (simd_error != scalar_error || transcode_error != scalar_error)) ||
+            scalar_written != simd_written ||
+            (scalar_valid && memcmp(scalar_out, simd_out, scalar_written * sizeof(uint32_t))))
+            return false;
+    }
+    return true;
+}
+
+static void bench_corpus(const char *name, const char *corpus, size_t size, uint32_t *out)
+{
+    printf("%s (%zu MB):\n", name, size >> 20);
+    long count = 0;
+    size_t scalar_count = 0;
+    double start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        utf8_validate_scalar(corpus, size, 0, &scalar_count);
+    double scalar_validate = now_seconds() - start;
+
+    start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        count = utf8_length(corpus, size, 0);
+    double simd_validate = now_seconds() - start;
+    printf("    Validate and count  | scalar %6.2f GB/s | AVX2 %6.2f GB/s | %ld code points%s\n",
+           size * (double)BENCH_PASSES / scalar_validate / 1e9, size * (double)BENCH_PASSES / simd_validate / 1e9,
+           count, (size_t)count == scalar_count ? "" : " (MISMATCH)");
+
+    start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        count = utf8_to_utf32_scalar(corpus, size, out, size, 0);
+    double scalar_transcode = now_seconds() - start;
+    start = now_seconds();
+    for (int pass = 0; pass < BENCH_PASSES; pass++)
+        count = utf8_to_utf32(corpus, size, out, size, 0);
+    double simd_transcode = now_seconds() - start;
+    printf("    To UTF-32           | scalar %6.2f GB/s | AVX2 %6.2f GB/s | %ld code points\n",
+           size * (double)BENCH_PASSES / scalar_transcode / 1e9, size * (double)BENCH_PASSES / simd_transcode / 1e9,
+           count);
+}
+
+int main(void)
+{
+    printf("*********************************UTF-8 VALIDATION:*********************************\n");
+    // `strlen_pointer` counts bytes, but in UTF-8 a character takes 1 to 4 of them.
+    // Decoding one code point at a time branches on every byte; AVX2 checks 32 bytes at once
+    // with three table lookups, and skips pure-ASCII blocks almost for free.
+    printf("AVX2 is %savailable\n", has_avx2() ? "" : "NOT ");
+
+    const char *samples[] = {
+        "hello",
+        "\xD7\xA9\xD7\x9C\xD7\x95\xD7\x9D world",        // Hebrew
+        "caf\xC3\xA9 \xF0\x9F\x98\x80",                    // An e with an accent and an emoji
+        "abc\x80",                                         // A stray continuation byte
+        "ab\xC0\xAF",                                      // An overlong '/'
+        "x\xED\xA0\x80",                                   // A surrogate
+        "\xF4\x90\x80\x80",                                // Past U+10FFFF
+        "0123456789012345678901234567890\xE2\x82",         // Cut short, at the end of a block
+        "01234567890123456789012345678901234567890123456789\xE2\x82\xAC ok \xE2\x28\xA1"};
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        size_t error = 0;
+        long count = utf8_length_view(view_of(samples[i]), &error);
+        if (count >= 0)
+            printf("Sample %zu: valid, %zu bytes, %ld code points\n", i, strlen(samples[i]), count);
+        else
+            printf("Sample %zu: invalid at byte %zu\n", i, error);
+    }
+
+    // A view of part of a buffer: "Hebrew" and " world" without the rest
+    StrView part = {samples[1], 8};
+    uint32_t code_points[8];
+    long written = utf8_to_utf32_view(part, code_points, 8, 0);
+    printf("The first %zu bytes of sample 1 are:", part.length);
+    for (long i = 0; i < written; i++)
+        printf(" U+%04X", code_points[i]);
+    printf("\n");
+
+    printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~BENCHMARK:~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    char *corpus = (char *)malloc(BENCH_SIZE);
+    uint32_t *out = (uint32_t *)malloc(BENCH_SIZE * sizeof(uint32_t));
+    if (!corpus || !out)
+    {
+        free(corpus);
+        free(out);
+        return 0;
+    }
+
+    srand(2023);
+    size_t size = make_corpus(corpus, BENCH_SIZE, 100);
+    bench_corpus("Pure ASCII", corpus, size, out);
+    size = make_corpus(corpus, BENCH_SIZE, 95);
+    bench_corpus("ASCII-heavy (95% ASCII)", corpus, size, out);
+    printf("Vectorized and scalar results agree on %d damaged samples: %s\n", FUZZ_ROUNDS,
+           fuzz(corpus, size) ? "yes" : "NO");
+    size = make_corpus(corpus, BENCH_SIZE, 10);
+    bench_corpus("Multibyte-heavy (10% ASCII)", corpus, size, out);
+    printf("Vectorized and scalar results agree on %d damaged samples: %s\n", FUZZ_ROUNDS,
+           fuzz(corpus, size) ? "yes" : "NO");
+
+    free(corpus);
+    free(out);
+    return 0;
+}